@@ -22,8 +22,9 @@ struct Light {
     float lightCutoff;  // angle of our spotlight
     vec3 lightColor;    // light color
 };
-#define N_LIGHTS 1
-uniform Light lights[N_LIGHTS];
+#define MAX_LIGHTS 16 // keep in sync with Renderer::MAX_LIGHTS
+uniform Light lights[MAX_LIGHTS];
+uniform int numLights;              // how many entries of lights[] are in use
 
 //float min3(vec3 v) { return min(min(v.x,v.y),v.z); }
 //float max3(vec3 v) { return max(max(v.x,v.y),v.z); }
@@ -31,7 +32,7 @@ float bug = 0.0;
 
 void main() {
     vec3 colorLinear = materialAmbColor;
-    for (int i = 0; i < N_LIGHTS; i++) {
+    for (int i = 0; i < numLights; i++) {
         vec3 viewDir = normalize((/*viewMtx */ vec4(eyePos, 1.0)).xyz - vertPos);
         vec3 lightDir = vec3(0.0);
         if (lights[i].lightType == 1) // directional lights
@@ -10,6 +10,7 @@ uniform mat4 projMtx;
 uniform mat4 modelMtx;
 uniform mat4 normalMtx;
 uniform float jitterStrength;
+uniform float logDepthCoef;             // 2 / log2(far + 1), for logarithmic depth
 
 layout(location = 0) out vec3 vertNorm;
 layout(location = 1) out vec3 vertPos;
@@ -17,6 +18,8 @@ layout(location = 2) out float _jitterStr;
 
 void main() {
     gl_Position = mvpMatrix * vec4(vPos,1.0);
+    // logarithmic depth: precision spread evenly from the near plane out to the far one
+    gl_Position.z = (log2(max(1e-6, 1.0 + gl_Position.w)) * logDepthCoef - 1.0) * gl_Position.w;
     _jitterStr = jitterStrength;
     vec3 cameraVec = normalize( -(modelMtx * vec4(vPos,1.0)).xyz );
     vec4 vertPos4 = modelMtx * vec4(vPos,1.0);
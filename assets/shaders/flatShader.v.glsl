@@ -2,6 +2,7 @@
 
 // uniform inputs
 uniform mat4 mvpMatrix;
+uniform float logDepthCoef;     // 2 / log2(far + 1), for logarithmic depth
 
 // attribute inputs
 layout(location = 0) in vec3 vPos;
@@ -11,4 +12,6 @@ layout(location = 1) in vec3 vNorm;
 
 void main() {
     gl_Position = mvpMatrix * vec4(vPos, 1.0);
+    // logarithmic depth, matching the lighting shader
+    gl_Position.z = (log2(max(1e-6, 1.0 + gl_Position.w)) * logDepthCoef - 1.0) * gl_Position.w;
 }
\ No newline at end of file
@@ -5,7 +5,12 @@
 #ifndef FP_GENGINE_H
 #define FP_GENGINE_H
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <set>
 
@@ -13,83 +18,172 @@
 #include <renderer/Renderer.h>
 #include <kInputListener.h>
 #include <kAnimHandler.h>
+#include <kCoroutine.h>
+#include <kInputRecorder.h>
+#include <JobSystem.h>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <ecs/TransformHierarchy.h>
+#include <ecs/SpatialIndex.h>
+#include <ecs/Broadphase.h>
+#include <ecs/Narrowphase.h>
+#include <ecs/Gravity.h>
+#include <ecs/PhysicsWorld.h>
+#include <util/FrameStats.h>
+#include <util/SlotMap.h>
+#include <util/BlockPool.h>
 
 namespace kVox {
 
     class PlayerGO;
     class GEngine;
     typedef std::unique_ptr<GEngine> ENGINE_PTR;
+    /** Generational reference to a \c GObject in the scene; goes stale (rather than dangling) once it's removed. */
+    typedef util::SlotHandle GObjectHandle;
+
+    /** Obtains the collision shape that best fits a primitive's mesh, within its \c PrimitiveVAO::GetLocalBounds. */
+    ecs::ColliderShape ColliderShapeOf(PrimitiveType type);
 
     /**
      * The basic game object class within GEngine. <br>
-     * Keeps track of its own transforms, drawable, parent, and children (if any).
+     * A handle onto an entity in the engine's \c ecs::Registry: its transforms, parent link, velocity, and drawable
+     * live in component pools, and this class reads and writes them. Also keeps track of its children (if any).
      */
     class GObject {
         friend class GEngine;
     public:
         GObject() = delete;
         explicit GObject(const Renderer& renderer);
-        ~GObject();
+        virtual ~GObject();
+
+        // game objects (subclasses included) come out of a shared pool; deleting one recycles its block
+        static void* operator new(std::size_t size);
+        static void operator delete(void* ptr, std::size_t size);
+        /** Obtains the pool game objects are allocated from. */
+        static util::BlockPool& Pool();
 
         std::string name;
 
         void SetVAO(VAO* vao);
 
-        void SetPosition(glm::vec3 pos, bool local=false);
+        void SetPosition(glm::dvec3 pos, bool local=false);
         void SetPosition(double x, double y, double z, bool local=false);
         void SetRotation(glm::vec3 rotEuler, bool local);
         void SetRotation(double x, double y, double z, bool local=false);
         void SetScale(glm::vec3 scale, bool local=false);
         void SetScale(double x, double y, double z, bool local=false);
+        // transform setters only mark the object dirty; the engine rebuilds dirty matrices once per tick (and
+        // before drawing), top-down, so setting several things in a row costs one rebuild at most
         void SetVelocity(glm::vec3 vel);
         void SetVelocity(double x, double y, double z);
 
-        glm::vec3 GetPosition();
+        glm::dvec3 GetPosition();
         glm::vec3 GetVelocity();
-        glm::vec3*GetPosAsPtr();
+        /** Position blended between the last two simulation ticks; what cameras should track. */
+        glm::dvec3 GetRenderPos();
         glm::vec3 GetRotEuler();
         glm::quat GetRotation();
         glm::vec3 GetScale();
         glm::vec3 GetOrientation();
-        glm::vec3 GetOrientWithPos();
-        glm::vec3*GetOrientAsPtr();
+        glm::dvec3 GetOrientWithPos();
         glm::vec3 GetForwardDef();
 
-        glm::vec3 GetLocalPos();
-        glm::vec3*GetLocalPosPtr();
+        glm::dvec3 GetLocalPos();
         glm::vec3 GetLocalRotEuler();
         glm::quat GetLocalRot();
         glm::vec3 GetLocalScale();
 
-        /** Called by the game engine every Update cycle. */
+        /**
+         * Attaches this object to a parent (or detaches it, given \c nullptr); its transform becomes relative to
+         * the parent's. Refused, returning false, if \c parent is this object or one of its descendants.
+         */
+        bool SetParent(GObject* parent);
+        GObject* GetParent() const;
+        const std::set<GObject*>& GetChildren() const;
+
+        /** Obtains the entity backing this object. */
+        ecs::Entity GetEntity() const;
+        /** Obtains this object's handle in the scene (null until it's added). */
+        GObjectHandle GetHandle() const;
+
+        /**
+         * Called by the game engine every Update cycle.<br>
+         * Objects update in parallel, on any worker: an override may read other objects, but only change its own.
+         * Scene changes go through \c GEngine::DestroyGameObject and \c GEngine::SpawnGameObject.
+         */
         virtual void Update();
 
         /** Enable physics for this object. */
         void EnablePhys();
         /** Disable physics for this object. */
         void DisablePhys();
-        /** Called by the game engine's physics handler every update. Only impacts phys-enabled objects. */
+        /** Sets how heavy this object is in collisions; 0 (or less) makes it immovable. Needs physics enabled. */
+        void SetMass(float mass);
+        /**
+         * Gives this object a box (in its own space, before rotation and scale) that puts it in the engine's
+         * spatial index, from the next physics step on. Drawables' boxes come from \c PrimitiveVAO::GetLocalBounds.
+         */
+        void EnableBounds(glm::vec3 center, glm::vec3 halfExtents);
+        /** Takes this object out of the spatial index. Not during the object update phase. */
+        void DisableBounds();
+        /**
+         * Makes this object collide, as a member of \c layer, with colliders whose layer is in \c mask (and
+         * whose own mask takes this one's layer). Needs bounds (see \c EnableBounds) to fit \c shape into;
+         * a \c trigger only reports its contacts (\c GEngine::GetNarrowphase), nothing bounces off it.
+         */
+        void EnableCollision(uint32_t layer = ecs::LAYER_DEFAULT, uint32_t mask = ecs::LAYER_ALL,
+                             ecs::ColliderShape shape = ecs::SHAPE_BOX, bool trigger = false);
+        /** Stops this object from colliding. */
+        void DisableCollision();
+        /** Makes this object pull on the others with gravity (and, with physics enabled, be pulled by them). */
+        void EnableGravity(double mass);
+        /** Stops this object from pulling, or being pulled. */
+        void DisableGravity();
+        /** Steps just this object's physics and model matrix. Only impacts phys-enabled objects. */
         void PhysUpdate(double deltaTime);
+        /**
+         * Advances position by velocity without touching any matrices; only impacts phys-enabled objects.<br>
+         * The engine steps every body at once, under gravity (\c ecs::PhysicsWorld); this is the single-object
+         * form, with no forces on it.
+         * @return whether the object moved
+         */
+        bool Integrate(double deltaTime);
 
-        /** Updates this object's model matrix, given its position, rotation, and scale. */
+        /**
+         * Recomputes this object's own model matrix from its transform and its parent's already-resolved one.<br>
+         * Unlike \c UpdateModelMtx, children are left alone, so whole hierarchy levels can be resolved in parallel.
+         */
+        void ResolveTransform();
+
+        /**
+         * Updates this object's model matrix (and its children's) right away, given its position, rotation, and scale.<br>
+         * Only needed when a matrix must be current before the engine's next resolve pass, e.g. during setup.
+         */
         void UpdateModelMtx();
-        /** To be called by a parent GObject, if any */
-        void UpdateModelMtx(glm::mat4 parentModelMtx);
+        /** To be called by a parent GObject, if any, with its world rotation/scale matrix and position */
+        void UpdateModelMtx(glm::mat4 parentModelMtx, const glm::dvec3& parentPos);
+
+        /** Snapshots the current transform as the 'previous tick' state used for render interpolation. */
+        void StoreTickState();
+        /** Blends the previous and current tick states by \c alpha in [0.0,1.0] for rendering. */
+        void Interpolate(double alpha);
 
+    protected:
         GObject* parent = nullptr;
         std::set<GObject*> children;
 
-    protected:
-        bool isPhysEnabled = false;
-        glm::vec3 pos;      // position (x,y,z) in cartesian coordinates
-        glm::vec3 vel;      // velocity (x,y,z) in cartesian coordinates
-        glm::vec3 rot;      // rotation (x,y,z) in Euler angles
-        glm::vec3 scale;    // scale    (x,y,z) in multiples
-        glm::vec3 forward = glm::vec3(0.0,0.0,1.0); // default forward vector
-        glm::vec3 orient;   // updated constantly from rot + pos
-        glm::vec3 localPos, localRot, localScale = glm::vec3(0.0);
+        /** Flags the transform as changed, so the next resolve pass rebuilds this object's (and its children's) matrices. */
+        void MarkDirty();
+
+        // this object's components
+        ecs::Transform& TransformData();
+        ecs::WorldTransform& WorldData();
+        ecs::Velocity& VelocityData();
+
+        ecs::Registry& registry;
+        ecs::Entity entity;
+        GObjectHandle handle;
         const Renderer& renderer;
-        VAO* vao;
     };
 
     class EnemyGO : public GObject {
@@ -99,10 +193,10 @@ namespace kVox {
 
         void Update() override;
     private:
-        void PlayerCollisionCheck();
+        void PlayerCollisionCheck(GObject* player);
 
         const std::string playerObj = "torus";
-        GObject* player;
+        GObjectHandle player;
     };
 
     class GoalGO : public GObject {
@@ -112,10 +206,10 @@ namespace kVox {
 
         void Update() override;
     private:
-        void PlayerCollisionCheck();
+        void PlayerCollisionCheck(PlayerGO* player);
 
         const std::string playerObj = "torus";
-        PlayerGO* player;
+        GObjectHandle player;
     };
 
     class PlayerGO : public GObject {
@@ -127,7 +221,49 @@ namespace kVox {
         void Update() override;
     private:
         const int goalsToWin = 3;
-        int goalCount = 0;
+        /** bumped by goals as they're collected, which may happen on several workers at once */
+        std::atomic<int> goalCount {0};
+        /** the win's been announced, and the game asked to quit */
+        bool won = false;
+    };
+
+    /**
+     * Start-up options for the engine.
+     */
+    struct EngineConfig {
+        /**
+         * Run rendering on its own thread. The simulation thread captures a \c RenderSnapshot each frame and the
+         * render thread (which then owns the GL context) draws it, so frame N+1 is simulated while frame N is
+         * submitted to the GPU.
+         */
+        bool pipelined = false;
+        /**
+         * Run without a window, GL context, or renderer. The simulation is stepped one fixed tick per loop
+         * iteration, as fast as the CPU allows, instead of keeping pace with the wall clock.
+         */
+        bool headless = false;
+        /** Stop after this many simulation ticks; 0 runs until quit. */
+        uint64_t maxTicks = 0;
+        /**
+         * If non-zero, every frame advances the simulation by exactly this many seconds instead of the measured
+         * wall time, so runs are reproducible regardless of how fast frames are drawn (e.g. benchmarks).
+         */
+        double fixedFrameTime = 0.0;
+        /** If set, keyboard and mouse input is recorded to this file, tagged with the tick it applied to. */
+        std::string recordPath;
+        /**
+         * If set, input is played back from a recording made with \c recordPath instead of read from the user,
+         * and the run stops where the recording did. Unless \c fixedFrameTime is set, each frame steps one tick.
+         */
+        std::string replayPath;
+        /** If set, frame statistics are written to \c <statsPath>.csv and \c <statsPath>.json on shutdown. */
+        std::string statsPath;
+        /**
+         * Floating origin: once the active camera is further than this from the engine's origin, the world is
+         * shifted so the camera sits at the origin again (see \c GEngine::RebaseOrigin). 0 keeps the origin put;
+         * positions are doubles and drawing is camera-relative, so this is only needed for very large worlds.
+         */
+        double rebaseDistance = 0.0;
     };
 
     /**
@@ -144,9 +280,10 @@ namespace kVox {
         };
         /**
          * Initializes the engine.
+         * @param config : start-up options
          * @return whether engine was successfully initialized
          */
-        bool Init();
+        bool Init(const EngineConfig& config = EngineConfig());
 
         /**
          * Shuts down the engine.
@@ -157,6 +294,55 @@ namespace kVox {
          * Runs the game loop until done.
          */
         void Run();
+        /**
+         * Asks the game loop to stop, and the process to end with \c exitCode (see \c GetExitCode). Safe from
+         * inside \c GObject::Update on any thread, unlike \c std::exit: the simulation thread stops at the next
+         * phase boundary, and \c Run returns for the engine to be shut down as usual. The first request wins.
+         */
+        void RequestQuit(int exitCode = 0);
+        /** Obtains the code the game asked to quit with, or 0. */
+        int GetExitCode() const;
+
+        /**
+         * Sets the fixed simulation rate, in ticks per second.
+         * @param hz : how many times per second \c GObject updates, anims, and physics are stepped
+         */
+        void SetTickRate(double hz);
+        /** Obtains the fixed simulation step, in seconds per tick. */
+        double GetTickDelta() const;
+        /** Obtains the number of simulation ticks run since the engine started. */
+        uint64_t GetTicksElapsed() const;
+
+        /** Obtains the engine's worker thread pool. */
+        JobSystem& GetJobSystem();
+        /** Obtains the entity/component store that backs every \c GObject. */
+        ecs::Registry& GetRegistry();
+        /** Obtains the scheduler that runs scripted \c kTask coroutines, once per tick after animations. */
+        kScheduler& GetScheduler();
+        /**
+         * Obtains the index of every object with bounds, for proximity queries (radius, box, frustum, nearest).
+         * It's brought up to date at the end of each tick's physics step, and may be queried from anywhere
+         * else, \c GObject::Update included.
+         */
+        ecs::SpatialIndex& GetSpatialIndex();
+        /** Obtains the collision broadphase, whose pairs are those of the latest tick's physics step. */
+        const ecs::Broadphase& GetBroadphase() const;
+        /** Obtains the collision narrowphase, whose contacts (triggers' included) are the latest tick's. */
+        const ecs::Narrowphase& GetNarrowphase() const;
+        /** Obtains the N-body gravity solver, to tune (its mode, opening angle, constant) or inspect. */
+        ecs::Gravity& GetGravity();
+        /** Obtains the integrator that moves every physics body, to tune its substepping or inspect. */
+        ecs::PhysicsWorld& GetPhysicsWorld();
+
+        /** Obtains the rolling statistics of recent frames (ticks, when headless). */
+        const util::FrameStats& GetFrameStats() const;
+        /** Forgets all frame statistics gathered so far (e.g. after a warm-up period). */
+        void ResetFrameStats();
+        /**
+         * Writes the frame statistics to \c <basePath>.csv (per frame) and \c <basePath>.json (summary).
+         * @return whether both files were written
+         */
+        bool DumpFrameStats(const std::string& basePath) const;
 
         /**
          * Obtains the renderer for the game. <br><br>
@@ -165,14 +351,53 @@ namespace kVox {
         Renderer& GetRenderer();
 
         // game object handles
-        /** Returns the \c GObject handle with the given name, or \c nullptr if it doesn't exist. */
+        /** Returns the \c GObject a handle refers to, or \c nullptr if it has since been removed. O(1). */
+        GObject* GetGameObject(GObjectHandle handle);
+        /** Returns the \c GObject with the given name, or \c nullptr if it doesn't exist.<br>
+         *  Looks the name up every call; code that runs every tick should keep a handle instead. */
         GObject* GetGameObject(const std::string& name);
+        /** Returns the handle of the \c GObject with the given name, or a null handle if it doesn't exist. */
+        GObjectHandle FindGameObject(const std::string& name);
         /** Adds a \c GObject with the given name.<br>
-         *  Returns \c true if successful, or \c false if an object with that name already exists. */
-        bool AddGameObject(const std::string& name, GObject* gameObject);
+         *  Returns its handle if successful, or a null handle if an object with that name already exists. */
+        GObjectHandle AddGameObject(const std::string& name, GObject* gameObject);
+        /**
+         * Adds many unnamed \c GObjects at once (e.g. prefab instances); they're only reachable by handle.<br>
+         * Handles are written to \c handles, if given, in the same order.
+         */
+        void AddGameObjects(GObject* const* gameObjects, size_t count, GObjectHandle* handles = nullptr);
+        /** Makes room for \c count more game objects (and their components), ahead of creating them in bulk. */
+        void ReserveGameObjects(size_t count);
         /** Removes the \c GObject with the given name.<br>
          *  Returns \c true if successful, or \c false if an object with that name doesn't exist. */
         bool RemoveGameObject(const std::string& name);
+        /** Removes the \c GObject a handle refers to.<br>
+         *  Returns \c true if successful, or \c false if the handle is stale. */
+        bool RemoveGameObject(GObjectHandle handle);
+        /** Destroys every game object in the scene, then hands the object pool's memory back in one go. */
+        void ClearScene();
+        /**
+         * Queues a game object for destruction at the next phase boundary of the current tick (or the start of
+         * the next one). Unlike \c delete, safe from inside \c GObject::Update on any thread; stale or repeated
+         * handles are ignored.
+         */
+        void DestroyGameObject(GObjectHandle handle);
+        /**
+         * Queues a game object to be created and added under \c name at the next phase boundary. \c create runs
+         * on the simulation thread then, so it may build the object and its drawable as setup code would.
+         * Safe from inside \c GObject::Update on any thread.
+         */
+        void SpawnGameObject(const std::string& name, std::function<GObject*()> create);
+
+        /**
+         * Moves the engine's origin by \c offset (in the current coordinates): every top-level object, drawable,
+         * light, and free camera is shifted by \c -offset, so nothing appears to move. Call on the simulation
+         * thread, outside the object update phase. Code that keeps positions of its own must follow suit, using
+         * \c GetWorldOrigin.
+         */
+        void RebaseOrigin(const glm::dvec3& offset);
+        /** Obtains where the engine's origin is in the world, i.e. how far it was moved by \c RebaseOrigin. */
+        const glm::dvec3& GetWorldOrigin() const;
 
         // input listener registers
         /** Register a key input listener with the engine. */
@@ -200,6 +425,13 @@ namespace kVox {
         // mouse button state getter
         bool IsMouseButtonPressed(uint32_t button);
 
+        /**
+         * Whether input is being played back from a recording (see \c EngineConfig::replayPath).<br>
+         * Listeners should leave out keys with effects outside the simulation (quitting, writing files) while it
+         * is; the replay ends on its own at the tick the recording did.
+         */
+        bool IsReplaying() const;
+
         GEngine(GEngine const&)         = delete;
         void operator=(GEngine const&)  = delete;
 
@@ -209,18 +441,97 @@ namespace kVox {
 
         /** Handles the engine's core game loop */
         bool mRunning = false;
+        /** Value of \c mTickCount when \c Run started; recorded input is tagged relative to it */
+        uint64_t mRunStartTick = 0;
+        /** Input recording/playback, if enabled */
+        kInputRecorder mInputRecorder;
+        /** Opens the input recording or replay requested in the config. */
+        bool StartInputRecorder();
+        /** Feeds replayed input due before the next tick through \c DispatchEvent. */
+        void InjectReplayedInput();
+        /** Options the engine was started with */
+        EngineConfig mConfig;
         /** The renderer core that powers the game engine */
         Renderer mRenderer;
+        /** Worker threads for splitting up per-object simulation work */
+        JobSystem mJobs;
+
+        /** Render thread, when running pipelined */
+        std::thread mRenderThread;
+        /** Snapshots passed from the simulation (this) thread to the render thread */
+        RenderSnapshotBuffer mSnapshots;
+        /** Body of the render thread: draws snapshots until the buffer is closed. */
+        void RenderLoop();
+        /** Stops the render thread, if running, and takes the GL context back. */
+        void StopRenderThread();
+
+        /** Game loop used in headless mode: back-to-back fixed ticks, no outputs. */
+        void RunHeadless();
+
+        /** Where the engine's origin sits in the world */
+        glm::dvec3 mWorldOrigin = glm::dvec3(0.0);
+        /** Rebases the origin onto the active camera if it's strayed beyond \c EngineConfig::rebaseDistance. */
+        void CheckOriginDistance();
 
         /** Measured delta time of the game loop, in seconds per frame */
         double mDeltaTime = 0.016;
+        /** Performance counter value at the start of the last frame */
+        uint64_t mLastCounter = 0;
+
+        /** Fixed simulation step, in seconds per tick */
+        double mTickDelta = 1.0 / 60.0;
+        /** Upper bound on frame time fed to the accumulator, so a long stall can't spiral into endless catch-up */
+        double mMaxFrameTime = 0.25;
+        /** Unsimulated time carried over between frames, in seconds */
+        double mAccumulator = 0.0;
+        /** How far the rendered frame sits between the previous and current tick, in [0.0,1.0] */
+        double mInterpAlpha = 1.0;
+        /** Number of simulation ticks run so far */
+        uint64_t mTickCount = 0;
+
+        /** Per-frame timings and render counters */
+        util::FrameStats mStats;
+        /** The frame being measured; filled in as the loop goes and recorded once outputs are generated */
+        util::FrameStats::FrameSample mFrameSample;
+        /** CPU time the render thread spent on its last frame, in milliseconds */
+        std::atomic<double> mRenderThreadTime {0.0};
 
         // input handler
         bool KEYS[322] = {false};
         bool MOUSE[4] = {false};
 
-        /** The 'scene' -- keeps track of all game objects by name. */
-        std::map<std::string,GObject*> mGameObjects;
+        /** Component storage for every game object */
+        ecs::Registry mRegistry;
+        /** The 'scene' -- every game object, packed, behind generational handles. */
+        util::SlotMap<GObject*> mGameObjects;
+        /** Name -> handle, for one-time lookups by name */
+        std::unordered_map<std::string,GObjectHandle> mObjectNames;
+        /** Flat copy of the scene taken each tick, so gameplay code may add and remove objects mid-update. */
+        std::vector<GObject*> mObjectList;
+        /** Refreshes \c mObjectList from the scene. */
+        void GatherObjects();
+
+        /** Scene changes requested mid-phase, applied by \c ApplySceneCommands */
+        std::mutex mSceneCommandLock;
+        std::vector<GObjectHandle> mPendingDestroys;
+        std::vector< std::pair<std::string, std::function<GObject*()>> > mPendingSpawns;
+        /** Set by \c RequestQuit, from any thread */
+        std::atomic<bool> mQuitRequested {false};
+        std::atomic<int> mExitCode {0};
+        /** Carries out queued destroys, then spawns, then a quit request. Simulation thread only, between phases. */
+        void ApplySceneCommands();
+        /** The scene's parent/child structure, flattened and depth-sorted for resolving world matrices */
+        ecs::TransformHierarchy mHierarchy;
+        /** Where every object with bounds is, for proximity queries */
+        ecs::SpatialIndex mSpatialIndex;
+        /** Finds the colliders that overlap, every physics step */
+        ecs::Broadphase mBroadphase;
+        /** Finds where overlapping colliders touch, and pushes them apart */
+        ecs::Narrowphase mNarrowphase;
+        /** Pulls every body with mass towards every other, every physics step */
+        ecs::Gravity mGravity;
+        /** Steps every physics body's motion, every physics step */
+        ecs::PhysicsWorld mPhysics;
 
         /** High-level listeners (e.g. input) from other components of the game */
         //
@@ -231,6 +542,8 @@ namespace kVox {
         /** High-level animation listener for game objects */
         std::set< std::shared_ptr<kAnimHandler> > goAnimHandlers;
         void HandleAnims(double deltaTime);
+        /** Scripted behaviours, resumed every tick as they come due */
+        kScheduler mScheduler;
 
         /** Simple physics handling system for game objects */
         void HandlePhys(double deltaTime);
@@ -240,14 +553,22 @@ namespace kVox {
          * Process engine inputs.
          */
         void ProcessInput();
+        /** Hands one input event to the engine's input state and listeners. */
+        void DispatchEvent(const SDL_Event& event);
 
         /**
-         * Updates the engine's simulation.
+         * Updates the engine's simulation, running as many fixed ticks as the elapsed time calls for.
          */
         void Update();
 
         /**
-         * Generates outputs.
+         * Steps the simulation forward by exactly one fixed tick.
+         * @param deltaTime : the fixed tick length, in seconds
+         */
+        void Tick(double deltaTime);
+
+        /**
+         * Generates outputs. When pipelined, this only hands a snapshot over to the render thread.
          */
         void GenerateOutputs();
     };
@@ -0,0 +1,102 @@
+//
+// Created by snaki on 12/14/2020.
+//
+
+#ifndef FP_JOBSYSTEM_H
+#define FP_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kVox {
+
+    typedef std::function<void()> Job_t;
+    typedef std::function<void(size_t begin, size_t end)> RangeJob_t;
+
+    /**
+     * Tracks a group of submitted jobs. Waiting on it blocks until every job submitted against it has run.
+     */
+    struct JobCounter {
+        std::atomic<int> pending {0};
+    };
+
+    /**
+     * The engine's work-stealing thread pool.<br>
+     * <br>
+     * Every worker (plus the thread that owns the engine) has its own job queue. Threads run their own newest
+     * jobs first and, when they run dry, steal the oldest jobs from someone else. A thread waiting on a
+     * \c JobCounter runs jobs in the meantime instead of sleeping, so waits act as phase barriers without
+     * wasting a core.
+     */
+    class JobSystem {
+    public:
+        JobSystem() = default;
+        ~JobSystem();
+
+        /**
+         * Starts the worker threads.
+         * @param workerCount : how many workers to spawn; 0 picks one less than the number of hardware threads
+         */
+        void Init(unsigned workerCount = 0);
+
+        /** Stops and joins all worker threads. Jobs still queued are run on the calling thread first. */
+        void Shutdown();
+
+        /** Queues a job to be run by any thread. If \c counter is given, it is incremented now and decremented once the job has run. */
+        void Submit(Job_t job, JobCounter* counter = nullptr);
+
+        /** Blocks until every job submitted against \c counter has run, running queued jobs while it waits. */
+        void Wait(JobCounter& counter);
+
+        /**
+         * Splits [0, count) into ranges of at most \c grain items and runs \c fn over each of them in parallel.<br>
+         * Returns once every range is done, so it doubles as a phase barrier.
+         */
+        void ParallelFor(size_t count, size_t grain, const RangeJob_t& fn);
+
+        /** Obtains how many threads can run jobs, including the calling thread. */
+        unsigned ThreadCount() const;
+
+        JobSystem(JobSystem const&)         = delete;
+        void operator=(JobSystem const&)    = delete;
+
+    private:
+        struct Job {
+            Job_t fn;
+            JobCounter* counter = nullptr;
+        };
+
+        /** Per-thread job queue. The owner works at the back, thieves take from the front. */
+        struct WorkQueue {
+            std::mutex lock;
+            std::deque<Job> jobs;
+        };
+
+        /** Index into \c queues of the calling thread; non-worker threads share queue 0. */
+        static unsigned QueueIndex();
+
+        bool PopOwn(unsigned index, Job& job);
+        bool Steal(unsigned thief, Job& job);
+        /** Runs a single queued job, if any can be found. Returns whether one was run. */
+        bool RunOne(unsigned index);
+        void WorkerLoop(unsigned index);
+
+        std::vector< std::unique_ptr<WorkQueue> > queues;
+        std::vector<std::thread> workers;
+
+        /** Number of jobs sitting in any queue; idle workers sleep while this is zero. */
+        std::atomic<int> queued {0};
+        std::atomic<bool> running {false};
+        std::mutex sleepLock;
+        std::condition_variable wake;
+    };
+}
+
+#endif //FP_JOBSYSTEM_H
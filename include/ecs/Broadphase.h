@@ -0,0 +1,95 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_BROADPHASE_H
+#define FP_BROADPHASE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <ecs/SpatialIndex.h>
+
+namespace kVox::ecs {
+
+    /** Two colliders whose boxes overlap, lower entity first. */
+    typedef std::pair<Entity, Entity> CollisionPair;
+
+    /**
+     * Finds the colliders whose world boxes overlap, by sweep and prune.<br>
+     * <br>
+     * Every entity with a \c Collider, \c Bounds, and \c WorldTransform has its box's two ends along one axis
+     * kept in a sorted list. From one tick to the next things only move a little, so the list stays nearly
+     * sorted and an insertion sort puts it back in order in close to linear time. A sweep along it then only
+     * compares boxes whose extents on that axis overlap, testing the other two axes and the collision layers
+     * on the way.<br>
+     * <br>
+     * At least one side of a pair is a physics body; static colliders (no \c PhysicsBody) are only paired with
+     * moving ones. Runs on the simulation thread, after transforms are resolved.
+     */
+    class Broadphase {
+    public:
+        /** Axis the endpoints are sorted along (0: x, 1: y, 2: z); pick the one things are most spread out on. */
+        int axis = 0;
+
+        /** Brings the colliders and their boxes up to date, and finds this tick's pairs. */
+        void Update(Registry& registry);
+
+        /** Obtains the pairs found by the last \c Update. */
+        const std::vector<CollisionPair>& GetPairs() const { return pairs; }
+        /** Number of colliders taking part. */
+        size_t Size() const { return liveCount; }
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Proxy {
+            Aabb box;
+            Entity entity = NULL_ENTITY;
+            uint32_t layer = 0, mask = 0;
+            bool dynamic = false;
+            bool alive = false;
+            /** the last \c Update that saw it */
+            uint64_t seen = 0;
+            /** where it sits in the sweep's active list, while it's in there */
+            uint32_t activeSlot = NONE;
+        };
+        /** One end of a box along \c axis; \c value is refreshed from the proxy before every sort. */
+        struct Endpoint {
+            float value;
+            /** proxy index << 1, plus 1 for the max end */
+            uint32_t id;
+
+            uint32_t Proxy() const { return id >> 1; }
+            bool IsMax() const { return (id & 1) != 0; }
+        };
+
+        uint32_t AddProxy(Entity entity);
+        void SortEndpoints();
+        void Sweep();
+
+        std::vector<Proxy> proxies;
+        std::vector<uint32_t> freeProxies;
+        /** entity -> proxy index, or \c NONE */
+        std::vector<uint32_t> proxyOf;
+        std::vector<Endpoint> endpoints;
+        size_t liveCount = 0;
+        uint64_t updateCount = 0;
+        int sortedAxis = 0;
+
+        /** A box the sweep is inside of, copied out of its proxy so the inner loop streams through memory. */
+        struct Active {
+            Aabb box;
+            uint32_t layer, mask;
+            uint32_t proxy;
+            bool dynamic;
+        };
+        // sweep state
+        std::vector<Active> active;
+        std::vector<CollisionPair> pairs;
+    };
+}
+
+#endif //FP_BROADPHASE_H
@@ -0,0 +1,155 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_COMPONENTPOOL_H
+#define FP_COMPONENTPOOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace kVox::ecs {
+
+    /** An entity is just an id; everything about it lives in component pools. */
+    typedef uint32_t Entity;
+    constexpr Entity NULL_ENTITY = UINT32_MAX;
+
+    /** Type-erased face of a component pool, so the registry can drop an entity from every pool at once. */
+    class PoolBase {
+    public:
+        virtual ~PoolBase() = default;
+        virtual bool Has(Entity entity) const = 0;
+        virtual void Remove(Entity entity) = 0;
+        virtual size_t Size() const = 0;
+    };
+
+    /**
+     * Sparse-set storage for one component type.<br>
+     * <br>
+     * Components sit packed in one contiguous array (with a parallel array of their owners), so a system that
+     * walks a pool streams straight through memory. A sparse array maps entity ids to slots for random access.
+     * Removal moves the last component into the hole: slots (and any pointers into them) aren't stable
+     * across removals, and iteration order isn't creation order (but see \c Reorder).
+     */
+    template<typename T>
+    class ComponentPool : public PoolBase {
+    public:
+        /** Adds (or replaces) the entity's component. */
+        template<typename... Args>
+        T& Add(Entity entity, Args&&... args) {
+            version++;
+            if (entity >= sparse.size())
+                sparse.resize(entity + 1, EMPTY);
+            if (sparse[entity] != EMPTY) {
+                T& existing = components[sparse[entity]];
+                existing = T{ std::forward<Args>(args)... };
+                return existing;
+            }
+            sparse[entity] = static_cast<uint32_t>(entities.size());
+            entities.push_back(entity);
+            components.push_back(T{ std::forward<Args>(args)... });
+            return components.back();
+        }
+
+        void Remove(Entity entity) override {
+            if (!Has(entity)) return;
+            version++;
+            uint32_t slot = sparse[entity];
+            uint32_t last = static_cast<uint32_t>(entities.size() - 1);
+            if (slot != last) {
+                // keep the arrays packed
+                entities[slot] = entities[last];
+                components[slot] = std::move(components[last]);
+                sparse[entities[slot]] = slot;
+            }
+            entities.pop_back();
+            components.pop_back();
+            sparse[entity] = EMPTY;
+        }
+
+        bool Has(Entity entity) const override {
+            return entity < sparse.size() && sparse[entity] != EMPTY;
+        }
+
+        T& Get(Entity entity) {
+            assert(Has(entity));
+            return components[sparse[entity]];
+        }
+        const T& Get(Entity entity) const {
+            assert(Has(entity));
+            return components[sparse[entity]];
+        }
+        /** Obtains the entity's component, or \c nullptr if it has none. */
+        T* TryGet(Entity entity) {
+            return Has(entity) ? &components[sparse[entity]] : nullptr;
+        }
+
+        size_t Size() const override { return entities.size(); }
+        /** Makes room for \c count more components, so adding them in bulk doesn't keep reallocating. */
+        void Reserve(size_t count) {
+            entities.reserve(entities.size() + count);
+            components.reserve(components.size() + count);
+        }
+
+        // packed access, for systems that stream through the pool
+        /** Obtains the entity owning the component in slot \c i. */
+        Entity EntityAt(size_t i) const { return entities[i]; }
+        /** Obtains the slot holding the entity's component (which it must have). */
+        size_t Slot(Entity entity) const {
+            assert(Has(entity));
+            return sparse[entity];
+        }
+        T& At(size_t i) { return components[i]; }
+        T* Data() { return components.data(); }
+        const std::vector<Entity>& Entities() const { return entities; }
+
+        /**
+         * Moves the components of \c order's entities to the front of the pool, in that order (so the entity at
+         * \c order[i] ends up in slot \c i, if all of them have one). Everything else follows in its old order.<br>
+         * Lets pools that are walked side by side line up slot for slot.
+         */
+        void Reorder(const std::vector<Entity>& order) {
+            std::vector<Entity> newEntities;
+            std::vector<T> newComponents;
+            newEntities.reserve(entities.size());
+            newComponents.reserve(components.size());
+            std::vector<bool> placed(entities.size(), false);
+            for (Entity entity : order) {
+                if (!Has(entity) || placed[sparse[entity]]) continue;
+                placed[sparse[entity]] = true;
+                newEntities.push_back(entity);
+                newComponents.push_back(std::move(components[sparse[entity]]));
+            }
+            for (size_t slot = 0; slot < entities.size(); slot++) {
+                if (placed[slot]) continue;
+                newEntities.push_back(entities[slot]);
+                newComponents.push_back(std::move(components[slot]));
+            }
+            entities.swap(newEntities);
+            components.swap(newComponents);
+            for (size_t slot = 0; slot < entities.size(); slot++) {
+                sparse[entities[slot]] = static_cast<uint32_t>(slot);
+            }
+            version++;
+        }
+
+        /** Bumped by every add, removal, and reorder; slots are only known to line up while it holds still. */
+        uint64_t Version() const { return version; }
+
+    private:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        /** entity id -> slot, or \c EMPTY */
+        std::vector<uint32_t> sparse;
+        /** slot -> owning entity */
+        std::vector<Entity> entities;
+        /** slot -> component */
+        std::vector<T> components;
+        uint64_t version = 0;
+    };
+}
+
+#endif //FP_COMPONENTPOOL_H
@@ -0,0 +1,113 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_COMPONENTS_H
+#define FP_COMPONENTS_H
+
+#include <glm/glm.hpp>
+#include <ecs/ComponentPool.h>
+
+namespace kVox {
+    class VAO;
+}
+
+namespace kVox::ecs {
+
+    /**
+     * Where an entity is, relative to its parent (if any), and where it was as of the last two ticks.<br>
+     * Interpolation state lives here too, so the per-frame passes over it never leave this pool.<br>
+     * Positions are doubles, so objects far from the origin still move in steps much finer than a float's.
+     */
+    struct Transform {
+        glm::dvec3 pos = glm::dvec3(0.0);   // position (x,y,z) in cartesian coordinates
+        glm::vec3 rot = glm::vec3(0.0);     // rotation (x,y,z) in Euler angles
+        glm::vec3 scale = glm::vec3(1.0);   // scale    (x,y,z) in multiples
+        glm::dvec3 prevPos = glm::dvec3(0.0);   // position as of the start of the current simulation tick
+        glm::dvec3 renderPos = glm::dvec3(0.0); // interpolated position for the frame being rendered
+    };
+
+    /**
+     * Resolved placement in the world, after the parent chain has been applied.<br>
+     * The world position is kept apart from the matrix, in double precision; the renderer only turns it into
+     * floats once it's relative to the camera.
+     */
+    struct WorldTransform {
+        glm::mat4 matrix = glm::mat4(1.0);  // last resolved rotation and scale (no translation), for children to build on
+        glm::dvec3 position = glm::dvec3(0.0);  // last resolved world position
+        glm::vec3 forward = glm::vec3(0.0,0.0,1.0); // default forward vector
+        glm::vec3 orient = glm::vec3(0.0);  // updated constantly from rot + pos
+        glm::dvec3 inheritedPos = glm::dvec3(0.0);  // placement taken over from the parent
+        glm::vec3 inheritedRot = glm::vec3(0.0);
+        glm::vec3 inheritedScale = glm::vec3(0.0);
+        bool dirty = true;                  // the local transform changed since \c matrix was last resolved
+        bool changed = false;               // \c matrix / \c position were rebuilt in the latest resolve pass, so children must follow
+        bool moved = true;                  // \c matrix / \c position were rebuilt since the spatial index last looked (only it clears this)
+    };
+
+    /** Which entity this one is attached to, if any; its \c Transform is relative to the parent's world placement. */
+    struct Hierarchy {
+        Entity parent = NULL_ENTITY;
+    };
+
+    /** Linear velocity (x,y,z) in cartesian coordinates. */
+    struct Velocity {
+        glm::vec3 linear = glm::vec3(0.0);
+    };
+
+    /** The entity is moved by physics; how hard it is to push around when it collides. */
+    struct PhysicsBody {
+        float inverseMass = 1.0f;           // 1 / mass; 0 for bodies collisions can't move
+    };
+
+    /**
+     * The entity pulls on (and, with a \c PhysicsBody, is pulled by) every other one that has this, by
+     * \c mass in world units; see \c Gravity.
+     */
+    struct GravityBody {
+        double mass = 1.0;
+    };
+
+    /**
+     * The entity's extent, as a box in its own (local, unscaled) space, for the spatial index to place it by.
+     * The index keeps track of the entity's leaf here.
+     */
+    struct Bounds {
+        glm::vec3 center = glm::vec3(0.0);
+        glm::vec3 halfExtents = glm::vec3(0.5);
+        int32_t proxy = -1;                 // tree node in the spatial index, or -1 if not in it yet
+    };
+
+    /** Collision layers; a collider hits another only if each one's layer is in the other's mask. */
+    enum CollisionLayer : uint32_t {
+        LAYER_DEFAULT = 1u << 0,    // scenery: planets, stations...
+        LAYER_PLAYER = 1u << 1,
+        LAYER_ENEMY = 1u << 2,
+        LAYER_PICKUP = 1u << 3,
+        LAYER_ALL = ~0u
+    };
+
+    /** What a collider is tested as, fitted into its \c Bounds box. */
+    enum ColliderShape : uint8_t {
+        SHAPE_SPHERE,               // the sphere around the box's largest half extent
+        SHAPE_CAPSULE,              // along the box's y axis, as wide as its widest other half extent
+        SHAPE_BOX                   // the box itself, turned with the entity
+    };
+
+    /** Makes the entity take part in collision detection; its box comes from its \c Bounds. */
+    struct Collider {
+        uint32_t layer = LAYER_DEFAULT;
+        uint32_t mask = LAYER_ALL;
+        ColliderShape shape = SHAPE_BOX;
+        bool trigger = false;               // contacts are reported, but nothing bounces off it
+        float restitution = 0.2f;           // bounciness, 0 (none) to 1 (fully elastic)
+        float friction = 0.4f;
+    };
+
+    /** The drawable standing in for the entity, if any. */
+    struct Renderable {
+        VAO* vao = nullptr;
+    };
+}
+
+#endif //FP_COMPONENTS_H
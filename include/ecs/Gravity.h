@@ -0,0 +1,105 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_GRAVITY_H
+#define FP_GRAVITY_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <JobSystem.h>
+
+namespace kVox::ecs {
+
+    /**
+     * N-body gravity between every entity with a \c GravityBody.<br>
+     * <br>
+     * Small systems are summed exactly, every body against every other (O(n^2), in SIMD batches). Large ones
+     * use Barnes-Hut: bodies are sorted along a Morton curve and an octree is built over them, and each body
+     * then walks the tree, taking any cell that looks small enough from where it is (its size over its
+     * distance below \c theta) as a single mass at its center of mass. That's O(n log n), at an error that
+     * grows with \c theta. Key sorting, subtree building, and the walk are all split across the job system.<br>
+     * <br>
+     * Every body pulls; only physics bodies are pulled, so planets without a \c PhysicsBody stay where they
+     * are. \c PhysicsWorld gathers the bodies and asks for their pull at every (sub)step.
+     */
+    class Gravity {
+    public:
+        enum Mode : uint8_t {
+            MODE_AUTO,          // exact up to \c exactLimit bodies, Barnes-Hut past that
+            MODE_EXACT,
+            MODE_BARNES_HUT
+        };
+        Mode mode = MODE_AUTO;
+        /** Most bodies \c MODE_AUTO sums exactly. */
+        size_t exactLimit = 256;
+        /** Barnes-Hut opening angle: cells smaller than this times their distance count as one mass. 0 is exact. */
+        double theta = 0.5;
+        /** The gravitational constant, in world units. */
+        double constant = 1.0;
+        /** Softening length: keeps the pull finite when two bodies pass (nearly) through each other. */
+        double softening = 0.5;
+
+        /**
+         * Computes the pull on each of \c count bodies, given as arrays of positions and masses, into \c ax,
+         * \c ay, \c az.
+         */
+        void ComputeAccelerations(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z,
+                                  const double* mass, double* ax, double* ay, double* az);
+
+        /** Number of bodies in the last computation. */
+        size_t Size() const { return bodyCount; }
+        /** Whether the last computation used the tree, and if so, how many cells it had. */
+        bool UsedTree() const { return usedTree; }
+        size_t NodeCount() const { return nodes.size(); }
+
+    private:
+        /** An octree cell. Nodes are in depth-first order, so a cell's subtree is the nodes up to \c skip. */
+        struct Node {
+            glm::dvec3 center;              // center of mass
+            double mass;
+            glm::dvec3 min;                 // the cell's lowest corner, and its edge length
+            double size;
+            uint32_t begin, count;          // the (sorted) bodies inside it
+            uint32_t skip;                  // the node after this subtree
+            bool leaf;
+        };
+        /** Bodies in Morton order, laid out one component per array. */
+        struct Sorted {
+            std::vector<uint64_t> keys;
+            std::vector<uint32_t> index;    // where each came from in the caller's arrays
+            std::vector<double> x, y, z, mass;
+            std::vector< std::pair<uint64_t, uint32_t> > order;     // (sort scratch)
+        };
+
+        void Exact(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z,
+                   const double* mass, double* ax, double* ay, double* az) const;
+        void SortBodies(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z, const double* mass);
+        void BuildTree(JobSystem& jobs);
+        /**
+         * Builds the subtree over sorted bodies [begin, end) into \c out, depth first. With \c splice, cells at
+         * \c SPLIT_LEVEL are copied in from \c subtrees instead of built. @return the subtree's root
+         */
+        uint32_t BuildNode(std::vector<Node>& out, uint32_t begin, uint32_t end, int level, const glm::dvec3& min,
+                           double size, bool splice) const;
+        void Walk(JobSystem& jobs, double* ax, double* ay, double* az) const;
+
+        // root cell, from the last sort
+        glm::dvec3 rootMin;
+        double rootSize = 0.0;
+        Sorted sorted;
+        std::vector<Node> nodes;
+        /** subtrees below the levels built on the calling thread, one per cell at that level */
+        std::vector< std::vector<Node> > subtrees;
+        std::vector<uint32_t> subtreeBegin;
+
+        size_t bodyCount = 0;
+        bool usedTree = false;
+    };
+}
+
+#endif //FP_GRAVITY_H
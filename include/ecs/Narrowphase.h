@@ -0,0 +1,131 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_NARROWPHASE_H
+#define FP_NARROWPHASE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <ecs/Broadphase.h>
+
+namespace kVox::ecs {
+
+    /** Where two colliders touch: up to four points sharing one normal. */
+    struct ContactManifold {
+        Entity a = NULL_ENTITY, b = NULL_ENTITY;
+        glm::vec3 normal = glm::vec3(0.0, 1.0, 0.0);    // from \c a towards \c b
+        float depth = 0.0f;                 // how far they overlap along \c normal
+        glm::dvec3 points[4];               // in world (engine) coordinates
+        uint8_t pointCount = 0;
+        bool trigger = false;               // one side is a trigger, so neither was pushed
+    };
+
+    /**
+     * Turns the broadphase's pairs into contacts, and pushes the bodies apart.<br>
+     * <br>
+     * Each collider is tested as the \c ColliderShape fitted into its bounds. Spheres against spheres and
+     * spheres against boxes are done a batch of 8 (AVX) or 4 (SSE) pairs at a time, from arrays laid out one
+     * component per array; capsules join those batches as the sphere at their segment's point nearest the other
+     * shape, so only box against box (separating axis test over the 15 candidate axes) is left to one pair at a
+     * time. Pairs found touching get a manifold.<br>
+     * <br>
+     * Response is by sequential impulses on linear velocity (bodies have no angular state), with restitution
+     * and friction, then a positional correction for whatever overlap is left, taken into the parent's frame
+     * for attached bodies; the corrected positions are resolved with the next tick's transforms. Colliders without a \c PhysicsBody don't move. Runs on the
+     * simulation thread, after the broadphase.
+     */
+    class Narrowphase {
+    public:
+        /** Solver passes over the contacts per tick; more settles stacks better. */
+        int iterations = 4;
+        /** Overlap that's left alone, in world units, so resting contacts don't jitter. */
+        float slop = 0.01f;
+        /** Share of the remaining overlap undone every tick. */
+        float correction = 0.8f;
+
+        /** Finds the contacts among \c pairs, and responds to them. */
+        void Update(Registry& registry, const std::vector<CollisionPair>& pairs);
+
+        /** Obtains the contacts found by the last \c Update. */
+        const std::vector<ContactManifold>& GetContacts() const { return contacts; }
+
+    private:
+        /** A collider's shape in the world, built once per tick however many pairs it's in. */
+        struct Shape {
+            glm::dvec3 center;
+            glm::mat3 axes;                 // unit axes of the box (the capsule runs along axes[1])
+            glm::vec3 halfExtents;          // box only
+            float radius;                   // sphere / capsule
+            float segmentHalf;              // capsule: half the length of its core segment
+            ColliderShape type;
+            bool trigger;
+        };
+        /** Pairs down to a sphere each, tested a batch at a time. */
+        struct SphereBatch {
+            std::vector<float> dx, dy, dz, reach;   // b's center minus a's, and the sum of the radii
+            struct Entry { uint32_t contact; glm::dvec3 centerA; float radiusA; };
+            std::vector<Entry> entries;
+
+            void Clear();
+            void Push(uint32_t contact, const glm::dvec3& centerA, float radiusA, const glm::dvec3& centerB, float radiusB);
+        };
+        /** Boxes against spheres, tested a batch at a time in the box's frame. */
+        struct BoxBatch {
+            std::vector<float> px, py, pz;          // the sphere's center, relative to the box's
+            std::vector<float> axes[9];             // the box's axes, column by column
+            std::vector<float> hx, hy, hz, radius;
+            struct Entry { uint32_t contact; uint32_t box; bool flip; };             // flip: the box is the pair's b
+            std::vector<Entry> entries;
+
+            void Clear();
+            void Push(uint32_t contact, uint32_t box, const Shape& boxShape, const glm::dvec3& center, float sphereRadius, bool flip);
+        };
+        /** One contact, as the solver sees it. */
+        struct Constraint {
+            Transform* ta; Transform* tb;
+            WorldTransform* wa; WorldTransform* wb;
+            const WorldTransform* pa; const WorldTransform* pb;     // parents, for bodies that have one
+            Velocity* va; Velocity* vb;
+            float invA, invB;
+            float restitution, friction;
+            float targetSpeed;              // separating speed the normal impulse aims for
+            glm::vec3 tangent;              // way the contact was sliding when it started, for friction
+            float normalImpulse, tangentImpulse;
+            uint32_t contact;
+        };
+
+        /** The pools shapes are built from, looked up once per \c Update rather than per entity. */
+        struct Pools {
+            ComponentPool<Collider>& colliders;
+            ComponentPool<Bounds>& bounds;
+            ComponentPool<WorldTransform>& worlds;
+        };
+
+        uint32_t ShapeOf(Pools& pools, Entity entity);
+        void Dispatch(uint32_t contact, uint32_t a, uint32_t b);
+        void TestSpheres();
+        void TestBoxSpheres();
+        bool TestBoxes(ContactManifold& manifold, const Shape& a, const Shape& b) const;
+        void Solve(Registry& registry);
+
+        std::vector<Shape> shapes;
+        /** entity -> its shape this tick, when \c shapeStamp matches \c updateCount */
+        std::vector<uint32_t> shapeOf;
+        std::vector<uint64_t> shapeStamp;
+        uint64_t updateCount = 0;
+
+        /** every pair, as a manifold to fill in; \c contacts keeps just the ones that touch */
+        std::vector<ContactManifold> candidates;
+        std::vector<uint8_t> touching;
+        std::vector<ContactManifold> contacts;
+        SphereBatch spheres;
+        BoxBatch boxSpheres;
+        std::vector<Constraint> constraints;
+    };
+}
+
+#endif //FP_NARROWPHASE_H
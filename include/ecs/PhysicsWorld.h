@@ -0,0 +1,94 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_PHYSICSWORLD_H
+#define FP_PHYSICSWORLD_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <ecs/Gravity.h>
+#include <JobSystem.h>
+
+namespace kVox::ecs {
+
+    /**
+     * Moves every physics body, under gravity, once per tick.<br>
+     * <br>
+     * Bodies are copied out of their components into arrays, one component per array, and stepped there with
+     * kick-drift-kick leapfrog (velocity Verlet): half a kick from the pull, a drift at the new velocity, and
+     * the other half kick from the pull where the body ended up. It's symplectic, so orbits keep their energy
+     * over time where Euler would spiral them out, at the same one pull per step. When a tick is too long for
+     * the strongest pull (see \c accuracy), it's split into equal substeps. Kicks and drifts run over the
+     * arrays in AVX (or SSE2) batches, split across the job system; transforms and velocities are written back
+     * once, at the end of the tick.<br>
+     * <br>
+     * \c GravityBody entities without a \c PhysicsBody pull but stay put. Physics bodies without a
+     * \c GravityBody just drift, and only if they're moving at all. Runs on the simulation thread; bodies that
+     * moved are marked dirty, to be picked up by the next transform resolve.
+     */
+    class PhysicsWorld {
+    public:
+        /**
+         * How finely ticks are split: substeps are kept under \c accuracy times the time a body takes to
+         * cross the gravity's softening length from rest under the strongest pull there is.
+         */
+        double accuracy = 0.2;
+        /** Most substeps a tick is split into, however strong the pull. */
+        int maxSubsteps = 16;
+
+        /** Steps every physics body by \c deltaTime, pulled by everything \c gravity knows of. */
+        void Step(Registry& registry, JobSystem& jobs, Gravity& gravity, double deltaTime);
+
+        /** Number of bodies moved in the last step, and how many substeps it took. */
+        size_t Size() const { return links.size(); }
+        int Substeps() const { return substeps; }
+
+    private:
+        /** Where a body's stepped state goes back to. */
+        struct Link {
+            Transform* transform;
+            Velocity* velocity;
+            WorldTransform* world;
+            glm::dvec3 origin;              // its parent's world position, for bodies that have one
+        };
+
+        void Gather(Registry& registry);
+        /** Gravity's tunables, as far as they change what it computes. */
+        struct GravitySettings {
+            Gravity::Mode mode;
+            size_t exactLimit;
+            double theta, constant, softening;
+
+            bool operator==(const GravitySettings&) const = default;
+        };
+        static GravitySettings SettingsOf(const Gravity& gravity);
+
+        /**
+         * Whether gravity's sources are exactly where (and as heavy as) they were at the end of the last step,
+         * and gravity is set up as it was then.
+         */
+        bool SourcesUnchanged(const Gravity& gravity, size_t sources) const;
+        /** The strongest pull on any body, from \c ax, \c ay, \c az. */
+        double StrongestPull() const;
+        void Kick(JobSystem& jobs, double h);
+        void Drift(JobSystem& jobs, double h);
+        void WriteBack(JobSystem& jobs);
+
+        // every body, laid out [attractors | pulled bodies | free bodies]; gravity sees the first two runs,
+        // and only the last two move
+        std::vector<double> x, y, z, vx, vy, vz, ax, ay, az, mass;
+        size_t attractorCount = 0, pulledCount = 0;
+        /** one per moving body, from index \c attractorCount on */
+        std::vector<Link> links;
+        int substeps = 0;
+        /** the sources as of the last pull, which \c ax, \c ay, \c az still hold; unchanged, it isn't redone */
+        std::vector<double> lastX, lastY, lastZ, lastMass;
+        GravitySettings lastSettings {};
+    };
+}
+
+#endif //FP_PHYSICSWORLD_H
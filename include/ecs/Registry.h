@@ -0,0 +1,122 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_REGISTRY_H
+#define FP_REGISTRY_H
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <ecs/ComponentPool.h>
+
+namespace kVox::ecs {
+
+    /** Hands out a new dense id per component type (see \c ComponentTypeId). */
+    size_t NextComponentTypeId();
+
+    /** Obtains the small integer id the registry files \c T's pool under. */
+    template<typename T>
+    size_t ComponentTypeId() {
+        static const size_t id = NextComponentTypeId();
+        return id;
+    }
+
+    /**
+     * A typed query over every entity that has all of \c Ts.<br>
+     * <br>
+     * Iteration walks the first component type's pool in slot order and looks the others up, so list the
+     * rarest component first (e.g. a tag that few entities carry).
+     */
+    template<typename... Ts>
+    class View {
+    public:
+        explicit View(ComponentPool<Ts>&... pools) : pools(&pools...) {}
+
+        /** Number of slots in the driving pool; an upper bound on how many entities match. */
+        size_t Size() const { return std::get<0>(pools)->Size(); }
+
+        /** Calls \c fn(entity, Ts&...) for every match. */
+        template<typename F>
+        void Each(F&& fn) { Each(0, Size(), std::forward<F>(fn)); }
+
+        /**
+         * Calls \c fn(entity, Ts&...) for the matches among driving-pool slots [begin, end).<br>
+         * Disjoint ranges touch disjoint entities, so they can run on different workers.
+         */
+        template<typename F>
+        void Each(size_t begin, size_t end, F&& fn) {
+            auto* driver = std::get<0>(pools);
+            for (size_t i = begin; i < end; i++) {
+                Entity entity = driver->EntityAt(i);
+                if (!(std::get<ComponentPool<Ts>*>(pools)->Has(entity) && ...)) continue;
+                fn(entity, std::get<ComponentPool<Ts>*>(pools)->Get(entity)...);
+            }
+        }
+
+    private:
+        std::tuple<ComponentPool<Ts>*...> pools;
+    };
+
+    /**
+     * Owns every entity and component in the scene.<br>
+     * <br>
+     * Each component type gets its own sparse-set pool (see \c ComponentPool), so data of one kind is packed
+     * together regardless of which entities own it. Not thread-safe for structural changes: create and destroy
+     * entities, and add or remove components, from the simulation thread only. Workers may read and write
+     * components of pools that already exist.
+     */
+    class Registry {
+    public:
+        /** Makes a new entity with no components. Ids of destroyed entities are reused. */
+        Entity Create();
+        /** Destroys an entity along with all its components. */
+        void Destroy(Entity entity);
+        /** Whether the entity exists. */
+        bool Valid(Entity entity) const;
+        /** Number of live entities. */
+        size_t Alive() const;
+        /** Makes room for \c count more entities with a \c T each, ahead of creating them in bulk. */
+        template<typename T>
+        void Reserve(size_t count) { Pool<T>().Reserve(count); }
+
+        template<typename T, typename... Args>
+        T& Add(Entity entity, Args&&... args) {
+            assert(Valid(entity));
+            return Pool<T>().Add(entity, std::forward<Args>(args)...);
+        }
+        template<typename T>
+        void Remove(Entity entity) { Pool<T>().Remove(entity); }
+        template<typename T>
+        bool Has(Entity entity) { return Pool<T>().Has(entity); }
+        template<typename T>
+        T& Get(Entity entity) { return Pool<T>().Get(entity); }
+        template<typename T>
+        T* TryGet(Entity entity) { return Pool<T>().TryGet(entity); }
+
+        /** Obtains the pool for a component type, creating it on first use. */
+        template<typename T>
+        ComponentPool<T>& Pool() {
+            size_t id = ComponentTypeId<T>();
+            if (id >= pools.size())
+                pools.resize(id + 1);
+            if (!pools[id])
+                pools[id] = std::make_unique<ComponentPool<T>>();
+            return static_cast<ComponentPool<T>&>(*pools[id]);
+        }
+
+        /** Obtains a query over the entities that have all of \c Ts. */
+        template<typename... Ts>
+        ecs::View<Ts...> View() { return ecs::View<Ts...>(Pool<Ts>()...); }
+
+    private:
+        std::vector< std::unique_ptr<PoolBase> > pools;
+        /** per id: whether an entity currently holds it */
+        std::vector<bool> alive;
+        std::vector<Entity> freeIds;
+        size_t aliveCount = 0;
+    };
+}
+
+#endif //FP_REGISTRY_H
@@ -0,0 +1,129 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_SPATIALINDEX_H
+#define FP_SPATIALINDEX_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+
+namespace kVox::ecs {
+
+    /** An axis-aligned box, in the engine's (float) world coordinates. */
+    struct Aabb {
+        glm::vec3 min = glm::vec3(0.0);
+        glm::vec3 max = glm::vec3(0.0);
+
+        bool Contains(const Aabb& other) const {
+            return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+        }
+        bool Overlaps(const Aabb& other) const {
+            // (bitwise, not short-circuit: one well-predicted branch instead of six coin tosses)
+            return (min.x <= other.max.x) & (min.y <= other.max.y) & (min.z <= other.max.z)
+                   & (max.x >= other.min.x) & (max.y >= other.min.y) & (max.z >= other.min.z);
+        }
+        /** Half the surface area; only ever compared, so the factor of two is left out. */
+        float HalfArea() const {
+            glm::vec3 d = max - min;
+            return d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+        /** Squared distance from \c point to the box (0 inside it). */
+        float DistanceSq(const glm::vec3& point) const {
+            glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0));
+            return glm::dot(d, d);
+        }
+        static Aabb Union(const Aabb& a, const Aabb& b) {
+            return Aabb { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+        }
+    };
+
+    /** Obtains the world box around an entity's \c Bounds, given its resolved placement. */
+    Aabb WorldBounds(const Bounds& bounds, const WorldTransform& world);
+
+    /**
+     * Spatial index over every entity with \c Bounds: a dynamic AABB tree, kept up to date incrementally.<br>
+     * <br>
+     * Each entity is a leaf holding a "fat" box, its world box grown by a margin, so small moves don't touch
+     * the tree at all; only a leaf whose entity leaves its fat box is taken out and reinserted, and inserts go
+     * down the cheapest branch by surface area, with AVL-style rotations keeping the tree balanced. Queries
+     * (box, radius, frustum, k-nearest) then only descend into branches whose boxes they reach, which is
+     * logarithmic in the entity count for local queries.<br>
+     * <br>
+     * \c Update runs on the simulation thread, after transforms are resolved; queries only read, so any number
+     * of them may run at once (e.g. from \c GObject::Update) as long as no \c Update is in progress. Results
+     * come from fat boxes, so they may include entities up to \c margin outside the query.
+     */
+    class SpatialIndex {
+    public:
+        /** How far leaf boxes are grown past their entity's, in world units. */
+        float margin = 0.5f;
+
+        /**
+         * Brings the tree up to date with the registry: inserts entities that gained \c Bounds, and moves those
+         * placed anew since the last update, by whichever resolve (see \c WorldTransform::moved).
+         */
+        void Update(Registry& registry);
+        /** Takes an entity out of the tree (e.g. when it's destroyed or loses its \c Bounds). */
+        void Remove(Bounds& bounds);
+
+        /** Appends every entity whose box overlaps \c box to \c out. */
+        void QueryAabb(const Aabb& box, std::vector<Entity>& out) const;
+        /** Appends every entity whose box comes within \c radius of \c center to \c out. */
+        void QueryRadius(const glm::vec3& center, float radius, std::vector<Entity>& out) const;
+        /**
+         * Appends every entity whose box is at least partly inside the frustum of \c viewProjMtx to \c out.<br>
+         * The matrix maps the index's coordinates to clip space; with camera-relative matrices, fold the eye
+         * position back in first (\c viewProj * translate(-eye)).
+         */
+        void QueryFrustum(const glm::mat4& viewProjMtx, std::vector<Entity>& out) const;
+        /**
+         * Writes the (up to) \c k entities nearest to \c point to \c out, closest first, measured to their
+         * boxes. \c out is cleared first.
+         */
+        void QueryNearest(const glm::vec3& point, size_t k, std::vector<Entity>& out) const;
+
+        /** Number of entities in the tree. */
+        size_t Size() const { return leafCount; }
+        /** Height of the tree (0 when empty); stays around log2 of \c Size. */
+        int32_t Height() const;
+
+    private:
+        static constexpr int32_t NONE = -1;
+
+        struct Node {
+            Aabb box;
+            int32_t parent = NONE;
+            /** children, or \c NONE for leaves; doubles as the free list link in \c left */
+            int32_t left = NONE, right = NONE;
+            /** leaves are 0; \c NONE marks a free node */
+            int32_t height = 0;
+            Entity entity = NULL_ENTITY;
+
+            bool IsLeaf() const { return left == NONE; }
+        };
+
+        int32_t AllocateNode();
+        void FreeNode(int32_t node);
+        void InsertLeaf(int32_t leaf);
+        void RemoveLeaf(int32_t leaf);
+        /** Rotates the subtree at \c a if it's out of balance. @return the subtree's new root */
+        int32_t Balance(int32_t a);
+        /** Refits boxes and heights from \c node up to the root, rebalancing on the way. */
+        void Refit(int32_t node);
+
+        /** Calls \c visit(entity) for every leaf whose box passes \c test, a predicate on boxes. */
+        template<typename Test, typename Visit>
+        void Walk(Test&& test, Visit&& visit) const;
+
+        std::vector<Node> nodes;
+        int32_t root = NONE;
+        int32_t freeList = NONE;
+        size_t leafCount = 0;
+    };
+}
+
+#endif //FP_SPATIALINDEX_H
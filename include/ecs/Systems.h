@@ -0,0 +1,25 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_SYSTEMS_H
+#define FP_SYSTEMS_H
+
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <JobSystem.h>
+
+namespace kVox::ecs {
+
+    /**
+     * Per-tick and per-frame passes over whole component pools. Each one walks packed arrays in slot order,
+     * split across the job system, and only ever writes the component it's visiting.
+     */
+
+    /** Snapshots every transform (and drawable matrix) as the 'previous tick' state used for interpolation. */
+    void StoreTickState(Registry& registry, JobSystem& jobs);
+    /** Blends every entity's previous and current tick positions by \c alpha in [0.0,1.0] for rendering. */
+    void InterpolateTransforms(Registry& registry, JobSystem& jobs, double alpha);
+}
+
+#endif //FP_SYSTEMS_H
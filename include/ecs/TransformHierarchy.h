@@ -0,0 +1,66 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_TRANSFORMHIERARCHY_H
+#define FP_TRANSFORMHIERARCHY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <ecs/Registry.h>
+#include <ecs/Components.h>
+#include <JobSystem.h>
+
+namespace kVox::ecs {
+
+    /** Builds an entity's local model matrix from its rotation and scale (positions stay in double, apart). */
+    glm::mat4 ComposeLocalMatrix(const Transform& transform);
+
+    /**
+     * The scene's parent/child structure, flattened for resolving world matrices in bulk.<br>
+     * <br>
+     * Every entity with a \c Hierarchy, \c Transform, \c WorldTransform, and \c Renderable is a node. Nodes are
+     * sorted by depth (roots first) and those four pools are reordered to match, so node \c i is slot \c i of
+     * each of them and its parent is a slot index further up. Resolving is then one sweep over packed arrays,
+     * a level at a time, with the parent * local products done in SIMD batches (\c util::MultiplyMatrices).<br>
+     * <br>
+     * The layout is rebuilt whenever any of those pools changed shape (entities added or removed, parents
+     * reassigned), which is rare next to how often matrices are resolved.
+     */
+    class TransformHierarchy {
+    public:
+        /**
+         * Rebuilds the world matrix of every dirty node and of everything below one, and hands the new matrices
+         * to their drawables. Clears \c dirty and sets \c changed on each node it rebuilt.
+         */
+        void Resolve(Registry& registry, JobSystem& jobs);
+
+        /** Number of nodes as of the last rebuild. */
+        size_t NodeCount() const;
+        /** Number of levels (the deepest node's depth plus one) as of the last rebuild. */
+        size_t LevelCount() const;
+
+    private:
+        static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+        /** Whether any of the node pools changed shape since the last rebuild. */
+        bool IsStale(Registry& registry) const;
+        /** Sorts the nodes by depth and lines the node pools up behind them. */
+        void Rebuild(Registry& registry);
+
+        /** node -> its parent's node index, or \c NO_PARENT */
+        std::vector<uint32_t> parents;
+        /** level -> index of its first node; one extra entry marks the end */
+        std::vector<size_t> levelStarts;
+        /** pool versions the layout was built against: hierarchy, transform, world transform, renderable */
+        uint64_t versions[4] = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX };
+
+        // rebuild scratch, kept to avoid reallocating
+        std::vector<int32_t> depths;
+        std::vector<Entity> chain;
+        std::vector<Entity> order;
+    };
+}
+
+#endif //FP_TRANSFORMHIERARCHY_H
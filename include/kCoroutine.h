@@ -0,0 +1,152 @@
+//
+// Created by snaki on 12/20/2020.
+//
+
+#ifndef FP_KCOROUTINE_H
+#define FP_KCOROUTINE_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace kVox {
+    class kScheduler;
+
+    /**
+     * A scripted behaviour, written as a C++20 coroutine and run by a \c kScheduler.<br>
+     * <br>
+     * Any function returning \c kTask may \c co_await \c NextFrame(), \c Seconds(t), or \c Until(pred):
+     * <pre>
+     *     kTask Blink(GObject* go) {
+     *         for (;;) {
+     *             go->SetScale(glm::vec3(0.0));
+     *             co_await Seconds(0.5);
+     *             go->SetScale(glm::vec3(1.0));
+     *             co_await Seconds(0.5);
+     *         }
+     *     }
+     *     engine.GetScheduler().Start(Blink(go));
+     * </pre>
+     * Nothing runs until the task is handed to \c kScheduler::Start. Coroutine frames come from a pool,
+     * so starting thousands of scripts doesn't hit the general-purpose allocator.
+     */
+    class kTask {
+    public:
+        struct promise_type {
+            kScheduler* scheduler = nullptr;
+
+            kTask get_return_object() { return kTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept;
+
+            // coroutine frames are pooled
+            static void* operator new(std::size_t size);
+            static void operator delete(void* ptr, std::size_t size);
+        };
+        using Handle = std::coroutine_handle<promise_type>;
+
+        kTask(kTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+        kTask& operator=(kTask&& other) noexcept;
+        kTask(kTask const&)             = delete;
+        void operator=(kTask const&)    = delete;
+        /** Destroys the coroutine if it was never started. */
+        ~kTask();
+
+    private:
+        friend class kScheduler;
+        explicit kTask(Handle h) : handle(h) {}
+        /** Gives up ownership of the coroutine (to the scheduler). */
+        Handle Release();
+
+        Handle handle;
+    };
+
+    /** Suspends a task until the next simulation tick. */
+    struct NextFrame {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(kTask::Handle h) const;
+        void await_resume() const noexcept {}
+    };
+
+    /** Suspends a task for (at least) the given amount of simulation time. Costs nothing while asleep. */
+    struct Seconds {
+        explicit Seconds(double duration) : duration(duration) {}
+        bool await_ready() const noexcept { return duration <= 0.0; }
+        void await_suspend(kTask::Handle h) const;
+        void await_resume() const noexcept {}
+
+        double duration;
+    };
+
+    /** Suspends a task until a condition holds. The condition is checked once per tick while waiting. */
+    struct Until {
+        explicit Until(std::function<bool()> predicate) : predicate(std::move(predicate)) {}
+        bool await_ready() const { return predicate(); }
+        void await_suspend(kTask::Handle h);
+        void await_resume() const noexcept {}
+
+        std::function<bool()> predicate;
+    };
+
+    /**
+     * Runs \c kTask coroutines against simulation time.<br>
+     * <br>
+     * Tasks waiting on \c Seconds sit in a timer heap and aren't looked at until they're due, so sleeping tasks
+     * cost nothing per tick; \c NextFrame waiters are simply resumed in order. Not thread-safe: start and
+     * run tasks from the simulation thread.
+     */
+    class kScheduler {
+    public:
+        ~kScheduler();
+
+        /** Starts a task: it runs right away until its first \c co_await. */
+        void Start(kTask&& task);
+        /**
+         * Advances simulation time and resumes every task that's due.
+         * @param deltaTime : the simulation step, in seconds
+         */
+        void Tick(double deltaTime);
+        /** Destroys every suspended task without resuming it. */
+        void StopAll();
+
+        /** Obtains the simulation time the scheduler has seen, in seconds. */
+        double Now() const;
+        /** Obtains how many tasks are currently suspended. */
+        size_t TaskCount() const;
+
+    private:
+        friend struct NextFrame;
+        friend struct Seconds;
+        friend struct Until;
+
+        struct Timer {
+            double wakeTime;
+            /** order of arrival; breaks ties so equal wake times resume in the order they slept */
+            uint64_t seq;
+            kTask::Handle handle;
+        };
+        struct Condition {
+            std::function<bool()> predicate;
+            kTask::Handle handle;
+        };
+        /** Orders the timer heap soonest-first. */
+        static bool Later(const Timer& a, const Timer& b);
+
+        /** Resumes a task, cleaning it up if it ran to completion. */
+        void Resume(kTask::Handle handle);
+
+        double now = 0.0;
+        uint64_t timerSeq = 0;
+        std::vector<kTask::Handle> nextFrame;
+        std::vector<kTask::Handle> resuming;
+        std::vector<Timer> timers;
+        std::vector<Condition> conditions;
+        std::vector<Condition> checking;
+    };
+}
+
+#endif //FP_KCOROUTINE_H
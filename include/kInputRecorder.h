@@ -0,0 +1,93 @@
+//
+// Created by snaki on 12/19/2020.
+//
+
+#ifndef FP_KINPUTRECORDER_H
+#define FP_KINPUTRECORDER_H
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace kVox {
+
+    /**
+     * Records keyboard and mouse input to a file, tagged with the simulation tick it applied to, and plays
+     * it back later so a session can be repeated exactly (e.g. to compare builds on the same workload).<br>
+     * <br>
+     * File layout: a header (magic "KVIR", version byte, tick length as a raw double), then one record per
+     * event. Records store the tick and SDL timestamp as deltas from the previous record, and event fields as
+     * variable-length integers, so most events take only a handful of bytes. An end record marks the tick
+     * the session stopped at.<br>
+     * <br>
+     * Recorded input is buffered in memory and written out in large chunks; replays load the whole file up front.
+     */
+    class kInputRecorder {
+    public:
+        ~kInputRecorder();
+
+        /**
+         * Starts recording to a file, replacing it if it exists.
+         * @param tickDelta : the simulation's tick length, in seconds, stored so replays can match it
+         * @return whether the file could be opened
+         */
+        bool StartRecording(const std::string& path, double tickDelta);
+        /**
+         * Loads a recording for playback.
+         * @return whether the file could be read and is a valid recording
+         */
+        bool StartReplay(const std::string& path);
+        /** Finishes a recording (writing the end tick) or a replay. Safe to call more than once. */
+        void Stop(uint64_t tick);
+
+        bool IsRecording() const;
+        bool IsReplaying() const;
+
+        /** Whether an event is input worth recording (keyboard and mouse). */
+        static bool IsRecordable(const SDL_Event& event);
+        /** Records an input event that takes effect before the given tick. */
+        void Record(const SDL_Event& event, uint64_t tick);
+
+        /**
+         * Obtains the next recorded event that takes effect before (or at the start of) the given tick, if any.
+         * @return false once no more events are due by \c tick
+         */
+        bool NextEvent(uint64_t tick, SDL_Event& event);
+        /** Whether the replay has reached the tick the recording ended at. */
+        bool ReplayFinished(uint64_t tick) const;
+
+        /** Obtains the tick length the replay was recorded with, in seconds. */
+        double GetRecordedTickDelta() const;
+
+    private:
+        /** Kinds of records in the file. */
+        enum RecordKind : uint8_t {
+            END = 0, KEY_DOWN, KEY_UP, MOUSE_DOWN, MOUSE_UP, MOUSE_MOTION
+        };
+
+        void Flush();
+
+        // writing
+        FILE* file = nullptr;
+        std::vector<uint8_t> writeBuffer;
+        uint64_t lastTick = 0;
+        uint32_t lastTimestamp = 0;
+
+        // reading
+        bool replaying = false;
+        std::vector<uint8_t> data;
+        size_t readPos = 0;
+        /** the next event, already decoded; valid if \c hasNext */
+        SDL_Event next {};
+        uint64_t nextTick = 0;
+        bool hasNext = false;
+        uint64_t endTick = UINT64_MAX;
+        double recordedTickDelta = 0.0;
+        /** Decodes the record at \c readPos into \c next (or sets \c endTick). */
+        void DecodeNext();
+    };
+}
+
+#endif //FP_KINPUTRECORDER_H
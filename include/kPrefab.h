@@ -0,0 +1,76 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_KPREFAB_H
+#define FP_KPREFAB_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <GEngine.h>
+
+namespace kVox {
+
+    /**
+     * A template for game objects that come in numbers (enemies, goal rings, debris...): which class they are,
+     * what they look like, and how they start out, described once and stamped out in bulk by \c Spawn.<br>
+     * <br>
+     * Instances share the prefab's mesh, shader, and material. Primitive meshes are tessellated once by the
+     * primitive library and drawn from there, so an instance's drawable holds no GL objects of its own, only
+     * its model matrix and a copy of the material. Instances are unnamed; keep their handles to get at them.
+     * <pre>
+     *     kPrefab enemy;
+     *     enemy.create = kPrefab::Of<EnemyGO>();
+     *     enemy.mesh = PrimitiveType::CYLINDER;
+     *     enemy.scale = glm::vec3(2.0);
+     *     enemy.physics = true;
+     *     enemy.Spawn(engine, placements.size(), placements.data());
+     * </pre>
+     */
+    class kPrefab {
+    public:
+        /** Where one instance goes. */
+        struct Placement {
+            glm::dvec3 pos = glm::dvec3(0.0);
+            glm::vec3 rot = glm::vec3(0.0);     // Euler angles
+            glm::vec3 scale = glm::vec3(1.0);   // on top of the prefab's own scale
+        };
+
+        /** Makes an instance's game object; plain \c GObjects if unset. */
+        std::function<GObject*(const Renderer&)> create;
+        /** Whether instances are drawn at all (invisible anchors, triggers...). */
+        bool drawable = true;
+        PrimitiveType mesh = PrimitiveType::CUBE;
+        std::string shader = "lighting";
+        VAOMatProps material { glm::vec3(0.9), glm::vec3(1.0), glm::vec3(0.1), 0.4 };
+        glm::vec3 scale = glm::vec3(1.0);
+        /** Whether instances are moved by physics, and how fast they start out. */
+        bool physics = false;
+        glm::vec3 velocity = glm::vec3(0.0);
+        /** Whether (drawn) instances collide, and as what; see \c GObject::EnableCollision. Shapes follow \c mesh. */
+        bool collision = false;
+        uint32_t layer = ecs::LAYER_DEFAULT;
+        uint32_t mask = ecs::LAYER_ALL;
+        bool trigger = false;
+        /** Instances' mass for gravity (see \c GObject::EnableGravity); 0 leaves them out of it. */
+        double gravityMass = 0.0;
+
+        /** Obtains a \c create function for game objects of class \c T. */
+        template<typename T>
+        static std::function<GObject*(const Renderer&)> Of() {
+            return [](const Renderer& renderer) -> GObject* { return new T(renderer); };
+        }
+
+        /**
+         * Creates \c count instances, one per placement, and adds them to the engine and renderer.<br>
+         * Call on the simulation thread, outside the object update phase.
+         * @param handles : if given, receives the instances' handles in placement order
+         */
+        void Spawn(GEngine& engine, size_t count, const Placement* placements, GObjectHandle* handles = nullptr) const;
+        /** Creates one instance. */
+        GObjectHandle Spawn(GEngine& engine, const Placement& placement) const;
+    };
+}
+
+#endif //FP_KPREFAB_H
@@ -0,0 +1,166 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_KSCENE_H
+#define FP_KSCENE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <util/MappedFile.h>
+#include <util/SlotMap.h>
+
+namespace kVox {
+    class GEngine;
+    class GObject;
+    class Renderer;
+    typedef util::SlotHandle GObjectHandle;
+
+    /**
+     * On-disk layout of binary scenes (".kvsb"). Every table is a flat array of fixed-size little-endian
+     * records, placed by byte offset from the start of the file, so a mapped file can be used where it lies.
+     * Records refer to each other (and to names in the string table) by index / offset, never by pointer.
+     */
+    namespace SceneFormat {
+        static constexpr char MAGIC[4] = { 'K', 'V', 'S', 'C' };
+        static constexpr uint32_t VERSION = 1;
+        /** Marks an unset record index (no parent, no material, no target...). */
+        static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+        /** Which game object class an entity is created as. */
+        enum ObjectKind : uint8_t {
+            OBJECT = 0, PLAYER, ENEMY, GOAL, KIND_COUNT
+        };
+
+        enum EntityFlags : uint8_t {
+            ENTITY_PHYSICS = 1 << 0,    // the entity is moved by physics
+        };
+
+        enum CameraFlags : uint8_t {
+            CAMERA_ACTIVE = 1 << 0,         // the camera is the one rendered with at the start
+            CAMERA_CAN_LOOK = 1 << 1,       // mouse look is enabled
+            CAMERA_LOOK_AT_TARGET = 1 << 2, // the camera looks at its target (or the origin, if it has none)
+            CAMERA_TARGET_LOCAL = 1 << 3,   // track the target's local position rather than its render position
+        };
+
+        /** Where a table starts, and how many records it has. */
+        struct Section {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint32_t fileSize;
+            Section entities;
+            Section materials;
+            Section cameras;
+            /** NUL-terminated names, packed back to back; \c count is in bytes */
+            Section strings;
+        };
+
+        struct Material {
+            glm::vec3 ambient;
+            glm::vec3 diffuse;
+            glm::vec3 specular;
+            float shininess;
+        };
+
+        /** Entities are stored parents-first, so a parent always has a lower index than its children. */
+        struct Entity {
+            uint32_t name;          // string table offset
+            uint32_t parent;        // entity index, or NO_INDEX
+            uint32_t material;      // material index, or NO_INDEX for entities without a drawable
+            uint32_t shader;        // string table offset of the drawable's shader
+            uint8_t kind;           // ObjectKind
+            uint8_t primitive;      // PrimitiveType of the drawable
+            uint8_t flags;          // EntityFlags
+            uint8_t reserved;
+            glm::vec3 pos;
+            glm::vec3 rot;
+            glm::vec3 scale;
+        };
+
+        struct Camera {
+            uint32_t name;          // string table offset
+            uint32_t target;        // entity index to look at, or NO_INDEX for the origin
+            uint32_t orient;        // entity index to line up behind (locking the orientation), or NO_INDEX
+            uint8_t flags;          // CameraFlags
+            uint8_t reserved[3];
+            glm::vec3 pos;
+            float theta, phi;
+            float dist;
+        };
+
+        static_assert(sizeof(glm::vec3) == 12, "scene records assume tightly packed vectors");
+        static_assert(sizeof(Header) == 44 && sizeof(Material) == 40 && sizeof(Entity) == 56
+                      && sizeof(Camera) == 40, "scene record layout changed; bump VERSION");
+    }
+
+    /**
+     * A binary scene, mapped into memory and ready to be put into the engine.<br>
+     * <br>
+     * Loading maps the file and checks that its tables fit inside it, then points straight at them: no records
+     * are parsed or copied. Binary scenes are made from the text format by \c kScene::Compile (the
+     * \c fp_scenec tool wraps it), so content can change without rebuilding the game.
+     */
+    class kScene {
+    public:
+        /** Maps a binary scene. @return false if the file can't be mapped or isn't a valid scene */
+        bool Load(const std::string& path);
+
+        /**
+         * Creates the scene's game objects, drawables, and cameras, in file order (parents first).
+         * Call on the simulation thread, with the scene loaded.
+         * @return false if a name is already taken in the engine (objects created until then are kept)
+         */
+        bool Instantiate(GEngine& engine, Renderer& renderer) const;
+        /**
+         * Creates one entity's game object (and drawable), attached to \c parent if given.
+         * @return the object's handle, or a null handle if its name is already taken
+         */
+        GObjectHandle InstantiateEntity(uint32_t index, GEngine& engine, Renderer& renderer, GObject* parent) const;
+        /** Creates one camera; \c handles maps entity indices to objects, for its target and orientation. */
+        void InstantiateCamera(uint32_t index, Renderer& renderer, const std::vector<GObjectHandle>& handles) const;
+
+        uint32_t EntityCount() const { return header ? header->entities.count : 0; }
+        uint32_t MaterialCount() const { return header ? header->materials.count : 0; }
+        uint32_t CameraCount() const { return header ? header->cameras.count : 0; }
+        const SceneFormat::Entity& GetEntity(uint32_t i) const { return entities[i]; }
+        const SceneFormat::Material& GetMaterial(uint32_t i) const { return materials[i]; }
+        const SceneFormat::Camera& GetCamera(uint32_t i) const { return cameras[i]; }
+        /** Obtains a name from the string table. */
+        const char* GetString(uint32_t offset) const { return strings + offset; }
+
+        /**
+         * Converts a text scene into a binary one.<br>
+         * <br>
+         * Text scenes are line-based, with \c # starting a comment. Each line declares a material, an object,
+         * or a camera by name, followed by any of its properties (as \c key and value(s)):
+         * <pre>
+         * material hull   amb 0.1 0.1 0.1  diff 0.9 0.9 0.9  spec 1 1 1  shininess 0.4
+         * object torus    kind player  mesh torus  material hull  shader lighting  physics
+         * object cone     parent torus  mesh cone  material hull  pos 0 0 1  rot 1.5708 0 0  scale 1 1 1
+         * camera main     target torus  look  canlook  active  pos -1 0 0  theta 1.12  phi 0.02  dist 4
+         * camera front    target torus_cam  local  orient torus_cam  look  dist 0.001
+         * </pre>
+         * Names must be declared before they're referred to. Angles are in radians.
+         * @return whether the text parsed (errors are reported with their line) and the output was written
+         */
+        static bool Compile(const std::string& textPath, const std::string& binaryPath);
+
+    private:
+        util::MappedFile file;
+        // (pointers into the mapped file)
+        const SceneFormat::Header* header = nullptr;
+        const SceneFormat::Entity* entities = nullptr;
+        const SceneFormat::Material* materials = nullptr;
+        const SceneFormat::Camera* cameras = nullptr;
+        const char* strings = nullptr;
+    };
+}
+
+#endif //FP_KSCENE_H
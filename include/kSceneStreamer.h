@@ -0,0 +1,130 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_KSCENESTREAMER_H
+#define FP_KSCENESTREAMER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <kScene.h>
+
+namespace kVox {
+
+    /**
+     * Streams a binary scene into the engine a region at a time, so only what's near the player exists.<br>
+     * Cells are laid out in world coordinates, so they stay put when the engine rebases its origin; focus
+     * points are given in the engine's (current) coordinates.<br>
+     * <br>
+     * The world is cut into a grid of cubic cells, and each top-level object (with everything attached to it)
+     * belongs to the cell it sits in. Every \c Update, cells within \c loadRadius of a focus point (e.g. the
+     * player, the active camera) start loading: their objects are created, on the simulation thread, over as
+     * many updates as it takes to stay within \c spawnBudget per update, so a big cell never causes a hitch.
+     * Scene records are small and read straight from the mapped file as objects are created. Cells beyond
+     * \c unloadRadius are unloaded, their objects destroyed (drawables included); the gap between
+     * the two radii keeps cells on the border from flickering.<br>
+     * <br>
+     * Objects carry their position, rotation, and velocity across an unload, and objects that gameplay
+     * destroyed stay gone. Moving objects follow the cell they're in, and unload once they stray into one that
+     * isn't loaded. Player objects and camera targets are never streamed out.<br>
+     * <br>
+     * Everything happens on the simulation thread; call \c Update outside the object update phase (e.g. from a
+     * scheduled script).
+     */
+    class kSceneStreamer {
+    public:
+        /** Grid cell edge length, in world units. */
+        float cellSize = 1000.0f;
+        /** Cells closer than this to a focus point are loaded. */
+        float loadRadius = 2000.0f;
+        /** Cells further than this from every focus point are unloaded (keep it above \c loadRadius). */
+        float unloadRadius = 2600.0f;
+        /** Objects created per \c Update, at most. */
+        uint32_t spawnBudget = 32;
+        /** Called for every object the streamer creates, e.g. to start its scripts. */
+        std::function<void(GObject* go)> onSpawn;
+
+        kSceneStreamer() = default;
+        kSceneStreamer(const kSceneStreamer&) = delete;
+        kSceneStreamer& operator=(const kSceneStreamer&) = delete;
+
+        /** Maps the binary scene to stream from. */
+        bool Load(const std::string& path);
+        /**
+         * Sorts the scene into cells and creates what must always exist (player objects, camera targets, and
+         * the cameras themselves). Nothing else is created until \c Update.
+         */
+        bool Start(GEngine& engine, Renderer& renderer);
+        /** Adds a point cells are loaded around, asked for at every \c Update. */
+        void AddFocus(std::function<glm::dvec3()> focus);
+        /** Loads, unloads, and moves objects between cells around the current focus points. */
+        void Update(GEngine& engine, Renderer& renderer);
+
+        /** Obtains how many cells are fully loaded. */
+        size_t LoadedCellCount() const;
+        /** Obtains how many of the scene's objects currently exist in the engine. */
+        size_t ResidentCount() const { return resident; }
+        const kScene& GetScene() const { return scene; }
+
+    private:
+        enum CellState : uint8_t {
+            UNLOADED, LOADING, LOADED
+        };
+        struct Cell {
+            glm::ivec3 coord;
+            CellState state = UNLOADED;
+            /** top-level objects (entity indices) in the cell */
+            std::vector<uint32_t> roots;
+            /** how far \c LOADING has got through \c roots */
+            size_t cursor = 0;
+        };
+
+        /** What became of an entity. */
+        enum EntityStatus : uint8_t {
+            ABSENT, RESIDENT, PINNED, GONE
+        };
+        /** State carried by an unloaded top-level object, restored when it's created again. */
+        struct Saved {
+            glm::dvec3 pos;         // in world coordinates, so it survives origin rebases
+            glm::vec3 rot;
+            glm::vec3 vel;
+            bool valid = false;
+        };
+
+        /** Coordinate of the cell a world position is in, and the same packed into a map key. */
+        glm::ivec3 CoordOf(const glm::dvec3& pos) const;
+        uint64_t KeyOf(const glm::dvec3& pos) const;
+        Cell& CellAt(glm::ivec3 coord);
+        /** Distance from the closest focus point to the cell's bounds. */
+        double FocusDistance(const Cell& cell) const;
+
+        /** Creates a top-level object and everything attached to it. @return how many objects were created */
+        uint32_t SpawnTree(uint32_t root, GEngine& engine, Renderer& renderer, EntityStatus status);
+        /** Destroys a top-level object and everything attached to it, saving its state (or noting it's gone). */
+        void UnloadTree(uint32_t root, GEngine& engine);
+        /** Takes moving objects that have left the cell out of it, noting in \c moves where each one went. */
+        void Rehome(Cell& cell, GEngine& engine, std::vector<std::pair<uint32_t, glm::dvec3>>& moves);
+
+        kScene scene;
+        bool started = false;
+        std::vector<std::function<glm::dvec3()>> focuses;
+        /** focus points as of the current \c Update, in world coordinates */
+        std::vector<glm::dvec3> focusPoints;
+        /** cells by packed coordinate */
+        std::unordered_map<uint64_t, Cell> cells;
+
+        // per entity index
+        std::vector<GObjectHandle> handles;
+        std::vector<EntityStatus> status;
+        /** each top-level entity's tree: itself, then everything attached to it, parents first (empty otherwise) */
+        std::vector< std::vector<uint32_t> > trees;
+        std::vector<Saved> saved;
+        size_t resident = 0;
+    };
+}
+
+#endif //FP_KSCENESTREAMER_H
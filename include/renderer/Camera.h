@@ -6,8 +6,10 @@
 #define FP_CAMERA_H
 
 #include <GL/glew.h>
+#include <functional>
 #include <glm/glm.hpp>
 #include <util/convert.h>
+#include <util/BlockPool.h>
 
 namespace kVox {
 
@@ -18,10 +20,18 @@ namespace kVox {
      */
     class Camera {
     public:
-        /** camera position in cartesian coords */
-        glm::vec3 camPos;
+        virtual ~Camera() = default;
+
+        // cameras come out of a pool; deleting one recycles its block
+        static void* operator new(std::size_t size);
+        static void operator delete(void* ptr, std::size_t size);
+        /** Obtains the pool cameras are allocated from. */
+        static util::BlockPool& Pool();
+
+        /** camera position in cartesian coords (double precision, like object positions) */
+        glm::dvec3 camPos;
         /** camera look-at position in cartesian coords */
-        glm::vec3 camLookAt;
+        glm::dvec3 camLookAt;
         /** camera direction in spherical coords */
         GLdouble cameraTheta, cameraPhi;
         /** camera distance in cartesian coords */
@@ -30,28 +40,35 @@ namespace kVox {
         bool canLook = false;
         /** should camera's orientation be locked w.r.t. point? */
         bool orientLocked = false;
-        const glm::vec3* orientPos;
+        /** source of the direction the camera lines up behind, when orientation-locked */
+        std::function<glm::vec3()> orientPos;
 
         /** Recomputes the camera position given its look-at target and/or orientation. */
         virtual void RecomputeCamPos() {
             // make sure we are looking at our target
             if (lookingAtTgt)
-                camLookAt = (orientLocked) ? (*tgtLookAt + (*orientPos * glm::vec3(4.0))) : *tgtLookAt;
+                camLookAt = (orientLocked) ? (tgtLookAt() + (glm::dvec3(orientPos()) * 4.0)) : tgtLookAt();
             else {
-                camLookAt = camPos + util::SpherToCart(cameraTheta, cameraPhi);
+                camLookAt = camPos + glm::dvec3(util::SpherToCart(cameraTheta, cameraPhi));
             }
             // convert our theta and phi spherical angles to a cartesian vector, factoring in zoom,
             // and compute the camera's actual position
             if (!orientLocked)
-                camPos = (glm::vec3(camDist) * glm::vec3(glm::sin(cameraTheta) * glm::sin(cameraPhi),
-                                                     -glm::cos(cameraPhi),
-                                                     -glm::cos(cameraTheta) * glm::sin(cameraPhi))) + camLookAt;
+                camPos = (camDist * glm::dvec3(glm::sin(cameraTheta) * glm::sin(cameraPhi),
+                                               -glm::cos(cameraPhi),
+                                               -glm::cos(cameraTheta) * glm::sin(cameraPhi))) + camLookAt;
             else
-                camPos = *tgtLookAt - (*orientPos * glm::vec3(glm::sqrt(camDist)));
+                camPos = tgtLookAt() - (glm::dvec3(orientPos()) * glm::sqrt(camDist));
         }
 
         /** Set's the camera's look-at target to be the reference target position. */
-        void SetTargetLookAt(const glm::vec3* tgtPos) { tgtLookAt = tgtPos; }
+        void SetTargetLookAt(const glm::dvec3* tgtPos) { tgtLookAt = [tgtPos]() { return *tgtPos; }; }
+        void SetTargetLookAt(const glm::vec3* tgtPos) { tgtLookAt = [tgtPos]() { return glm::dvec3(*tgtPos); }; }
+        /**
+         * Set's the camera's look-at target to wherever \c tgt says, asked each time the camera is recomputed
+         * (e.g. a game object's render position, whose storage may move around).
+         */
+        void SetTargetLookAt(std::function<glm::dvec3()> tgt) { tgtLookAt = std::move(tgt); }
 
         /** Gets whether or not the camera is looking at a target. */
         bool GetLookingAtTgt() { return lookingAtTgt; }
@@ -60,8 +77,8 @@ namespace kVox {
 
     protected:
         bool lookingAtTgt = false;
-        /** reference to camera target's position */
-        const glm::vec3* tgtLookAt;
+        /** source of camera target's position */
+        std::function<glm::dvec3()> tgtLookAt;
     };
 }
 
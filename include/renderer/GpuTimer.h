@@ -0,0 +1,82 @@
+//
+// Created by snaki on 12/17/2020.
+//
+
+#ifndef FP_GPUTIMER_H
+#define FP_GPUTIMER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+
+namespace kVox {
+    namespace util { struct ProfileTrack; }
+
+    /**
+     * Measures how long each render pass takes on the GPU, without ever waiting on the GPU.<br>
+     * <br>
+     * Each pass is bracketed by a pair of \c GL_TIMESTAMP queries. Queries are kept in a ring several frames
+     * deep and only read back once the driver reports them available, so results lag a few frames behind.
+     * When \c KHR_debug is present, passes are also wrapped in debug groups so they show up by name in
+     * graphics debuggers. Resolved passes are reported to the frame profiler on a "GPU" track.
+     */
+    class GpuTimer {
+    public:
+        /** The renderer's GPU passes, in submission order. */
+        enum Pass {
+            SCENE,      // drawables into the post-processing framebuffer
+            SKYBOX,     // skybox into the same framebuffer
+            POST,       // post-processing quad to the backbuffer
+            PASS_COUNT
+        };
+
+        /** How many frames of queries are kept in flight before a slot is reused. */
+        static constexpr int FRAMES_IN_FLIGHT = 4;
+
+        /** Creates the queries. Needs a current GL context. */
+        void Init();
+        /** Deletes the queries. Needs a current GL context. */
+        void Shutdown();
+
+        /** Collects finished results from earlier frames and starts timing a new one. */
+        void BeginFrame();
+        /** Marks the start of a pass on the GPU timeline. */
+        void BeginPass(Pass pass);
+        /** Marks the end of a pass on the GPU timeline. */
+        void EndPass(Pass pass);
+        /** Finishes timing the current frame. */
+        void EndFrame();
+
+        /** Obtains the most recently resolved GPU time of a pass, in milliseconds. */
+        double GetPassTime(Pass pass) const;
+        /** Obtains the most recently resolved GPU time of a whole frame (first pass start to last pass end), in milliseconds. */
+        double GetFrameTime() const;
+
+        /** Obtains a human-readable pass name. */
+        static const char* PassName(Pass pass);
+
+    private:
+        /** Reads back a frame slot's queries if the GPU is done with them; returns whether it did. */
+        bool Resolve(int slot);
+
+        struct FrameQueries {
+            GLuint begin[PASS_COUNT];
+            GLuint end[PASS_COUNT];
+            bool used[PASS_COUNT];
+            bool pending = false;
+        };
+
+        bool ready = false;
+        bool hasDebugGroups = false;
+        FrameQueries frames[FRAMES_IN_FLIGHT] = {};
+        int current = 0;
+
+        double passTimes[PASS_COUNT] = {0.0};
+        double frameTime = 0.0;
+
+        /** GPU clock minus profiler clock, in nanoseconds, so GPU zones line up with CPU zones. */
+        int64_t clockOffset = 0;
+        util::ProfileTrack* track = nullptr;
+    };
+}
+
+#endif //FP_GPUTIMER_H
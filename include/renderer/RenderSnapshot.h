@@ -0,0 +1,123 @@
+//
+// Created by snaki on 12/15/2020.
+//
+
+#ifndef FP_RENDERSNAPSHOT_H
+#define FP_RENDERSNAPSHOT_H
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kVox {
+    class VAO;
+
+    /**
+     * Basic data structure for holding material ambient, diffuse, and specular properties.
+     */
+    struct VAOMatProps {
+        glm::vec3 materialDiffColor; // material diffuse color
+        glm::vec3 materialSpecColor; // material specular color
+        glm::vec3 materialAmbColor;  // material ambient color
+        double materialShininess; // material shininess factor
+    };
+
+    /** One drawable, frozen as of the frame it was captured in. */
+    struct RenderItem {
+        const VAO* vao;          // only used for its GL handles and draw call
+        glm::mat4 modelMtx;      // already interpolated between simulation ticks
+        VAOMatProps material;
+    };
+
+    /** All drawables that share a shader, so they can be drawn without switching programs. */
+    struct RenderBatch {
+        std::string shader;
+        std::vector<RenderItem> items;
+    };
+
+    /** Light types understood by the lighting shader. */
+    enum LightType {
+        POINT_LIGHT = 0, DIRECTIONAL_LIGHT = 1, SPOT_LIGHT = 2
+    };
+
+    /** One light in the scene, as handed to the lighting shader. */
+    struct LightDesc {
+        LightType type = POINT_LIGHT;
+        glm::dvec3 pos = glm::dvec3(0.0);   // world-space position (point/spot lights)
+        glm::vec3 dir = glm::vec3(0.0);     // world-space direction (directional/spot lights)
+        float cutoff = 0.0f;                // spotlight angle
+        glm::vec3 color = glm::vec3(1.0);
+    };
+
+    /** A float uniform write requested by the simulation, applied by whoever owns the GL context. */
+    struct ShaderFloatWrite {
+        std::string shader;
+        std::string attr;
+        float val;
+    };
+
+    /**
+     * Everything the renderer needs to draw one frame, captured by the simulation side.<br>
+     * <br>
+     * Once published, a snapshot is never modified, so the render thread can draw from it while the
+     * simulation works on the next frame.
+     */
+    struct RenderSnapshot {
+        /** increases by one for every snapshot built */
+        uint64_t serial = 0;
+        std::vector<RenderBatch> batches;
+        /** the eye everything in \c batches was made relative to, in world space */
+        glm::dvec3 camPos = glm::dvec3(0.0);
+        glm::dvec3 camLookAt = glm::dvec3(0.0, 0.0, -1.0);
+        /** time passed since the last frame, in seconds */
+        double deltaTime = 0.0;
+        std::vector<ShaderFloatWrite> floatWrites;
+        /** the scene's lights, and a counter that changes whenever they do */
+        std::vector<LightDesc> lights;
+        uint64_t lightsVersion = 0;
+        // post-processing state
+        bool confuse = false, chaos = false, shake = false;
+    };
+
+    /**
+     * Double buffer of \c RenderSnapshot objects handed from the simulation thread to the render thread.<br>
+     * <br>
+     * The simulation may be at most one frame ahead: it blocks in \c BeginWrite only when the render thread is
+     * still drawing the older snapshot and the newer one hasn't been picked up yet.
+     */
+    class RenderSnapshotBuffer {
+    public:
+        /** [simulation] Obtains a snapshot slot that nobody is reading, waiting for one if needed. */
+        RenderSnapshot& BeginWrite();
+        /** [simulation] Hands the slot from \c BeginWrite over to the render thread. */
+        void Publish();
+
+        /**
+         * [render] Waits for the next published snapshot.
+         * @return the snapshot to draw, or \c nullptr once the buffer has been closed
+         */
+        const RenderSnapshot* Acquire();
+        /** [render] Marks the snapshot from \c Acquire as drawn, freeing its slot. */
+        void Release();
+
+        /** Wakes up both sides and makes \c Acquire return \c nullptr from now on. */
+        void Close();
+        /** Re-opens a closed buffer and forgets any snapshot in flight. */
+        void Reset();
+
+    private:
+        static constexpr int NONE = -1;
+
+        RenderSnapshot slots[2];
+        int writing = NONE, pending = NONE, reading = NONE;
+        bool closed = false;
+        std::mutex lock;
+        std::condition_variable changed;
+    };
+}
+
+#endif //FP_RENDERSNAPSHOT_H
@@ -17,13 +17,18 @@
 #include <CSCI441/objects.hpp>  // for our 3D objects
 #include <CSCI441/TextureUtils.hpp>
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <string>
 
 #include <renderer/Shader.h>
 #include <renderer/Camera.h>
+#include <renderer/RenderSnapshot.h>
+#include <renderer/GpuTimer.h>
+#include <util/BlockPool.h>
 
 namespace kVox {
     class VAO;
@@ -33,6 +38,14 @@ namespace kVox {
         /** Initializes the renderer. To be called only once on engine load. */
         bool Init();
 
+        /**
+         * Initializes the renderer without a window or GL context, for headless runs. Drawables and cameras can
+         * still be added and updated; nothing is ever drawn.
+         */
+        void InitHeadless();
+        /** Obtains whether the renderer was initialized headless. */
+        bool IsHeadless() const;
+
         /** Shuts down the renderer. To be called only once on engine shutdown. */
         void Shutdown();
 
@@ -42,17 +55,44 @@ namespace kVox {
         /**
          * The core OpenGL rendering loop.
          * @param deltaTime : the amount of time passed since the last frame
+         * @param interp : how far between the previous and current simulation tick to draw, in [0.0,1.0]
          * @param mRunning : whether the game engine is still running (for double-checking)
          */
-        void Render(double deltaTime, bool mRunning);
+        void Render(double deltaTime, double interp, bool mRunning);
+
+        /**
+         * Captures everything needed to draw the current frame. Touches no GL state, so it is safe to call
+         * from the simulation thread while another thread owns the context.
+         * @param snapshot : the snapshot to fill; its previous contents are replaced
+         * @param deltaTime : the amount of time passed since the last frame
+         * @param interp : how far between the previous and current simulation tick to draw, in [0.0,1.0]
+         */
+        void BuildSnapshot(RenderSnapshot& snapshot, double deltaTime, double interp);
+
+        /**
+         * Draws a frame from a previously-built snapshot. Must be called from the thread owning the GL context.
+         */
+        void Render(const RenderSnapshot& snapshot);
+
+        /** Makes the renderer's GL context current on the calling thread. */
+        bool AcquireContext();
+        /** Detaches the renderer's GL context from the calling thread, so another thread can acquire it. */
+        void ReleaseContext();
 
         /** Swaps the graphics engine's draw buffers, if double-buffering is supported/enabled. */
         void Swap();
 
         /** Adds a drawable object to the render queue. */
         void AddDrawable(VAO* obj);
+        /** Adds many drawables to the render queue at once. */
+        void AddDrawables(VAO* const* objs, size_t count);
         void RemoveDrawable(VAO* obj);
-        /** Adds a shader object to the shader map. */
+        /**
+         * Removes a drawable from the render queue and deletes it once no snapshot in flight can still draw it.
+         * The renderer takes ownership of \c obj.
+         */
+        void ReleaseDrawable(VAO* obj);
+        /** Adds a shader object to the shader map, setting the uniforms that never change. Needs the GL context. */
         void AddShader(const std::string& name, Shader* shader);
         void RemoveShader(const std::string& name);
 
@@ -76,14 +116,40 @@ namespace kVox {
         /** Obtains the camera with the given name, or \c nullptr if it doesn't exist. */
         Camera* GetCameraWithName(const std::string& name);
 
+        /** Obtains the per-pass GPU timings (a few frames behind). */
+        const GpuTimer& GetGpuTimer() const;
+        /** Obtains how many draw calls the last rendered frame issued. */
+        uint32_t GetLastDrawCalls() const;
+        /** Obtains how many triangles the last rendered frame submitted. */
+        uint64_t GetLastTriangles() const;
+        /** Obtains the GPU time of the most recently resolved frame, in milliseconds. Safe from any thread. */
+        double GetLastGpuTime() const;
+
         /** Obtains the current window width. */
         int GetWindowWidth() const;
         /** Obtains the current window height. */
         int GetWindowHeight() const;
 
-        /** Updates a shader's float attribute with the specified name to the supplied value. */
+        /**
+         * Updates a shader's float attribute with the specified name to the supplied value.<br>
+         * The write is queued and applied at the start of the next rendered frame.
+         */
         void UpdateShaderFloat(const std::string& shader, const std::string& attr, double val);
 
+        /** Most lights the lighting shader handles at once; keep in sync with \c MAX_LIGHTS in blinn.f.glsl. */
+        static constexpr int MAX_LIGHTS = ShaderUniforms::MAX_LIGHTS;
+        /**
+         * Adds a light to the scene. The scene starts with a single directional light.
+         * @return the light's index, or -1 if \c MAX_LIGHTS are already in use
+         */
+        int AddLight(const LightDesc& light);
+        /** Replaces the light at the given index. */
+        void SetLight(int index, const LightDesc& light);
+        /** Removes every light from the scene. */
+        void ClearLights();
+        /** Obtains the number of lights in the scene. */
+        int GetLightCount() const;
+
         /** Toggles the 'shake' post-processing effect. */
         void SetShake(bool set);
         /** Toggles the 'chaos' post-processing effect. */
@@ -92,7 +158,16 @@ namespace kVox {
         void SetConfuse(bool set);
 
         /** Retrieves the origin of the render world space. */
-        const glm::vec3* GetOrigin();
+        const glm::dvec3* GetOrigin();
+        /**
+         * Moves everything the renderer places itself (drawables, lights, free cameras, the origin) by
+         * \c offset. Used by the engine when it rebases the world origin; call on the simulation thread.
+         */
+        void ShiftOrigin(const glm::dvec3& offset);
+
+        /** Near and far clip distances. Depth is logarithmic, so one pass covers the whole range. */
+        static constexpr float NEAR_PLANE = 0.001f;
+        static constexpr float FAR_PLANE = 1.0e7f;
 
     private:
 
@@ -113,6 +188,9 @@ namespace kVox {
          */
         bool InitLightingShader();
 
+        /** Set when running without a window or GL context. */
+        bool headless = false;
+
         /**
          * Handle for the window.
          */
@@ -132,8 +210,46 @@ namespace kVox {
 
         std::map<std::string, Camera*> cameras;
         Camera* activeCamera;
+        /** GPU timestamp queries around each render pass */
+        GpuTimer gpuTimer;
+        /** counters of the last rendered frame (written by the render thread, read by the simulation) */
+        std::atomic<uint32_t> lastDrawCalls {0};
+        std::atomic<uint64_t> lastTriangles {0};
+        std::atomic<double> lastGpuTime {0.0};
+
+        /** eye position of the frame being drawn, as handed to shaders (always zero: the scene is drawn eye-relative) */
+        glm::vec3 eyePos = glm::vec3(0.0);
+
+        /** snapshot reused by the single-threaded \c Render path */
+        RenderSnapshot frameSnapshot;
+        /** serial number of the last snapshot built */
+        uint64_t lastSnapshotSerial = 0;
+        /** uniform writes queued since the last snapshot was built */
+        std::vector<ShaderFloatWrite> pendingFloatWrites;
+
+        /** the scene's lights; \c lightsVersion changes with every edit */
+        std::vector<LightDesc> lights;
+        uint64_t lightsVersion = 1;
+        /** the light version last uploaded to the lighting shader, and the eye they were made relative to */
+        uint64_t appliedLightsVersion = 0;
+        glm::dvec3 appliedLightsEye = glm::dvec3(0.0);
+        /**
+         * Uploads the snapshot's lights to the lighting shader, relative to its eye; if only the eye moved since
+         * the last upload, just their positions. Needs the GL context.
+         */
+        void ApplyLights(const RenderSnapshot& snapshot);
+
+        /** A released drawable, and the newest snapshot that could still reference it. */
+        struct RetiredDrawable {
+            VAO* vao;
+            uint64_t lastSerial;
+        };
+        std::vector<RetiredDrawable> retiredDrawables;
+        std::mutex retiredLock;
+        /** Deletes retired drawables no longer referenced by any snapshot up to and including \c serial. */
+        void DeleteRetiredDrawables(uint64_t serial);
 
-        glm::vec3* origin;
+        glm::dvec3* origin;
 
         // post-processing details
         GLuint texture;
@@ -148,16 +264,6 @@ namespace kVox {
         void SetupSkybox();
     };
 
-    /**
-     * Basic data structure for holding material ambient, diffuse, and specular properties.
-     */
-    struct VAOMatProps {
-        glm::vec3 materialDiffColor; // material diffuse color
-        glm::vec3 materialSpecColor; // material specular color
-        glm::vec3 materialAmbColor;  // material ambient color
-        double materialShininess; // material shininess factor
-    };
-
     /**
      * The basic drawable. Stores values pertinent to the renderer's OpenGL pipeline, as well as
      * which shader to render with, which model matrix to render (typically set by a game object),
@@ -167,14 +273,38 @@ namespace kVox {
     public:
         VAO() = delete;
         VAO(const float *vertPos, int vertPosCount, const std::string &shaderToUse, Renderer &renderer);
-        ~VAO();
+        virtual ~VAO();
+
+        // drawables (subclasses included) come out of a shared pool; deleting one recycles its block
+        static void* operator new(std::size_t size);
+        static void operator delete(void* ptr, std::size_t size);
+        /** Obtains the pool drawables are allocated from. */
+        static util::BlockPool& Pool();
 
         virtual void Draw() const;
+        /** Obtains how many triangles one \c Draw submits. */
+        virtual uint64_t TriangleCount() const;
+        /** Obtains how many GL draw calls one \c Draw issues. */
+        virtual uint32_t DrawCallCount() const;
         void SetShader(const std::string& shaderName);
         std::string GetShader();
 
+        /** Obtains the model matrix's rotation and scale (the translation is held apart, see \c GetOrigin). */
         glm::mat4 GetModelMtx();
-        void SetModelMtx(glm::mat4 modelMtx);
+        /** Obtains the drawable's world position. */
+        glm::dvec3 GetOrigin() const;
+        /** Places the drawable: \c modelMtx holds rotation and scale, \c origin the world position. */
+        void SetModelMtx(glm::mat4 modelMtx, const glm::dvec3& origin = glm::dvec3(0.0));
+        /** Moves the drawable (and its history) by \c offset, e.g. when the world origin is rebased. */
+        void ShiftOrigin(const glm::dvec3& offset);
+        /** Keeps the current model matrix as the previous simulation tick's, for interpolation. */
+        void StorePrevModelMtx();
+        /**
+         * Obtains the model matrix blended between the previous and current tick by \c alpha, translated
+         * relative to \c eye. The offset from the eye is taken in double precision before it's narrowed, so
+         * drawables near the camera stay steady however far they are from the world origin.
+         */
+        glm::mat4 GetInterpModelMtx(double alpha, const glm::dvec3& eye) const;
 
         inline bool operator==(VAO&a) {
             return (this->mVAO == a.mVAO && this->mVBO == a.mVAO && this->mVertCount == a.mVertCount);
@@ -183,12 +313,25 @@ namespace kVox {
         VAOMatProps material;
 
     protected:
-        /** vertex array object handle */
-        GLuint mVAO = GL_NONE;
-        /** vertex buffer object handle */
-        GLuint mVBO = GL_NONE;
-        /** model matrix, if model has one */
+        /** Blends rotation and scale between the previous and current tick (no translation). */
+        glm::mat4 GetInterpRotScale(double alpha) const;
+        /** Creates the GL buffers from \c mVertData, if not done yet. Only safe on the thread owning the context. */
+        void Upload() const;
+
+        /** vertex array object handle (created lazily on first draw) */
+        mutable GLuint mVAO = GL_NONE;
+        /** vertex buffer object handle (created lazily on first draw) */
+        mutable GLuint mVBO = GL_NONE;
+        /** vertex positions waiting to be uploaded */
+        std::vector<float> mVertData;
+        /** model matrix (rotation and scale only), if model has one */
         glm::mat4 modelMtx = glm::mat4(1.0);
+        /** model matrix as of the previous simulation tick */
+        glm::mat4 prevModelMtx = glm::mat4(1.0);
+        /** world position, and as of the previous simulation tick */
+        glm::dvec3 origin = glm::dvec3(0.0);
+        glm::dvec3 prevOrigin = glm::dvec3(0.0);
+        bool hasPrevModelMtx = false;
 
         /** renderer handle */
         Renderer& renderer;
@@ -215,6 +358,12 @@ namespace kVox {
             : VAO(vertPos, vertPosCount, shaderToUse, renderer), primitive(type) { primitive = type; }
 
         void Draw() const override;
+        uint64_t TriangleCount() const override;
+        uint32_t DrawCallCount() const override;
+        PrimitiveType GetPrimitive() const { return primitive; }
+
+        /** Obtains the box a primitive is drawn in (before the model matrix), as its center and half extents. */
+        static void GetLocalBounds(PrimitiveType type, glm::vec3& center, glm::vec3& halfExtents);
     private:
         PrimitiveType primitive;
     };
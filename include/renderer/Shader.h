@@ -10,6 +10,8 @@
 namespace kVox {
 
     struct ShaderUniforms {         // stores the locations of all of our shader uniforms
+        static constexpr int MAX_LIGHTS = 16;   // keep in sync with MAX_LIGHTS in blinn.f.glsl
+
         GLint mvpMatrix;                    // the MVP Matrix to apply
         GLint mvMatrix;
         GLint projMtx;
@@ -21,6 +23,11 @@ namespace kVox {
         GLint materialSpecColor;            // material specular color
         GLint materialShininess;            // material shininess factor
         GLint materialAmbColor;             // material ambient color
+        GLint logDepthCoef;                 // 2 / log2(far + 1), for logarithmic depth
+        GLint numLights;                    // how many entries of lights[] are in use
+        struct Light {                      // one entry of lights[]
+            GLint lightType, lightPos, lightDir, lightCutoff, lightColor;
+        } lights[MAX_LIGHTS];
     };
 
     struct ShaderAttributes {
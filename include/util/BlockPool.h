@@ -0,0 +1,81 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_BLOCKPOOL_H
+#define FP_BLOCKPOOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace kVox::util {
+
+    /**
+     * A pool of fixed-size blocks, for classes that are created and destroyed a lot (hooked up through
+     * class-level \c operator new / \c operator delete).<br>
+     * <br>
+     * Requests are rounded up to a whole number of cache lines and served from per-size free lists, so
+     * recycling a block is O(1) and subclasses of different sizes can share one pool. Blocks are carved out of
+     * large cache-line-aligned chunks that never move, so addresses are stable for an object's whole life.
+     * Requests bigger than \c maxPooledSize go straight to the heap (still cache-line aligned).<br>
+     * <br>
+     * Thread-safe. Chunks are only handed back to the heap all at once, by \c Release, once every block is free.
+     */
+    class BlockPool {
+    public:
+        static constexpr size_t ALIGNMENT = 64;
+
+        explicit BlockPool(size_t maxPooledSize = 1024, size_t chunkSize = 64 * 1024);
+        /** Frees every chunk, whether or not blocks are still out. */
+        ~BlockPool();
+
+        void* Allocate(size_t size);
+        /** Returns a block; \c size must be what it was allocated with. */
+        void Free(void* ptr, size_t size);
+
+        /**
+         * Hands all chunks back to the heap at once, if no block is in use.
+         * @return whether the pool was empty (and is now released)
+         */
+        bool Release();
+
+        /** Number of blocks currently handed out (pooled or not). */
+        size_t LiveCount() const;
+        /** Bytes of chunk memory the pool holds. */
+        size_t ReservedBytes() const;
+
+        BlockPool(BlockPool const&)         = delete;
+        void operator=(BlockPool const&)    = delete;
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        /** Splits a fresh chunk into blocks of one size class. Called with the lock held. */
+        void Refill(size_t sizeClass);
+
+        const size_t maxPooledSize;
+        const size_t chunkSize;
+        mutable std::mutex lock;
+        /** free list per size class (in cache lines) */
+        std::vector<FreeBlock*> freeLists;
+        std::vector<void*> chunks;
+        size_t live = 0;
+    };
+
+    /**
+     * Obtains the pool for everything allocated under \c Tag (usually the class itself), created on first use.<br>
+     * <br>
+     * Never destroyed: objects from it may still be deleted during static destruction, after a static pool
+     * would be gone. Its memory can go back to the heap earlier through \c Release.
+     */
+    template<typename Tag, size_t MaxPooledSize = 1024>
+    BlockPool& ImmortalPool() {
+        static auto* pool = new BlockPool(MaxPooledSize);
+        return *pool;
+    }
+}
+
+#endif //FP_BLOCKPOOL_H
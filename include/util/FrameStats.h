@@ -0,0 +1,98 @@
+//
+// Created by snaki on 12/18/2020.
+//
+
+#ifndef FP_FRAMESTATS_H
+#define FP_FRAMESTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kVox::util {
+
+    /**
+     * Rolling per-frame statistics for the engine.<br>
+     * <br>
+     * Keeps the last \c WINDOW frames both as raw samples (for CSV dumps) and as log-scaled histograms, so
+     * percentiles can be queried at any time without sorting. Recording a frame is a handful of array writes;
+     * nothing is written to disk or console until one of the dump functions is called.
+     */
+    class FrameStats {
+    public:
+        enum Metric {
+            FRAME_TIME,     // wall time between frames, ms
+            SIM_TIME,       // time spent running simulation ticks, ms
+            RENDER_TIME,    // CPU time spent building and submitting the frame, ms
+            GPU_TIME,       // GPU time of the frame's render passes, ms (lags a few frames behind)
+            DRAW_CALLS,     // draw calls issued
+            TRIANGLES,      // triangles submitted (approximate for primitives)
+            METRIC_COUNT
+        };
+
+        struct FrameSample {
+            double values[METRIC_COUNT] = {0.0};
+        };
+
+        /** How many of the most recent frames the statistics cover. */
+        static constexpr size_t WINDOW = 4096;
+
+        FrameStats();
+
+        /** Adds a frame's measurements, dropping the oldest frame once the window is full. */
+        void Record(const FrameSample& sample);
+        /** Forgets every recorded frame. */
+        void Clear();
+
+        /**
+         * Obtains a percentile of a metric over the window, accurate to within about 3%.
+         * @param percentile : in [0,100], e.g. 99 for p99
+         */
+        double Percentile(Metric metric, double percentile) const;
+        /** Obtains the largest value of a metric over the window. */
+        double Max(Metric metric) const;
+        /** Obtains the mean of a metric over the window. */
+        double Mean(Metric metric) const;
+
+        /**
+         * Obtains the number of hitches since the last \c Clear: frames that took more than
+         * \c hitchFactor times the typical (median) frame time.
+         */
+        uint64_t HitchCount() const;
+        /** Obtains the number of frames recorded since the last \c Clear. */
+        uint64_t FrameCount() const;
+        /** Sets how many times slower than the median a frame has to be to count as a hitch. */
+        void SetHitchFactor(double factor);
+
+        /** Writes every frame in the window to a CSV file, one row per frame. */
+        bool DumpCSV(const std::string& path) const;
+        /** Writes a JSON summary (p50/p95/p99/max/mean per metric, hitches) of the window. */
+        bool DumpJSON(const std::string& path) const;
+
+        /** Obtains a metric's name, as used in dumps. */
+        static const char* MetricName(Metric metric);
+
+    private:
+        // log-scaled buckets: BUCKETS_PER_OCTAVE per power of two, starting at MIN_VALUE
+        static constexpr int BUCKETS_PER_OCTAVE = 16;
+        static constexpr int OCTAVES = 48;
+        static constexpr int BUCKET_COUNT = BUCKETS_PER_OCTAVE * OCTAVES + 1;
+        static constexpr double MIN_VALUE = 1.0 / 1024.0;
+
+        static int BucketOf(double value);
+        static double BucketValue(int bucket);
+
+        FrameSample samples[WINDOW];
+        uint32_t histograms[METRIC_COUNT][BUCKET_COUNT];
+        double sums[METRIC_COUNT];
+        /** frames recorded since the last clear; the next sample goes into samples[frames % WINDOW] */
+        uint64_t frames = 0;
+
+        uint64_t hitches = 0;
+        double hitchFactor = 2.0;
+        /** median frame time, refreshed every so often rather than every frame */
+        double typicalFrameTime = 0.0;
+    };
+}
+
+#endif //FP_FRAMESTATS_H
@@ -0,0 +1,46 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_MAPPEDFILE_H
+#define FP_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kVox::util {
+
+    /**
+     * A read-only view of a whole file, mapped straight into memory.<br>
+     * <br>
+     * Nothing is read up front: the OS pages the file in as it's touched (and shares the pages with its file
+     * cache), so "loading" a large file costs about as much as opening it.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /** Maps a file, unmapping whatever was mapped before. @return whether the file could be mapped */
+        bool Open(const std::string& path);
+        /** Unmaps the file. Safe to call more than once. */
+        void Close();
+
+        bool IsOpen() const { return data != nullptr; }
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#endif
+    };
+}
+
+#endif //FP_MAPPEDFILE_H
@@ -0,0 +1,23 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#ifndef FP_MATRIXBATCH_H
+#define FP_MATRIXBATCH_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+namespace kVox::util {
+
+    /**
+     * Multiplies \c count pairs of 4x4 matrices: \c out[i] = \c lhs[i] * \c rhs[i].<br>
+     * <br>
+     * Uses AVX (two products per pass) or SSE when the build targets them (AVX with \c FP_AVX, SSE always
+     * on x86), plain GLM otherwise. The arrays
+     * needn't be aligned, but \c out mustn't overlap \c lhs or \c rhs.
+     */
+    void MultiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count);
+}
+
+#endif //FP_MATRIXBATCH_H
@@ -0,0 +1,121 @@
+//
+// Created by snaki on 12/16/2020.
+//
+
+#ifndef FP_PROFILER_H
+#define FP_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Scoped CPU zones. Build with FP_PROFILE defined (CMake option FP_PROFILE) to record them; otherwise the
+ * macros compile to nothing and zones cost nothing at all.
+ *
+ *     void Foo() {
+ *         FP_PROFILE_FUNCTION();
+ *         ...
+ *         { FP_PROFILE_ZONE("Foo::inner"); ... }
+ *     }
+ *
+ * Zone names must outlive the program (string literals, __func__).
+ */
+#ifdef FP_PROFILE
+#define FP_PROFILE_CONCAT_(a, b) a##b
+#define FP_PROFILE_CONCAT(a, b) FP_PROFILE_CONCAT_(a, b)
+#define FP_PROFILE_ZONE(name) ::kVox::util::ProfileZone FP_PROFILE_CONCAT(_fpProfileZone, __LINE__)(name)
+#define FP_PROFILE_FUNCTION() FP_PROFILE_ZONE(__func__)
+#define FP_PROFILE_THREAD(name) ::kVox::util::Profiler::Instance().SetThreadName(name)
+#else
+#define FP_PROFILE_ZONE(name) ((void)0)
+#define FP_PROFILE_FUNCTION() ((void)0)
+#define FP_PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace kVox::util {
+
+    /** One closed zone: what ran, and when (nanoseconds since the profiler started). */
+    struct ProfileEvent {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    /**
+     * A ring of recorded zones, shown as one row in the trace. Every thread gets one automatically; extra tracks
+     * (e.g. GPU timings) can be created with \c Profiler::CreateTrack.
+     */
+    struct ProfileTrack {
+        uint32_t tid = 0;
+        std::string name;
+        /** total zones ever written; the slot for the next one is head % RING_CAPACITY */
+        std::atomic<uint64_t> head {0};
+        ProfileEvent events[1u << 16];
+    };
+
+    /**
+     * Collects zones from every thread and writes them out as a Chrome trace (chrome://tracing, Perfetto).<br>
+     * <br>
+     * Each thread records into its own fixed-size ring buffer with no locks or allocations; once a ring is
+     * full the oldest zones are overwritten. Dumping reads the rings while threads keep recording.
+     */
+    class Profiler {
+    public:
+        /** Zones kept per thread before the oldest are overwritten. Must be a power of two. */
+        static constexpr uint32_t RING_CAPACITY = sizeof(ProfileTrack::events) / sizeof(ProfileEvent);
+
+        static Profiler& Instance();
+
+        /** Obtains the current time on the profiler's clock, in nanoseconds. */
+        uint64_t Now() const;
+
+        /** Records a closed zone for the calling thread. */
+        void Record(const char* name, uint64_t start, uint64_t end);
+
+        /** Creates an extra named track that isn't tied to a thread. It lives as long as the profiler. */
+        ProfileTrack* CreateTrack(const std::string& name);
+        /** Records a closed zone on a track from \c CreateTrack. Only one thread may record to a given track. */
+        void Record(ProfileTrack& track, const char* name, uint64_t start, uint64_t end);
+
+        /** Labels the calling thread in dumped traces. */
+        void SetThreadName(const std::string& name);
+
+        /**
+         * Writes every zone still held in the ring buffers to a Chrome trace-event JSON file.
+         * @return whether the file could be written
+         */
+        bool DumpChromeTrace(const std::string& path);
+
+        Profiler(Profiler const&)       = delete;
+        void operator=(Profiler const&) = delete;
+
+    private:
+        Profiler();
+
+        /** Obtains (registering on first use) the calling thread's track. */
+        ProfileTrack& LocalTrack();
+
+        uint64_t epoch;
+        std::mutex registryLock;
+        std::vector< std::unique_ptr<ProfileTrack> > tracks;
+    };
+
+    /** RAII zone: records its own lifetime under \c name. Use through \c FP_PROFILE_ZONE. */
+    class ProfileZone {
+    public:
+        explicit ProfileZone(const char* name) : name(name), start(Profiler::Instance().Now()) {}
+        ~ProfileZone() { Profiler::Instance().Record(name, start, Profiler::Instance().Now()); }
+
+        ProfileZone(ProfileZone const&)     = delete;
+        void operator=(ProfileZone const&)  = delete;
+    private:
+        const char* name;
+        uint64_t start;
+    };
+}
+
+#endif //FP_PROFILER_H
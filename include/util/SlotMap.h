@@ -0,0 +1,114 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#ifndef FP_SLOTMAP_H
+#define FP_SLOTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace kVox::util {
+
+    /**
+     * A reference to a value in a \c SlotMap: a slot index plus the generation the slot was on when the value
+     * went in. Once the value is removed the slot's generation moves on, so old handles stop resolving instead
+     * of pointing at whatever reuses the slot. Default-constructed handles are null and never resolve.
+     */
+    struct SlotHandle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool IsNull() const { return generation == 0; }
+        explicit operator bool() const { return !IsNull(); }
+        bool operator==(const SlotHandle& other) const = default;
+    };
+
+    /**
+     * Stores values behind generational handles, with O(1) insert, remove, and validated lookup.<br>
+     * <br>
+     * Values are kept packed in insertion order (removal moves the last value into the hole), so iterating
+     * over \c begin() / \c end() is a walk over a plain array. Handles stay valid across other insertions and
+     * removals; pointers into the map don't.
+     */
+    template<typename T>
+    class SlotMap {
+    public:
+        SlotHandle Insert(T value) {
+            uint32_t index;
+            if (freeHead != NONE) {
+                index = freeHead;
+                freeHead = slots[index].dense;
+            } else {
+                index = static_cast<uint32_t>(slots.size());
+                slots.push_back(Slot{ 1, NONE });
+            }
+            slots[index].dense = static_cast<uint32_t>(values.size());
+            values.push_back(std::move(value));
+            owners.push_back(index);
+            return SlotHandle{ index, slots[index].generation };
+        }
+
+        /** Removes the value a handle refers to. @return false if the handle was already stale */
+        bool Remove(SlotHandle handle) {
+            if (!Contains(handle)) return false;
+            Slot& slot = slots[handle.index];
+            uint32_t last = static_cast<uint32_t>(values.size() - 1);
+            if (slot.dense != last) {
+                values[slot.dense] = std::move(values[last]);
+                owners[slot.dense] = owners[last];
+                slots[owners[slot.dense]].dense = slot.dense;
+            }
+            values.pop_back();
+            owners.pop_back();
+            // retire the generation (skipping 0, which marks null handles) and put the slot on the free list
+            if (++slot.generation == 0) slot.generation = 1;
+            slot.dense = freeHead;
+            freeHead = handle.index;
+            return true;
+        }
+
+        bool Contains(SlotHandle handle) const {
+            return handle.index < slots.size() && slots[handle.index].generation == handle.generation
+                   && !handle.IsNull();
+        }
+
+        /** Obtains the value a handle refers to, or \c nullptr if the handle is stale. */
+        T* Get(SlotHandle handle) {
+            return Contains(handle) ? &values[slots[handle.index].dense] : nullptr;
+        }
+
+        size_t Size() const { return values.size(); }
+        /** Makes room for \c count more values, ahead of inserting them in bulk. */
+        void Reserve(size_t count) {
+            slots.reserve(slots.size() + count);
+            values.reserve(values.size() + count);
+            owners.reserve(owners.size() + count);
+        }
+        bool Empty() const { return values.empty(); }
+
+        T* begin() { return values.data(); }
+        T* end() { return values.data() + values.size(); }
+        const T* begin() const { return values.data(); }
+        const T* end() const { return values.data() + values.size(); }
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Slot {
+            uint32_t generation;
+            /** where the value sits in \c values while occupied; the next free slot while free */
+            uint32_t dense;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<T> values;
+        /** packed index -> slot index, to patch up a slot when its value gets moved */
+        std::vector<uint32_t> owners;
+        uint32_t freeHead = NONE;
+    };
+}
+
+#endif //FP_SLOTMAP_H
@@ -3,21 +3,49 @@
 //
 
 #include <GEngine.h>
+#include <util/Profiler.h>
+#include <ecs/Systems.h>
 #include <iostream>
 #include <glm/gtx/string_cast.hpp>
 #include <stdio.h>
 
 namespace kVox {
     ENGINE_PTR GEngine::engine = nullptr;
+    /** How many game objects a worker takes per job in the parallel update phases. */
+    static constexpr size_t OBJECTS_PER_JOB = 64;
 
-    bool GEngine::Init() {
-        // initialize the renderer
-        mRenderer = Renderer();
-        return mRenderer.Init();
+    /** Milliseconds elapsed since a performance counter reading. */
+    static double MillisecondsSince(uint64_t counter) {
+        return (SDL_GetPerformanceCounter() - counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    }
+
+    bool GEngine::Init(const EngineConfig& config) {
+        mConfig = config;
+        if (mConfig.headless) {
+            // no window: only events (for quit signals) and timers are needed
+            if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0) { return false; }
+            mRenderer.InitHeadless();
+        } else {
+            // initialize the renderer
+            if (!mRenderer.Init()) { return false; }
+        }
+        // spin up the worker pool
+        mJobs.Init();
+        return true;
     }
 
     void GEngine::Shutdown() {
         mRunning = false;
+        // the render thread must be done with the scene before it's torn down
+        StopRenderThread();
+
+        if (!mConfig.statsPath.empty())
+            DumpFrameStats(mConfig.statsPath);
+        // close out any input recording at the tick we stopped on
+        mInputRecorder.Stop(mTickCount - mRunStartTick);
+
+        // scripts may hold on to game objects; drop them first
+        mScheduler.StopAll();
 
         // destroy listeners left to us
         for (const auto& listener : keyInputListeners) {
@@ -36,120 +64,318 @@ namespace kVox {
             delete handler.get();
         }
 
+        // stop worker threads before anything they could touch goes away
+        mJobs.Shutdown();
+
+        // destroy game objects left (first, so their drawables are handed back to the renderer)
+        ClearScene();
+
         // destroy renderer
         mRenderer.Shutdown();
 
-        // destroy game objects left
-        for (const auto& gObj : mGameObjects) {
-            delete gObj.second;
-        }
-        mGameObjects.clear();
-
         SDL_Quit();
     }
 
     void GEngine::Run() {
         // engine is running
         mRunning = true;
+        mQuitRequested = false;
+        // start frame timing from here, so the first frame doesn't see the whole setup time
+        mLastCounter = SDL_GetPerformanceCounter();
+        mAccumulator = 0.0;
+        mRunStartTick = mTickCount;
+        if (!StartInputRecorder()) {
+            mRunning = false;
+            return;
+        }
+
+        if (mConfig.headless) {
+            RunHeadless();
+            return;
+        }
+
+        FP_PROFILE_THREAD("Simulation");
+        if (mConfig.pipelined) {
+            // hand the GL context over to a dedicated render thread
+            mSnapshots.Reset();
+            mRenderer.ReleaseContext();
+            mRenderThread = std::thread(&GEngine::RenderLoop, this);
+        }
 
         // game loop until done
+        uint64_t startTick = mTickCount;
         while (mRunning) {
             ProcessInput();
             if (!mRunning) break;
             Update();
             GenerateOutputs();
+            if (mConfig.maxTicks != 0 && mTickCount - startTick >= mConfig.maxTicks)
+                mRunning = false;
         }
+
+        StopRenderThread();
+    }
+
+    void GEngine::RunHeadless() {
+        FP_PROFILE_THREAD("Simulation");
+        uint64_t startCounter = SDL_GetPerformanceCounter();
+        uint64_t startTick = mTickCount;
+        while (mRunning) {
+            // still listen for quit requests (e.g. Ctrl+C)
+            ProcessInput();
+            if (!mRunning) break;
+            uint64_t tickStart = SDL_GetPerformanceCounter();
+            Tick(mTickDelta);
+            // every iteration is one tick, so frame and sim time are the same thing here
+            mFrameSample = util::FrameStats::FrameSample();
+            mFrameSample.values[util::FrameStats::SIM_TIME] = MillisecondsSince(tickStart);
+            mFrameSample.values[util::FrameStats::FRAME_TIME] = mFrameSample.values[util::FrameStats::SIM_TIME];
+            mStats.Record(mFrameSample);
+            if (mConfig.maxTicks != 0 && mTickCount - startTick >= mConfig.maxTicks)
+                mRunning = false;
+        }
+        // report throughput
+        double wallTime = (SDL_GetPerformanceCounter() - startCounter) / (double)SDL_GetPerformanceFrequency();
+        uint64_t ticks = mTickCount - startTick;
+        printf("Headless run: %llu ticks (%.2f s simulated) in %.3f s (%.1f ticks/s)\n",
+               (unsigned long long)ticks, ticks * mTickDelta, wallTime,
+               wallTime > 0.0 ? ticks / wallTime : 0.0);
+    }
+
+    void GEngine::RenderLoop() {
+        FP_PROFILE_THREAD("Render");
+        if (!mRenderer.AcquireContext()) {
+            fprintf(stderr, "Render thread could not acquire the GL context: %s\n", SDL_GetError());
+            return;
+        }
+        while (const RenderSnapshot* snapshot = mSnapshots.Acquire()) {
+            uint64_t renderStart = SDL_GetPerformanceCounter();
+            mRenderer.Clear();
+            mRenderer.Render(*snapshot);
+            mRenderThreadTime = MillisecondsSince(renderStart);
+            mRenderer.Swap();
+            mSnapshots.Release();
+        }
+        mRenderer.ReleaseContext();
+    }
+
+    void GEngine::StopRenderThread() {
+        if (!mRenderThread.joinable())
+            return;
+        mSnapshots.Close();
+        mRenderThread.join();
+        // GL teardown happens on this thread
+        mRenderer.AcquireContext();
     }
 
     void GEngine::ProcessInput() {
+        FP_PROFILE_FUNCTION();
         // poll for events
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT: {
+            if (mInputRecorder.IsReplaying()) {
+                // replayed input comes in tick by tick; only let the user close the window
+                if (event.type == SDL_QUIT)
                     mRunning = false;
-                    break;
-                }
-                case SDL_KEYDOWN:{
-                    // handle key down input
-                    if (event.key.keysym.sym < 323)
-                        KEYS[event.key.keysym.sym] = true;
-                    for (const auto& listener : keyInputListeners) {
-                        listener->update(true, event.key);
-                    }
-                    break;
+                continue;
+            }
+            // input applies from the next tick on
+            mInputRecorder.Record(event, mTickCount - mRunStartTick);
+            DispatchEvent(event);
+        }
+    }
+
+    void GEngine::DispatchEvent(const SDL_Event& event) {
+        switch (event.type) {
+            case SDL_QUIT: {
+                mRunning = false;
+                break;
+            }
+            case SDL_KEYDOWN:{
+                // handle key down input
+                if (event.key.keysym.sym < 323)
+                    KEYS[event.key.keysym.sym] = true;
+                for (const auto& listener : keyInputListeners) {
+                    listener->update(true, event.key);
                 }
-                case SDL_KEYUP: {
-                    // handle key up input
-                    if (event.key.keysym.sym < 323)
-                        KEYS[event.key.keysym.sym] = false;
-                    for (const auto& listener : keyInputListeners) {
-                        listener->update(false, event.key);
-                    }
-                    break;
+                break;
+            }
+            case SDL_KEYUP: {
+                // handle key up input
+                if (event.key.keysym.sym < 323)
+                    KEYS[event.key.keysym.sym] = false;
+                for (const auto& listener : keyInputListeners) {
+                    listener->update(false, event.key);
                 }
-                case SDL_MOUSEBUTTONDOWN: {
-                    // handle mouse button down
-                    MOUSE[event.button.button] = true;
-                    for (const auto& listener : mouseButtonListeners) {
-                        listener->update(event.button);
-                    }
-                    break;
+                break;
+            }
+            case SDL_MOUSEBUTTONDOWN: {
+                // handle mouse button down
+                MOUSE[event.button.button] = true;
+                for (const auto& listener : mouseButtonListeners) {
+                    listener->update(event.button);
                 }
-                case SDL_MOUSEBUTTONUP: {
-                    // handle mouse button up
-                    MOUSE[event.button.button] = false;
-                    for (const auto& listener : mouseButtonListeners) {
-                        listener->update(event.button);
-                    }
-                    break;
+                break;
+            }
+            case SDL_MOUSEBUTTONUP: {
+                // handle mouse button up
+                MOUSE[event.button.button] = false;
+                for (const auto& listener : mouseButtonListeners) {
+                    listener->update(event.button);
                 }
-                case SDL_MOUSEMOTION: {
-                    // handle mouse motion
-                    for (const auto& listener : mouseMotionListeners) {
-                        listener->update(event.motion);
-                    }
-                    break;
+                break;
+            }
+            case SDL_MOUSEMOTION: {
+                // handle mouse motion
+                for (const auto& listener : mouseMotionListeners) {
+                    listener->update(event.motion);
                 }
+                break;
             }
         }
     }
 
+    bool GEngine::StartInputRecorder() {
+        if (!mConfig.replayPath.empty()) {
+            if (!mInputRecorder.StartReplay(mConfig.replayPath))
+                return false;
+            // ticks have to be the same length as when recorded, or the same input lands at different times
+            mTickDelta = mInputRecorder.GetRecordedTickDelta();
+            // one tick per frame, so replays draw the same frames every time too
+            if (mConfig.fixedFrameTime <= 0.0)
+                mConfig.fixedFrameTime = mTickDelta;
+        } else if (!mConfig.recordPath.empty()) {
+            if (!mInputRecorder.StartRecording(mConfig.recordPath, mTickDelta))
+                return false;
+        }
+        return true;
+    }
+
+    void GEngine::InjectReplayedInput() {
+        uint64_t tick = mTickCount - mRunStartTick;
+        if (mInputRecorder.ReplayFinished(tick)) {
+            mRunning = false;
+            return;
+        }
+        SDL_Event event;
+        while (mInputRecorder.NextEvent(tick, event)) {
+            DispatchEvent(event);
+        }
+    }
+
     void GEngine::Update() {
-        // tracks last tick value each time loop is run
-        static uint64_t lastTicks = 0;
-        // get current tick value (milliseconds)
-        uint64_t currentTicks = SDL_GetPerformanceCounter();
+        FP_PROFILE_FUNCTION();
+        // get current tick value
+        uint64_t currentCounter = SDL_GetPerformanceCounter();
         // calculate change from current to last, converting to seconds (in float)
-        mDeltaTime = ((currentTicks - lastTicks) / (double)SDL_GetPerformanceFrequency() );
-        // save ticks value for next frame
-        lastTicks = currentTicks;
+        mDeltaTime = ((currentCounter - mLastCounter) / (double)SDL_GetPerformanceFrequency() );
+        // save counter value for next frame
+        mLastCounter = currentCounter;
         // ensure delta time is never negative
         if (mDeltaTime < 0.0) { mDeltaTime = 0.0; }
-        // limit the time delta to 0.05 seconds (about 20 FPS).
-        if (mDeltaTime > 0.05) { mDeltaTime = 0.05; }
-
-        // have all game objects update
-        for (const auto& go : mGameObjects) {
-            go.second->Update();
+        // start measuring this frame (before clamping, so stalls show up in the stats)
+        mFrameSample = util::FrameStats::FrameSample();
+        mFrameSample.values[util::FrameStats::FRAME_TIME] = mDeltaTime * 1000.0;
+        // reproducible runs step the same amount every frame, however long the frame actually took
+        if (mConfig.fixedFrameTime > 0.0) { mDeltaTime = mConfig.fixedFrameTime; }
+        // after a long stall (e.g. window drag, breakpoint), drop the excess instead of catching up on all of it
+        if (mDeltaTime > mMaxFrameTime) { mDeltaTime = mMaxFrameTime; }
+
+        // consume the elapsed time in fixed-size ticks; leftover time carries over to the next frame
+        mAccumulator += mDeltaTime;
+        uint64_t simStart = SDL_GetPerformanceCounter();
+        while (mAccumulator >= mTickDelta && mRunning) {
+            Tick(mTickDelta);
+            mAccumulator -= mTickDelta;
+        }
+        mFrameSample.values[util::FrameStats::SIM_TIME] = MillisecondsSince(simStart);
+        // the rendered frame sits somewhere between the last two ticks
+        mInterpAlpha = mAccumulator / mTickDelta;
+        // pick up anything changed outside a tick (e.g. by input listeners) before it's drawn
+        mHierarchy.Resolve(mRegistry, mJobs);
+        ecs::InterpolateTransforms(mRegistry, mJobs, mInterpAlpha);
+    }
+
+    void GEngine::Tick(double deltaTime) {
+        FP_PROFILE_FUNCTION();
+        if (mInputRecorder.IsReplaying()) {
+            // recorded input goes in right where it did when it was recorded
+            InjectReplayedInput();
+            if (!mRunning) return;
         }
+        // anything queued since the last tick (e.g. by input listeners) goes in first
+        ApplySceneCommands();
+        if (mConfig.rebaseDistance > 0.0)
+            CheckOriginDistance();
+        // remember where everything was before this tick, for render interpolation
+        ecs::StoreTickState(mRegistry, mJobs);
+        GatherObjects();
+        // have all game objects update; the scene holds still meanwhile, since changes are queued
+        mJobs.ParallelFor(mObjectList.size(), OBJECTS_PER_JOB, [this](size_t begin, size_t end) {
+            FP_PROFILE_ZONE("GObject::Update");
+            for (size_t i = begin; i < end; i++) {
+                mObjectList[i]->Update();
+            }
+        });
+        ApplySceneCommands();
         // next, handle any registered animations for game objects
-        HandleAnims(mDeltaTime);
+        HandleAnims(deltaTime);
+        // and resume scripted behaviours that are due
+        {
+            FP_PROFILE_ZONE("kScheduler::Tick");
+            mScheduler.Tick(deltaTime);
+        }
+        ApplySceneCommands();
         // next, handle physics for phys-enabled game objects
-        HandlePhys(mDeltaTime);
+        HandlePhys(deltaTime);
+        mTickCount++;
+    }
+
+    void GEngine::CheckOriginDistance() {
+        if (mConfig.headless || mRenderer.ActiveCamera() == nullptr) return;
+        glm::dvec3 eye = mRenderer.ActiveCamera()->camPos;
+        if (glm::length(eye) > mConfig.rebaseDistance)
+            RebaseOrigin(eye);
+    }
+
+    void GEngine::RebaseOrigin(const glm::dvec3& offset) {
+        FP_PROFILE_FUNCTION();
+        // children are placed relative to their parents, so only top-level objects move; marking them dirty
+        // has the next resolve pass carry the change down
+        for (GObject* go : mGameObjects) {
+            if (go->GetParent() != nullptr) continue;
+            ecs::Transform& t = mRegistry.Get<ecs::Transform>(go->GetEntity());
+            t.pos -= offset;
+            t.prevPos -= offset;
+            t.renderPos -= offset;
+            mRegistry.Get<ecs::WorldTransform>(go->GetEntity()).dirty = true;
+        }
+        if (!mConfig.headless)
+            mRenderer.ShiftOrigin(-offset);
+        mWorldOrigin += offset;
+    }
 
-        // debug: print FPS to console
-        printf("\rFPS: %f", 1.0 / mDeltaTime);
-        fflush(stdout);
+    const glm::dvec3& GEngine::GetWorldOrigin() const { return mWorldOrigin; }
+
+    void GEngine::GatherObjects() {
+        mObjectList.assign(mGameObjects.begin(), mGameObjects.end());
     }
 
     void GEngine::HandlePhys(double deltaTime) {
-        for (const auto& it : mGameObjects) {
-            it.second->PhysUpdate(deltaTime);
-        }
+        FP_PROFILE_FUNCTION();
+        // phase 1: step every body under gravity, substepping if the tick's too long for the pull
+        mPhysics.Step(mRegistry, mJobs, mGravity, deltaTime);
+        // phase 2: rebuild the matrices of everything that moved, or was moved, this tick
+        mHierarchy.Resolve(mRegistry, mJobs);
+        // phase 3: re-sort whatever left its box in the spatial index
+        mSpatialIndex.Update(mRegistry);
+        // phase 4: find the colliders that overlap, then where they touch, and bounce them apart
+        mBroadphase.Update(mRegistry);
+        mNarrowphase.Update(mRegistry, mBroadphase.GetPairs());
     }
 
     void GEngine::HandleAnims(double deltaTime) {
+        FP_PROFILE_FUNCTION();
         for (const auto& handler : goAnimHandlers) {
             handler->update(deltaTime);
         }
@@ -162,9 +388,25 @@ namespace kVox {
     }
 
     void GEngine::GenerateOutputs() {
-        mRenderer.Clear();
-        mRenderer.Render(mDeltaTime, mRunning);
-        mRenderer.Swap();
+        FP_PROFILE_FUNCTION();
+        if (mRenderThread.joinable()) {
+            // capture this frame and let the render thread draw it while we simulate the next one
+            RenderSnapshot& snapshot = mSnapshots.BeginWrite();
+            mRenderer.BuildSnapshot(snapshot, mDeltaTime, mInterpAlpha);
+            mSnapshots.Publish();
+            // the render thread's most recent frame stands in for this one's
+            mFrameSample.values[util::FrameStats::RENDER_TIME] = mRenderThreadTime;
+        } else {
+            uint64_t renderStart = SDL_GetPerformanceCounter();
+            mRenderer.Clear();
+            mRenderer.Render(mDeltaTime, mInterpAlpha, mRunning);
+            mFrameSample.values[util::FrameStats::RENDER_TIME] = MillisecondsSince(renderStart);
+            mRenderer.Swap();
+        }
+        mFrameSample.values[util::FrameStats::GPU_TIME] = mRenderer.GetLastGpuTime();
+        mFrameSample.values[util::FrameStats::DRAW_CALLS] = mRenderer.GetLastDrawCalls();
+        mFrameSample.values[util::FrameStats::TRIANGLES] = static_cast<double>(mRenderer.GetLastTriangles());
+        mStats.Record(mFrameSample);
     }
 
     void GEngine::RegisterKeyInputListener(const std::shared_ptr<kKeyInputListener>& listener) { keyInputListeners.emplace_back(listener); }
@@ -208,6 +450,10 @@ namespace kVox {
         mouseMotionListeners.erase(_pos);
     }
 
+    bool GEngine::IsReplaying() const {
+        return mInputRecorder.IsReplaying();
+    }
+
     bool GEngine::IsKeyPressed(uint32_t key) {
         assert(key > 0 && key < 322);
         return KEYS[key];
@@ -218,83 +464,231 @@ namespace kVox {
         return MOUSE[button];
     }
 
+    void GEngine::SetTickRate(double hz) {
+        assert(hz > 0.0);
+        mTickDelta = 1.0 / hz;
+    }
+    double GEngine::GetTickDelta() const { return mTickDelta; }
+    uint64_t GEngine::GetTicksElapsed() const { return mTickCount; }
+
+    JobSystem& GEngine::GetJobSystem() { return mJobs; }
+    ecs::Registry& GEngine::GetRegistry() { return mRegistry; }
+    kScheduler& GEngine::GetScheduler() { return mScheduler; }
+    ecs::SpatialIndex& GEngine::GetSpatialIndex() { return mSpatialIndex; }
+    const ecs::Broadphase& GEngine::GetBroadphase() const { return mBroadphase; }
+    const ecs::Narrowphase& GEngine::GetNarrowphase() const { return mNarrowphase; }
+    ecs::Gravity& GEngine::GetGravity() { return mGravity; }
+    ecs::PhysicsWorld& GEngine::GetPhysicsWorld() { return mPhysics; }
+
+    const util::FrameStats& GEngine::GetFrameStats() const { return mStats; }
+
+    void GEngine::ResetFrameStats() { mStats.Clear(); }
+
+    bool GEngine::DumpFrameStats(const std::string& basePath) const {
+        bool csv = mStats.DumpCSV(basePath + ".csv");
+        bool json = mStats.DumpJSON(basePath + ".json");
+        return csv && json;
+    }
+
     Renderer& GEngine::GetRenderer() {
         return mRenderer;
     }
 
+    GObject* GEngine::GetGameObject(GObjectHandle handle) {
+        GObject** go = mGameObjects.Get(handle);
+        return (go != nullptr) ? *go : nullptr;
+    }
+
     GObject* GEngine::GetGameObject(const std::string& name) {
-        if (mGameObjects.contains(name))
-            return mGameObjects.at(name);
-        else
-            return nullptr;
+        return GetGameObject(FindGameObject(name));
     }
 
-    bool GEngine::AddGameObject(const string &name, GObject *gameObject) {
-        if (!mGameObjects.contains(name)) {
-            mGameObjects[name] = gameObject;
+    GObjectHandle GEngine::FindGameObject(const std::string& name) {
+        auto it = mObjectNames.find(name);
+        return (it != mObjectNames.end()) ? it->second : GObjectHandle();
+    }
+
+    GObjectHandle GEngine::AddGameObject(const string &name, GObject *gameObject) {
+        if (!mObjectNames.contains(name)) {
+            GObjectHandle handle = mGameObjects.Insert(gameObject);
+            mObjectNames[name] = handle;
             gameObject->name = name;
-            return true;
+            gameObject->handle = handle;
+            return handle;
         } else {
-            return false;
+            return GObjectHandle();
+        }
+    }
+
+    void GEngine::AddGameObjects(GObject* const* gameObjects, size_t count, GObjectHandle* handles) {
+        mGameObjects.Reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            GObjectHandle handle = mGameObjects.Insert(gameObjects[i]);
+            gameObjects[i]->handle = handle;
+            if (handles != nullptr) handles[i] = handle;
         }
     }
 
+    void GEngine::ReserveGameObjects(size_t count) {
+        mGameObjects.Reserve(count);
+        mRegistry.Reserve<ecs::Transform>(count);
+        mRegistry.Reserve<ecs::WorldTransform>(count);
+        mRegistry.Reserve<ecs::Velocity>(count);
+        mRegistry.Reserve<ecs::Renderable>(count);
+        mRegistry.Reserve<ecs::Hierarchy>(count);
+    }
+
     bool GEngine::RemoveGameObject(const string &name) {
-        if (mGameObjects.contains(name)) {
-            mGameObjects.erase(name);
-            return true;
-        } else {
+        return RemoveGameObject(FindGameObject(name));
+    }
+
+    bool GEngine::RemoveGameObject(GObjectHandle handle) {
+        GObject* go = GetGameObject(handle);
+        if (go == nullptr)
             return false;
+        // (unnamed objects have no entry, and mustn't take out one that happens to share their empty name)
+        auto named = mObjectNames.find(go->name);
+        if (named != mObjectNames.end() && named->second == handle)
+            mObjectNames.erase(named);
+        mGameObjects.Remove(handle);
+        go->handle = GObjectHandle();
+        return true;
+    }
+
+    void GEngine::ClearScene() {
+        // each object takes itself out of the scene as it goes
+        std::vector<GObject*> leftovers(mGameObjects.begin(), mGameObjects.end());
+        for (GObject* go : leftovers) {
+            delete go;
+        }
+        GObject::Pool().Release();
+    }
+
+    void GEngine::DestroyGameObject(GObjectHandle handle) {
+        std::lock_guard<std::mutex> guard(mSceneCommandLock);
+        mPendingDestroys.push_back(handle);
+    }
+
+    void GEngine::SpawnGameObject(const std::string& name, std::function<GObject*()> create) {
+        std::lock_guard<std::mutex> guard(mSceneCommandLock);
+        mPendingSpawns.emplace_back(name, std::move(create));
+    }
+
+    void GEngine::RequestQuit(int exitCode) {
+        bool requested = false;
+        if (mQuitRequested.compare_exchange_strong(requested, true))
+            mExitCode = exitCode;
+    }
+
+    int GEngine::GetExitCode() const { return mExitCode; }
+
+    void GEngine::ApplySceneCommands() {
+        // the loop ends once this tick is through; the rest of it still runs, on a consistent scene
+        if (mQuitRequested)
+            mRunning = false;
+        std::vector<GObjectHandle> destroys;
+        std::vector< std::pair<std::string, std::function<GObject*()>> > spawns;
+        {
+            std::lock_guard<std::mutex> guard(mSceneCommandLock);
+            if (mPendingDestroys.empty() && mPendingSpawns.empty()) return;
+            destroys.swap(mPendingDestroys);
+            spawns.swap(mPendingSpawns);
+        }
+        FP_PROFILE_FUNCTION();
+        // destroys first, so a spawn can take over a name that's going away
+        for (GObjectHandle handle : destroys) {
+            // (a handle queued twice is stale by its second turn)
+            delete GetGameObject(handle);
+        }
+        for (auto& spawn : spawns) {
+            GObject* go = spawn.second();
+            if (go == nullptr) continue;
+            if (!AddGameObject(spawn.first, go)) {
+                fprintf(stderr, "Can't spawn '%s': the name is taken\n", spawn.first.c_str());
+                delete go;
+            }
         }
     }
 
-    GObject::GObject(const Renderer &renderer) : renderer(renderer) {
-        this->pos = glm::vec3(0.0);
-        this->rot = glm::vec3(0.0);
-        this->scale = glm::vec3(1.0);
+    util::BlockPool& GObject::Pool() { return util::ImmortalPool<GObject>(); }
+    void* GObject::operator new(std::size_t size) { return Pool().Allocate(size); }
+    void GObject::operator delete(void* ptr, std::size_t size) { Pool().Free(ptr, size); }
+
+    GObject::GObject(const Renderer &renderer)
+            : registry(GEngine::Instance().GetRegistry()), entity(registry.Create()), renderer(renderer) {
+        registry.Add<ecs::Transform>(entity);
+        registry.Add<ecs::WorldTransform>(entity);
+        registry.Add<ecs::Velocity>(entity);
+        registry.Add<ecs::Renderable>(entity);
+        registry.Add<ecs::Hierarchy>(entity);
     }
     GObject::~GObject() {
         GEngine& engine = GEngine::Instance();
         // remove itself from attached game objects (will sever links!)
-        engine.RemoveGameObject(this->name);
-        if (this->parent != nullptr) {
-            this->parent->children.erase(this);
+        engine.RemoveGameObject(this->handle);
+        this->SetParent(nullptr);
+        // orphans become roots
+        std::set<GObject*> orphans;
+        orphans.swap(this->children);
+        for (auto* child : orphans) {
+            child->SetParent(nullptr);
         }
-        for (auto* child : this->children) {
-            child->parent = nullptr;
-        }
-        // clean up the object's vao, if any
-        VAO* vao = this->vao;
+        // clean up the object's vao, if any (the renderer deletes it once no frame in flight still draws it)
+        VAO* vao = registry.Get<ecs::Renderable>(entity).vao;
         if (vao != nullptr) {
-            this->vao = nullptr;
-            engine.GetRenderer().RemoveDrawable(vao);
-            vao->SetShader("__NULL_SHADER");
-            delete vao;
+            engine.GetRenderer().ReleaseDrawable(vao);
         }
+        this->DisableBounds();
+        registry.Destroy(entity);
+    }
+
+    ecs::Transform& GObject::TransformData() { return registry.Get<ecs::Transform>(entity); }
+    ecs::WorldTransform& GObject::WorldData() { return registry.Get<ecs::WorldTransform>(entity); }
+    ecs::Velocity& GObject::VelocityData() { return registry.Get<ecs::Velocity>(entity); }
+    void GObject::MarkDirty() { WorldData().dirty = true; }
+
+    bool GObject::SetParent(GObject* parent) {
+        for (GObject* p = parent; p != nullptr; p = p->parent) {
+            if (p == this) return false;
+        }
+        if (this->parent == parent) return true;
+        if (this->parent != nullptr)
+            this->parent->children.erase(this);
+        this->parent = parent;
+        if (parent != nullptr)
+            parent->children.insert(this);
+        // (re-adding, rather than editing in place, bumps the pool's version so the flattened hierarchy rebuilds)
+        registry.Add<ecs::Hierarchy>(entity, (parent != nullptr) ? parent->entity : ecs::NULL_ENTITY);
+        this->MarkDirty();
+        return true;
     }
+    GObject* GObject::GetParent() const { return this->parent; }
+    const std::set<GObject*>& GObject::GetChildren() const { return this->children; }
+    ecs::Entity GObject::GetEntity() const { return entity; }
+    GObjectHandle GObject::GetHandle() const { return handle; }
 
-    void GObject::SetVAO(VAO* vao) { this->vao = vao; }
+    void GObject::SetVAO(VAO* vao) { registry.Get<ecs::Renderable>(entity).vao = vao; }
 
-    void GObject::SetPosition(glm::vec3 pos, bool local) {
-        this->pos = pos; this->UpdateModelMtx();
+    void GObject::SetPosition(glm::dvec3 pos, bool local) {
+        TransformData().pos = pos; this->MarkDirty();
     }
     void GObject::SetPosition(double x, double y, double z, bool local) {
-        this->SetPosition(glm::vec3(x,y,z),local);
+        this->SetPosition(glm::dvec3(x,y,z),local);
     }
     void GObject::SetRotation(glm::vec3 rotEuler, bool local) {
-        this->rot = rotEuler; this->UpdateModelMtx();
+        TransformData().rot = rotEuler; this->MarkDirty();
     }
     void GObject::SetRotation(double x, double y, double z, bool local) {
         this->SetRotation(glm::vec3(x,y,z),local);
     }
     void GObject::SetScale(glm::vec3 scale, bool local) {
-        this->scale = scale; this->UpdateModelMtx();
+        TransformData().scale = scale; this->MarkDirty();
     }
     void GObject::SetScale(double x, double y, double z, bool local) {
         this->SetScale(glm::vec3(x,y,z),local);
     }
     void GObject::SetVelocity(glm::vec3 vel) {
-        this->vel = vel;
+        VelocityData().linear = vel;
     }
     void GObject::SetVelocity(double x, double y, double z) {
         this->SetVelocity(glm::vec3(x,y,z));
@@ -306,67 +700,155 @@ namespace kVox {
     }
 
     void GObject::EnablePhys() {
-        this->isPhysEnabled = true;
-        this->vel = glm::vec3(0.0); // reset velocity as a safety measure
+        registry.Add<ecs::PhysicsBody>(entity);
+        VelocityData().linear = glm::vec3(0.0); // reset velocity as a safety measure
     }
     void GObject::DisablePhys() {
-        this->isPhysEnabled = false;
+        registry.Remove<ecs::PhysicsBody>(entity);
+    }
+    void GObject::EnableBounds(glm::vec3 center, glm::vec3 halfExtents) {
+        ecs::Bounds* bounds = registry.TryGet<ecs::Bounds>(entity);
+        if (bounds == nullptr)
+            bounds = &registry.Add<ecs::Bounds>(entity);
+        bounds->center = center;
+        bounds->halfExtents = halfExtents;
+        this->MarkDirty();  // so the index picks up the new box
+    }
+    void GObject::DisableBounds() {
+        ecs::Bounds* bounds = registry.TryGet<ecs::Bounds>(entity);
+        if (bounds == nullptr) return;
+        GEngine::Instance().GetSpatialIndex().Remove(*bounds);
+        registry.Remove<ecs::Bounds>(entity);
+    }
+    ecs::ColliderShape ColliderShapeOf(PrimitiveType type) {
+        switch (type) {
+            case SPHERE:    return ecs::SHAPE_SPHERE;
+            case CONE:      // (a cone tapers off inside its capsule)
+            case CYLINDER:  return ecs::SHAPE_CAPSULE;
+            case CUBE:
+            case TORUS:     return ecs::SHAPE_BOX;
+        }
+        return ecs::SHAPE_BOX;
+    }
+
+    void GObject::SetMass(float mass) {
+        ecs::PhysicsBody* body = registry.TryGet<ecs::PhysicsBody>(entity);
+        if (body == nullptr) return;
+        body->inverseMass = (mass > 0.0f) ? 1.0f / mass : 0.0f;
+    }
+    void GObject::EnableCollision(uint32_t layer, uint32_t mask, ecs::ColliderShape shape, bool trigger) {
+        ecs::Collider* collider = registry.TryGet<ecs::Collider>(entity);
+        if (collider == nullptr)
+            collider = &registry.Add<ecs::Collider>(entity);
+        collider->layer = layer;
+        collider->mask = mask;
+        collider->shape = shape;
+        collider->trigger = trigger;
+    }
+    void GObject::DisableCollision() {
+        registry.Remove<ecs::Collider>(entity);
+    }
+    void GObject::EnableGravity(double mass) {
+        ecs::GravityBody* body = registry.TryGet<ecs::GravityBody>(entity);
+        if (body == nullptr)
+            body = &registry.Add<ecs::GravityBody>(entity);
+        body->mass = mass;
+    }
+    void GObject::DisableGravity() {
+        registry.Remove<ecs::GravityBody>(entity);
     }
     void GObject::PhysUpdate(double deltaTime) {
-        if (!isPhysEnabled || IsVec3InTolerance(this->vel,0.01)) return;
-        this->pos += this->vel * glm::vec3(deltaTime);
-        this->UpdateModelMtx();
+        if (this->Integrate(deltaTime))
+            this->UpdateModelMtx();
+    }
+    bool GObject::Integrate(double deltaTime) {
+        glm::vec3 vel = VelocityData().linear;
+        if (!registry.Has<ecs::PhysicsBody>(entity) || IsVec3InTolerance(vel,0.01)) return false;
+        TransformData().pos += glm::dvec3(vel) * deltaTime;
+        return true;
     }
 
-    glm::vec3 GObject::GetPosition() { return this->pos; }
-    glm::vec3*GObject::GetPosAsPtr() { return &this->pos; }
-    glm::vec3 GObject::GetRotEuler() { return this->rot; }
-    glm::quat GObject::GetRotation() { return glm::quat(this->rot); }
-    glm::vec3 GObject::GetScale() { return this->scale; }
-    glm::vec3 GObject::GetOrientation() { return this->orient; }
-    glm::vec3 GObject::GetOrientWithPos() { return this->orient + this->pos; }
-    glm::vec3*GObject::GetOrientAsPtr() { return &this->orient; }
-    glm::vec3 GObject::GetForwardDef() { return this->forward; }
+    glm::dvec3 GObject::GetPosition() { return TransformData().pos; }
+    glm::dvec3 GObject::GetRenderPos() { return TransformData().renderPos; }
+    glm::vec3 GObject::GetRotEuler() { return TransformData().rot; }
+    glm::quat GObject::GetRotation() { return glm::quat(TransformData().rot); }
+    glm::vec3 GObject::GetScale() { return TransformData().scale; }
+    glm::vec3 GObject::GetOrientation() { return WorldData().orient; }
+    glm::dvec3 GObject::GetOrientWithPos() { return glm::dvec3(WorldData().orient) + TransformData().pos; }
+    glm::vec3 GObject::GetForwardDef() { return WorldData().forward; }
 
-    glm::vec3 GObject::GetLocalPos() { return this->localPos; }
-    glm::vec3*GObject::GetLocalPosPtr() { return &this->localPos; }
-    glm::vec3 GObject::GetLocalRotEuler() { return this->localRot; }
-    glm::quat GObject::GetLocalRot() { return glm::quat(this->localRot); }
-    glm::vec3 GObject::GetLocalScale() { return this->localScale; }
+    glm::dvec3 GObject::GetLocalPos() { return WorldData().inheritedPos; }
+    glm::vec3 GObject::GetLocalRotEuler() { return WorldData().inheritedRot; }
+    glm::quat GObject::GetLocalRot() { return glm::quat(WorldData().inheritedRot); }
+    glm::vec3 GObject::GetLocalScale() { return WorldData().inheritedScale; }
 
-    glm::vec3 GObject::GetVelocity() { return this->vel; }
+    glm::vec3 GObject::GetVelocity() { return VelocityData().linear; }
 
     void GObject::UpdateModelMtx() {
-        glm::mat4 modelMtx = glm::scale(glm::mat4(1.0), this->scale);
-        glm::mat4 rotMtx = glm::toMat4(this->GetRotation()) * modelMtx;
-        glm::mat4 posMtx = glm::translate(glm::mat4(1.0), this->pos);
-        modelMtx = posMtx * rotMtx * modelMtx;
-        this->vao->SetModelMtx(modelMtx);
+        this->ResolveTransform();
         // update each child
         for (const auto& child : children) {
-            child->localPos = this->pos + glm::vec3(glm::vec4(child->pos,1.0) * modelMtx);
-            child->localRot = this->rot;
-            child->localScale = this->scale;
-            child->orient = this->orient;
-            child->UpdateModelMtx(modelMtx);
+            child->UpdateModelMtx();
         }
     }
 
-    void GObject::UpdateModelMtx(glm::mat4 parentModelMtx) {
-        glm::mat4 modelMtx = glm::scale(glm::mat4(1.0), this->scale);
-        glm::mat4 rotMtx = glm::toMat4(this->GetRotation()) * modelMtx;
-        glm::mat4 posMtx = glm::translate(glm::mat4(1.0), this->pos);
-        modelMtx = parentModelMtx * posMtx * rotMtx * modelMtx;
-        this->vao->SetModelMtx(modelMtx);
+    void GObject::UpdateModelMtx(glm::mat4 parentModelMtx, const glm::dvec3& parentPos) {
+        const ecs::Transform& t = TransformData();
+        ecs::WorldTransform& world = WorldData();
+        world.matrix = parentModelMtx * ecs::ComposeLocalMatrix(t);
+        world.position = parentPos + glm::dmat3(glm::mat3(parentModelMtx)) * t.pos;
+        world.moved = true;
+        VAO* vao = registry.Get<ecs::Renderable>(entity).vao;
+        if (vao != nullptr)
+            vao->SetModelMtx(world.matrix, world.position);
+    }
+
+    void GObject::ResolveTransform() {
+        const ecs::Transform& t = TransformData();
+        ecs::WorldTransform& world = WorldData();
+        glm::mat4 modelMtx = ecs::ComposeLocalMatrix(t);
+        glm::dvec3 position = t.pos;
+        if (this->parent != nullptr) {
+            // children inherit their parent's placement and heading
+            const ecs::Transform& pt = registry.Get<ecs::Transform>(this->parent->entity);
+            const ecs::WorldTransform& pworld = registry.Get<ecs::WorldTransform>(this->parent->entity);
+            world.inheritedPos = pt.pos + glm::dvec3(glm::vec4(glm::vec3(t.pos),1.0) * pworld.matrix);
+            world.inheritedRot = pt.rot;
+            world.inheritedScale = pt.scale;
+            world.orient = pworld.orient;
+            position = pworld.position + glm::dmat3(glm::mat3(pworld.matrix)) * t.pos;
+            modelMtx = pworld.matrix * modelMtx;
+        }
+        world.matrix = modelMtx;
+        world.position = position;
+        world.dirty = false;
+        world.moved = true;
+        VAO* vao = registry.Get<ecs::Renderable>(entity).vao;
+        if (vao != nullptr)
+            vao->SetModelMtx(modelMtx, position);
+    }
+
+    void GObject::StoreTickState() {
+        ecs::Transform& t = TransformData();
+        t.prevPos = t.pos;
+        VAO* vao = registry.Get<ecs::Renderable>(entity).vao;
+        if (vao != nullptr)
+            vao->StorePrevModelMtx();
+    }
+
+    void GObject::Interpolate(double alpha) {
+        ecs::Transform& t = TransformData();
+        t.renderPos = glm::mix(t.prevPos, t.pos, alpha);
     }
 
     void GObject::Update() {
-        this->orient = this->GetRotation() * this->forward;
+        ecs::WorldTransform& world = WorldData();
+        world.orient = this->GetRotation() * world.forward;
     }
 
     EnemyGO::EnemyGO(const Renderer &renderer) : GObject(renderer) {
         GEngine& engine = GEngine::Instance();
-        this->player = engine.GetGameObject(this->playerObj);
+        this->player = engine.FindGameObject(this->playerObj);
     }
 
     glm::vec3 DirToEulerRot(glm::vec3 dir) {
@@ -383,54 +865,72 @@ namespace kVox {
     }
 
     void EnemyGO::Update() {
+        GEngine& engine = GEngine::Instance();
+        GObject* player = engine.GetGameObject(this->player);
         if (player == nullptr) {
-            GEngine& engine = GEngine::Instance();
-            this->player = engine.GetGameObject(this->playerObj);
-            if (this->player == nullptr) return;
+            // not spawned yet (or gone): look it up by name until it shows up
+            this->player = engine.FindGameObject(this->playerObj);
+            player = engine.GetGameObject(this->player);
+            if (player == nullptr) return;
         }
-        glm::vec3 playerDir = player->GetPosition() - this->pos;
-        this->rot = DirToEulerRot(playerDir);
+        glm::vec3 playerDir = player->GetPosition() - this->GetPosition();
+        TransformData().rot = DirToEulerRot(playerDir);
+        this->MarkDirty();
         GObject::Update();
-        this->UpdateModelMtx();
-        this->vel = glm::normalize(playerDir) * glm::vec3(30.0);
-        this->PlayerCollisionCheck();
+        VelocityData().linear = glm::normalize(playerDir) * glm::vec3(30.0);
+        this->PlayerCollisionCheck(player);
     }
 
-    void EnemyGO::PlayerCollisionCheck() {
-        glm::vec3 playerPos = this->player->GetPosition();
-        if (glm::abs(glm::distance(playerPos, this->pos)) < 1.0) {
+    void EnemyGO::PlayerCollisionCheck(GObject* player) {
+        glm::dvec3 playerPos = player->GetPosition();
+        if (glm::abs(glm::distance(playerPos, this->GetPosition())) < 1.0) {
             // if the enemy touches the player, "corrupt player" by closing game >:D
-            std::exit(1337);
+            GEngine::Instance().RequestQuit(1337);
         }
     }
 
-    GoalGO::GoalGO(const Renderer &renderer) : GObject(renderer) {
+    /** Finds the player by name, only handing back its handle if it really is a \c PlayerGO. */
+    static GObjectHandle FindPlayer(const std::string& name) {
         GEngine& engine = GEngine::Instance();
-        this->player = dynamic_cast<PlayerGO*>(engine.GetGameObject(this->playerObj));
+        GObjectHandle handle = engine.FindGameObject(name);
+        return (dynamic_cast<PlayerGO*>(engine.GetGameObject(handle)) != nullptr) ? handle : GObjectHandle();
+    }
+
+    GoalGO::GoalGO(const Renderer &renderer) : GObject(renderer) {
+        this->player = FindPlayer(this->playerObj);
     }
 
     void GoalGO::Update() {
         GObject::Update();
-        this->PlayerCollisionCheck();
+        GEngine& engine = GEngine::Instance();
+        // the handle was checked to be a PlayerGO when it was found, and can't resolve to anything else
+        auto* player = static_cast<PlayerGO*>(engine.GetGameObject(this->player));
+        if (player == nullptr) {
+            this->player = FindPlayer(this->playerObj);
+            player = static_cast<PlayerGO*>(engine.GetGameObject(this->player));
+            if (player == nullptr) return;
+        }
+        this->PlayerCollisionCheck(player);
     }
 
-    void GoalGO::PlayerCollisionCheck() {
-        glm::vec3 playerPos = this->player->GetPosition();
-        if (glm::abs(glm::distance(playerPos, this->pos)) < 4.0) {
+    void GoalGO::PlayerCollisionCheck(PlayerGO* player) {
+        glm::dvec3 playerPos = player->GetPosition();
+        if (glm::abs(glm::distance(playerPos, this->GetPosition())) < 4.0) {
             // if the goal touches the player, increment player's goal count
-            this->player->goalCount++;
-            const std::string _name = this->name;
-            // then remove the goal from existence
-            delete this;
+            player->goalCount++;
+            // then remove the goal from existence once the update phase is over (its handle then goes stale,
+            // and scripts holding it just stop)
+            GEngine::Instance().DestroyGameObject(this->handle);
         }
     }
 
     PlayerGO::PlayerGO(const Renderer &renderer) : GObject(renderer) {}
 
     void PlayerGO::Update() {
-        if (this->goalCount >= goalsToWin) {
+        if (this->goalCount >= goalsToWin && !won) {
+            won = true;
             printf("You win!");
-            std::exit(0);
+            GEngine::Instance().RequestQuit(0);
         }
         GObject::Update();
     }
@@ -0,0 +1,150 @@
+//
+// Created by snaki on 12/14/2020.
+//
+
+#include <JobSystem.h>
+#include <algorithm>
+
+namespace kVox {
+    // which queue the current thread owns; workers set this on startup, everyone else uses queue 0
+    static thread_local unsigned tlsQueueIndex = 0;
+
+    JobSystem::~JobSystem() {
+        Shutdown();
+    }
+
+    void JobSystem::Init(unsigned workerCount) {
+        if (running) return;
+        if (workerCount == 0) {
+            unsigned hw = std::thread::hardware_concurrency();
+            workerCount = (hw > 1) ? hw - 1 : 0;
+        }
+        // queue 0 belongs to the engine thread; one more per worker
+        queues.clear();
+        for (unsigned i = 0; i <= workerCount; i++) {
+            queues.emplace_back(std::make_unique<WorkQueue>());
+        }
+        running = true;
+        for (unsigned i = 1; i <= workerCount; i++) {
+            workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+        }
+    }
+
+    void JobSystem::Shutdown() {
+        if (!running) return;
+        // drain whatever is left so no counter is left hanging
+        while (RunOne(QueueIndex())) {}
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            running = false;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+        workers.clear();
+        queues.clear();
+    }
+
+    unsigned JobSystem::QueueIndex() { return tlsQueueIndex; }
+
+    unsigned JobSystem::ThreadCount() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    void JobSystem::Submit(Job_t job, JobCounter* counter) {
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        // no pool to hand it to: just run it here
+        if (!running) {
+            job();
+            if (counter != nullptr)
+                counter->pending.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        WorkQueue& queue = *queues[QueueIndex()];
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.jobs.push_back(Job{ std::move(job), counter });
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            // taking the lock orders this against a worker about to go to sleep
+            std::lock_guard<std::mutex> guard(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    bool JobSystem::PopOwn(unsigned index, Job& job) {
+        WorkQueue& queue = *queues[index];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.jobs.empty()) return false;
+        // newest first: it's most likely still in cache
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    bool JobSystem::Steal(unsigned thief, Job& job) {
+        auto count = static_cast<unsigned>(queues.size());
+        for (unsigned i = 1; i < count; i++) {
+            WorkQueue& victim = *queues[(thief + i) % count];
+            std::unique_lock<std::mutex> guard(victim.lock, std::try_to_lock);
+            if (!guard.owns_lock() || victim.jobs.empty()) continue;
+            // oldest first: it's usually the biggest chunk of remaining work
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool JobSystem::RunOne(unsigned index) {
+        if (queues.empty()) return false;
+        Job job;
+        if (!PopOwn(index, job) && !Steal(index, job))
+            return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        job.fn();
+        if (job.counter != nullptr)
+            job.counter->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void JobSystem::WorkerLoop(unsigned index) {
+        tlsQueueIndex = index;
+        while (running) {
+            if (RunOne(index)) continue;
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [this]() { return queued.load(std::memory_order_acquire) > 0 || !running; });
+        }
+    }
+
+    void JobSystem::Wait(JobCounter& counter) {
+        unsigned index = QueueIndex();
+        while (counter.pending.load(std::memory_order_acquire) > 0) {
+            // help out instead of idling; if nothing is left to take, the last jobs are in flight elsewhere
+            if (!RunOne(index))
+                std::this_thread::yield();
+        }
+    }
+
+    void JobSystem::ParallelFor(size_t count, size_t grain, const RangeJob_t& fn) {
+        if (count == 0) return;
+        grain = std::max<size_t>(grain, 1);
+        // not worth splitting up
+        if (count <= grain || workers.empty()) {
+            fn(0, count);
+            return;
+        }
+        JobCounter counter;
+        // keep the first range for ourselves, hand out the rest
+        for (size_t begin = grain; begin < count; begin += grain) {
+            size_t end = std::min(begin + grain, count);
+            Submit([&fn, begin, end]() { fn(begin, end); }, &counter);
+        }
+        fn(0, grain);
+        Wait(counter);
+    }
+}
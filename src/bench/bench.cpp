@@ -0,0 +1,276 @@
+//
+// Created by snaki on 12/19/2020.
+//
+
+#define SDL_MAIN_HANDLED
+
+#include <SDL2/SDL.h>
+#include "GEngine.h"
+#include "kPrefab.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace kVox;
+
+/**
+ * Parameters of a synthetic benchmark scene.
+ */
+struct BenchScene {
+    std::string name = "medium";
+    /** \c PrimitiveVAO objects spawned per \c PrimitiveType */
+    int primsPerType = 100;
+    /** \c EnemyGO chasers spawned around the player */
+    int enemies = 50;
+    /** lights in the scene (the first is directional, the rest are point lights) */
+    int lights = 4;
+    /** measured frames, after the warm-up */
+    uint64_t frames = 600;
+    /** frames run before measuring starts, so shader compiles and buffer uploads don't skew results */
+    uint64_t warmup = 60;
+    uint32_t seed = 1;
+};
+
+/** Picks a preset scene by name; returns false if there is no such preset. */
+static bool ApplyPreset(BenchScene& scene, const std::string& name) {
+    if (name == "small") {
+        scene.primsPerType = 20;   scene.enemies = 10;  scene.lights = 1;
+    } else if (name == "medium") {
+        scene.primsPerType = 100;  scene.enemies = 50;  scene.lights = 4;
+    } else if (name == "large") {
+        scene.primsPerType = 500;  scene.enemies = 250; scene.lights = 8;
+    } else if (name == "lights") {
+        scene.primsPerType = 100;  scene.enemies = 0;   scene.lights = Renderer::MAX_LIGHTS;
+    } else {
+        return false;
+    }
+    scene.name = name;
+    return true;
+}
+
+// the scene is generated from a fixed seed; raw mt19937 output is the same on every platform, unlike the
+// standard distributions, so it's mapped to [0,1) by hand
+static std::mt19937 rng;
+static double Unit() { return (rng() >> 8) * (1.0 / 16777216.0); }
+static double Range(double lo, double hi) { return lo + (hi - lo) * Unit(); }
+static glm::vec3 RandomVec(double lo, double hi) { return glm::vec3(Range(lo, hi), Range(lo, hi), Range(lo, hi)); }
+
+/** Half-width of the cube the primitives are scattered in. */
+static constexpr double FIELD_SIZE = 150.0;
+/** Where the benchmark camera looks; the scene is centered on it. */
+static glm::vec3 benchCenter = glm::vec3(0.0);
+
+static VAO* MakeVAO(Renderer& renderer, PrimitiveType type) {
+    VAO* vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, type);
+    glm::vec3 color = RandomVec(0.2, 1.0);
+    vao->material.materialAmbColor = color * glm::vec3(0.1);
+    vao->material.materialDiffColor = color;
+    vao->material.materialSpecColor = glm::vec3(1.0);
+    vao->material.materialShininess = Range(0.1, 0.5);
+    renderer.AddDrawable(vao);
+    return vao;
+}
+
+static void BuildScene(GEngine& engine, Renderer& renderer, const BenchScene& scene) {
+    rng.seed(scene.seed);
+
+    // the player the chasers go after; sits still at the center
+    auto* player = new PlayerGO(renderer);
+    engine.AddGameObject("torus", player);
+    player->SetVAO(MakeVAO(renderer, PrimitiveType::TORUS));
+    player->UpdateModelMtx();
+
+    // N drifting primitives of each type
+    const PrimitiveType types[] = { CUBE, CONE, CYLINDER, TORUS, SPHERE };
+    for (PrimitiveType type : types) {
+        for (int i = 0; i < scene.primsPerType; i++) {
+            auto* go = new GObject(renderer);
+            engine.AddGameObject("prim_" + std::to_string(type) + "_" + std::to_string(i), go);
+            go->SetVAO(MakeVAO(renderer, type));
+            go->SetScale(glm::vec3(Range(1.0, 4.0)), false);
+            go->SetRotation(RandomVec(0.0, glm::two_pi<double>()), false);
+            go->SetPosition(RandomVec(-FIELD_SIZE, FIELD_SIZE), false);
+            go->EnablePhys();
+            go->SetVelocity(RandomVec(-5.0, 5.0));
+            go->UpdateModelMtx();
+        }
+    }
+
+    // M chasers, far enough out that none reach the player (which ends the game) before the run is over
+    double runTime = (scene.warmup + scene.frames) * engine.GetTickDelta();
+    double enemyDist = 30.0 * runTime + 100.0;
+    kPrefab enemy;
+    enemy.create = kPrefab::Of<EnemyGO>();
+    enemy.mesh = PrimitiveType::CYLINDER;
+    enemy.material = VAOMatProps{ glm::vec3(0.75, 0.01, 0.01), glm::vec3(0.86, 0.05, 0.05), glm::vec3(0.12, 0.0, 0.0), 0.3 };
+    enemy.scale = glm::vec3(2.0);
+    enemy.physics = true;
+    std::vector<kPrefab::Placement> placements(scene.enemies);
+    for (auto& placement : placements) {
+        glm::vec3 dir = RandomVec(-1.0, 1.0);
+        if (glm::length(dir) < 0.001f) dir = glm::vec3(1.0, 0.0, 0.0);
+        placement.pos = glm::normalize(dir) * glm::vec3(enemyDist);
+    }
+    enemy.Spawn(engine, placements.size(), placements.data());
+
+    // K lights
+    renderer.ClearLights();
+    for (int i = 0; i < scene.lights; i++) {
+        LightDesc light;
+        if (i == 0) {
+            light.type = DIRECTIONAL_LIGHT;
+            light.dir = glm::vec3(1.0, 1.0, 1.0);
+            light.color = glm::vec3(1.0);
+        } else {
+            light.type = POINT_LIGHT;
+            light.pos = RandomVec(-FIELD_SIZE, FIELD_SIZE);
+            light.color = RandomVec(0.3, 1.0);
+        }
+        renderer.AddLight(light);
+    }
+}
+
+static void SetupCamera(GEngine& engine, Renderer& renderer, const BenchScene& scene) {
+    auto* camera = new Camera();
+    camera->cameraTheta = 0.0;
+    camera->cameraPhi = glm::half_pi<double>();
+    camera->camDist = FIELD_SIZE * 2.0;
+    camera->SetTargetLookAt(&benchCenter);
+    camera->SetLookingAtTgt(true);
+    camera->RecomputeCamPos();
+    renderer.AddCamera("bench", camera);
+    renderer.SetActiveCamera("bench");
+
+    // scripted path: one orbit around the scene over the measured frames, bobbing up and down and
+    // swinging in close halfway through; driven by the tick count so every run sees the same views
+    auto* cameraPath = new AnimHandler_t([scene, camera](double) -> void {
+        GEngine& engine = GEngine::Instance();
+        uint64_t tick = engine.GetTicksElapsed();
+        if (tick == scene.warmup) {
+            // warm-up done: measure from here on
+            engine.ResetFrameStats();
+        }
+        double t = (tick < scene.warmup) ? 0.0 : (double)(tick - scene.warmup) / (double)scene.frames;
+        camera->cameraTheta = glm::two_pi<double>() * t;
+        camera->cameraPhi = glm::half_pi<double>() + 0.4 * std::sin(2.0 * glm::two_pi<double>() * t);
+        camera->camDist = FIELD_SIZE * (1.25 + 0.75 * std::cos(glm::two_pi<double>() * t));
+    });
+    engine.RegisterAnim(std::make_shared<kAnimHandler>(*cameraPath));
+}
+
+/** Writes the scene setup and its frame statistics as JSON. */
+static bool WriteResults(const std::string& path, const BenchScene& scene, const EngineConfig& config,
+                         const util::FrameStats& stats, double wallTime) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't open results file for writing: %s\n", path.c_str());
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"scene\": {\"name\": \"%s\", \"prims_per_type\": %d, \"enemies\": %d, \"lights\": %d, "
+                  "\"frames\": %llu, \"warmup\": %llu, \"seed\": %u},\n",
+            scene.name.c_str(), scene.primsPerType, scene.enemies, scene.lights,
+            (unsigned long long)scene.frames, (unsigned long long)scene.warmup, scene.seed);
+    fprintf(file, "  \"mode\": \"%s\",\n", config.headless ? "headless" : (config.pipelined ? "pipelined" : "serial"));
+    fprintf(file, "  \"wall_s\": %.4f,\n", wallTime);
+    fprintf(file, "  \"frames\": %llu,\n  \"hitches\": %llu,\n",
+            (unsigned long long)stats.FrameCount(), (unsigned long long)stats.HitchCount());
+    fprintf(file, "  \"metrics\": {\n");
+    for (int m = 0; m < util::FrameStats::METRIC_COUNT; m++) {
+        auto metric = static_cast<util::FrameStats::Metric>(m);
+        fprintf(file, "    \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+                util::FrameStats::MetricName(metric), stats.Mean(metric), stats.Percentile(metric, 50.0),
+                stats.Percentile(metric, 95.0), stats.Percentile(metric, 99.0), stats.Max(metric),
+                (m + 1 < util::FrameStats::METRIC_COUNT) ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    bool ok = (ferror(file) == 0);
+    fclose(file);
+    return ok;
+}
+
+static void PrintUsage() {
+    printf("usage: fp_bench [--scene small|medium|large|lights] [--prims N] [--enemies M] [--lights K]\n"
+           "                [--frames F] [--warmup W] [--seed S] [--out PATH] [--pipelined] [--headless]\n");
+}
+
+/**
+ * Benchmark harness: builds a synthetic scene, runs it for a fixed number of frames along a scripted camera
+ * path, and writes frame timing percentiles as JSON (bench.json by default).
+ */
+int main(int argc, char *argv[]) {
+    BenchScene scene;
+    EngineConfig config;
+    std::string outPath = "bench.json";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scene" && hasValue) {
+            if (!ApplyPreset(scene, argv[++i])) {
+                fprintf(stderr, "Unknown scene: %s\n", argv[i]);
+                PrintUsage();
+                return 1;
+            }
+        } else if (arg == "--prims" && hasValue) {
+            scene.primsPerType = std::atoi(argv[++i]);
+            scene.name = "custom";
+        } else if (arg == "--enemies" && hasValue) {
+            scene.enemies = std::atoi(argv[++i]);
+            scene.name = "custom";
+        } else if (arg == "--lights" && hasValue) {
+            scene.lights = std::atoi(argv[++i]);
+            scene.name = "custom";
+        } else if (arg == "--frames" && hasValue) {
+            scene.frames = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--warmup" && hasValue) {
+            scene.warmup = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            scene.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else if (arg == "--pipelined") {
+            config.pipelined = true;
+        } else if (arg == "--headless") {
+            config.headless = true;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (scene.lights > Renderer::MAX_LIGHTS) {
+        fprintf(stderr, "Lights capped at %d\n", Renderer::MAX_LIGHTS);
+        scene.lights = Renderer::MAX_LIGHTS;
+    }
+    if (scene.frames == 0) scene.frames = 1;
+
+    GEngine& engine = GEngine::Instance();
+    // one tick per frame, however long frames take, so every run simulates exactly the same thing
+    config.fixedFrameTime = engine.GetTickDelta();
+    config.maxTicks = scene.warmup + scene.frames;
+    if (!engine.Init(config)) {
+        fprintf(stderr, "Engine failed to initialize\n");
+        engine.Shutdown();
+        return 1;
+    }
+    Renderer& renderer = engine.GetRenderer();
+    SetupCamera(engine, renderer, scene);
+    BuildScene(engine, renderer, scene);
+    if (scene.warmup == 0) engine.ResetFrameStats();
+
+    uint64_t startCounter = SDL_GetPerformanceCounter();
+    engine.Run();
+    double wallTime = (SDL_GetPerformanceCounter() - startCounter) / (double)SDL_GetPerformanceFrequency();
+
+    const util::FrameStats& stats = engine.GetFrameStats();
+    printf("%s: %llu frames, frame ms p50 %.3f / p95 %.3f / p99 %.3f / max %.3f, %llu hitches\n",
+           scene.name.c_str(), (unsigned long long)stats.FrameCount(),
+           stats.Percentile(util::FrameStats::FRAME_TIME, 50.0), stats.Percentile(util::FrameStats::FRAME_TIME, 95.0),
+           stats.Percentile(util::FrameStats::FRAME_TIME, 99.0), stats.Max(util::FrameStats::FRAME_TIME),
+           (unsigned long long)stats.HitchCount());
+    bool written = WriteResults(outPath, scene, config, stats, wallTime);
+
+    engine.Shutdown();
+    return written ? 0 : 1;
+}
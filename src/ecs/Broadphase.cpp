@@ -0,0 +1,136 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/Broadphase.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+
+namespace kVox::ecs {
+    /** Past this many new endpoints in one update, a full sort beats inserting them one by one. */
+    static constexpr size_t INSERTION_SORT_LIMIT = 64;
+
+    void Broadphase::Update(Registry& registry) {
+        FP_PROFILE_FUNCTION();
+        updateCount++;
+        size_t added = 0;
+        // colliders are the minority, so they drive the query
+        auto colliders = registry.View<Collider, Bounds, WorldTransform>();
+        ComponentPool<PhysicsBody>& bodies = registry.Pool<PhysicsBody>();
+        colliders.Each([&](Entity entity, Collider& collider, Bounds& bounds, WorldTransform& world) {
+            if (entity >= proxyOf.size())
+                proxyOf.resize(entity + 1, NONE);
+            if (proxyOf[entity] == NONE) {
+                proxyOf[entity] = AddProxy(entity);
+                added++;
+            }
+            Proxy& proxy = proxies[proxyOf[entity]];
+            proxy.box = WorldBounds(bounds, world);
+            proxy.layer = collider.layer;
+            proxy.mask = collider.mask;
+            proxy.dynamic = bodies.Has(entity);
+            proxy.seen = updateCount;
+        });
+
+        // drop colliders that went away (destroyed, or lost a component) since the last update
+        bool removed = false;
+        for (uint32_t i = 0; i < proxies.size(); i++) {
+            Proxy& proxy = proxies[i];
+            if (!proxy.alive || proxy.seen == updateCount) continue;
+            proxy.alive = false;
+            proxyOf[proxy.entity] = NONE;
+            freeProxies.push_back(i);
+            liveCount--;
+            removed = true;
+        }
+        if (removed) {
+            endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(), [this](const Endpoint& endpoint) {
+                return !proxies[endpoint.Proxy()].alive;
+            }), endpoints.end());
+        }
+
+        if (added > INSERTION_SORT_LIMIT || axis != sortedAxis) {
+            sortedAxis = axis;
+            for (Endpoint& endpoint : endpoints) {
+                const Aabb& box = proxies[endpoint.Proxy()].box;
+                endpoint.value = endpoint.IsMax() ? box.max[sortedAxis] : box.min[sortedAxis];
+            }
+            std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& a, const Endpoint& b) {
+                return a.value < b.value || (a.value == b.value && a.IsMax() < b.IsMax());
+            });
+        } else {
+            SortEndpoints();
+        }
+        Sweep();
+    }
+
+    uint32_t Broadphase::AddProxy(Entity entity) {
+        uint32_t index;
+        if (!freeProxies.empty()) {
+            index = freeProxies.back();
+            freeProxies.pop_back();
+        } else {
+            index = static_cast<uint32_t>(proxies.size());
+            proxies.emplace_back();
+        }
+        proxies[index] = Proxy();
+        proxies[index].entity = entity;
+        proxies[index].alive = true;
+        liveCount++;
+        // (new endpoints go at the end; the sort moves them into place)
+        endpoints.push_back(Endpoint { 0.0f, index << 1 });
+        endpoints.push_back(Endpoint { 0.0f, (index << 1) | 1 });
+        return index;
+    }
+
+    void Broadphase::SortEndpoints() {
+        FP_PROFILE_FUNCTION();
+        for (Endpoint& endpoint : endpoints) {
+            const Aabb& box = proxies[endpoint.Proxy()].box;
+            endpoint.value = endpoint.IsMax() ? box.max[sortedAxis] : box.min[sortedAxis];
+        }
+        // insertion sort: last tick's order is almost right, so each endpoint only moves a step or two
+        // (ties put min ends first, so boxes that just touch still pair up)
+        for (size_t i = 1; i < endpoints.size(); i++) {
+            Endpoint endpoint = endpoints[i];
+            size_t j = i;
+            while (j > 0 && (endpoints[j - 1].value > endpoint.value
+                             || (endpoints[j - 1].value == endpoint.value && endpoints[j - 1].IsMax() && !endpoint.IsMax()))) {
+                endpoints[j] = endpoints[j - 1];
+                j--;
+            }
+            endpoints[j] = endpoint;
+        }
+    }
+
+    void Broadphase::Sweep() {
+        FP_PROFILE_FUNCTION();
+        pairs.clear();
+        active.clear();
+        for (const Endpoint& endpoint : endpoints) {
+            uint32_t index = endpoint.Proxy();
+            Proxy& proxy = proxies[index];
+            if (endpoint.IsMax()) {
+                // leaves the active list, swapping the last one into its slot
+                const Active& last = active.back();
+                proxies[last.proxy].activeSlot = proxy.activeSlot;
+                active[proxy.activeSlot] = last;
+                active.pop_back();
+                proxy.activeSlot = NONE;
+                continue;
+            }
+            // everything still active overlaps this box on the sort axis; check the rest
+            Active entering { proxy.box, proxy.layer, proxy.mask, index, proxy.dynamic };
+            for (const Active& candidate : active) {
+                if (!entering.box.Overlaps(candidate.box)) continue;
+                if (!entering.dynamic && !candidate.dynamic) continue;
+                if (!(entering.layer & candidate.mask) || !(candidate.layer & entering.mask)) continue;
+                Entity other = proxies[candidate.proxy].entity;
+                pairs.emplace_back(std::min(proxy.entity, other), std::max(proxy.entity, other));
+            }
+            proxy.activeSlot = static_cast<uint32_t>(active.size());
+            active.push_back(entering);
+        }
+    }
+}
@@ -0,0 +1,337 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/Gravity.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace kVox::ecs {
+    /** Bits of each coordinate in a Morton key, and so the deepest the tree goes. */
+    static constexpr int LEVELS = 21;
+    /** Cells with this few bodies aren't split further. */
+    static constexpr uint32_t LEAF_SIZE = 8;
+    /** Levels built on the calling thread; the 8^SPLIT_LEVEL cells below them are built in parallel. */
+    static constexpr int SPLIT_LEVEL = 2;
+    static constexpr size_t SPLIT_CELLS = size_t(1) << (3 * SPLIT_LEVEL);
+    /** How many bodies a worker takes per job, in the force passes and the per-body ones. */
+    static constexpr size_t BODIES_PER_JOB = 64;
+    static constexpr size_t KEYS_PER_JOB = 2048;
+    /** Below this many bodies, sorting keys in parallel costs more than it saves. */
+    static constexpr size_t PARALLEL_SORT_MIN = 8192;
+    /** Keeps 1/r^3 finite for a body against itself (which then adds nothing, being 0 away) when unsoftened. */
+    static constexpr double MIN_DISTANCE_SQ = 1e-30;
+
+    /** Spreads the low 21 bits of \c v out to every third bit. */
+    static uint64_t SpreadBits(uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    /** Which child (x: 4, y: 2, z: 1) a key falls in at \c level, 0 being the root's children. */
+    static uint32_t OctantOf(uint64_t key, int level) {
+        return static_cast<uint32_t>(key >> (3 * (LEVELS - 1 - level))) & 7u;
+    }
+
+    static glm::dvec3 OctantOffset(uint32_t octant) {
+        return glm::dvec3((octant >> 2) & 1u, (octant >> 1) & 1u, octant & 1u);
+    }
+
+    void Gravity::ComputeAccelerations(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z,
+                                       const double* mass, double* ax, double* ay, double* az) {
+        bodyCount = count;
+        usedTree = (mode == MODE_BARNES_HUT) || (mode == MODE_AUTO && count > exactLimit);
+        if (!usedTree) {
+            nodes.clear();
+            Exact(jobs, count, x, y, z, mass, ax, ay, az);
+            return;
+        }
+        SortBodies(jobs, count, x, y, z, mass);
+        BuildTree(jobs);
+        Walk(jobs, ax, ay, az);
+    }
+
+    void Gravity::Exact(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z,
+                        const double* mass, double* ax, double* ay, double* az) const {
+        FP_PROFILE_FUNCTION();
+        double eps2 = softening * softening;
+        double g = constant;
+        // every body against every other, itself included: it's 0 away from itself, so it adds nothing
+        jobs.ParallelFor(count, BODIES_PER_JOB, [=](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+                size_t j = 0;
+#if defined(__AVX__)
+                __m256d xi = _mm256_set1_pd(x[i]), yi = _mm256_set1_pd(y[i]), zi = _mm256_set1_pd(z[i]);
+                __m256d soft = _mm256_set1_pd(eps2), floor = _mm256_set1_pd(MIN_DISTANCE_SQ), one = _mm256_set1_pd(1.0);
+                __m256d accX = _mm256_setzero_pd(), accY = _mm256_setzero_pd(), accZ = _mm256_setzero_pd();
+                for (; j + 4 <= count; j += 4) {
+                    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+                    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+                    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+                    __m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                               _mm256_add_pd(_mm256_mul_pd(dz, dz), soft));
+                    __m256d inv = _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_max_pd(r2, floor)));
+                    __m256d s = _mm256_mul_pd(_mm256_loadu_pd(mass + j), _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv)));
+                    accX = _mm256_add_pd(accX, _mm256_mul_pd(dx, s));
+                    accY = _mm256_add_pd(accY, _mm256_mul_pd(dy, s));
+                    accZ = _mm256_add_pd(accZ, _mm256_mul_pd(dz, s));
+                }
+                alignas(32) double lanes[3][4];
+                _mm256_store_pd(lanes[0], accX);
+                _mm256_store_pd(lanes[1], accY);
+                _mm256_store_pd(lanes[2], accZ);
+                sx = lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+                sy = lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3];
+                sz = lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3];
+#elif defined(__SSE2__)
+                __m128d xi = _mm_set1_pd(x[i]), yi = _mm_set1_pd(y[i]), zi = _mm_set1_pd(z[i]);
+                __m128d soft = _mm_set1_pd(eps2), floor = _mm_set1_pd(MIN_DISTANCE_SQ), one = _mm_set1_pd(1.0);
+                __m128d accX = _mm_setzero_pd(), accY = _mm_setzero_pd(), accZ = _mm_setzero_pd();
+                for (; j + 2 <= count; j += 2) {
+                    __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), xi);
+                    __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), yi);
+                    __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + j), zi);
+                    __m128d r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)),
+                                            _mm_add_pd(_mm_mul_pd(dz, dz), soft));
+                    __m128d inv = _mm_div_pd(one, _mm_sqrt_pd(_mm_max_pd(r2, floor)));
+                    __m128d s = _mm_mul_pd(_mm_loadu_pd(mass + j), _mm_mul_pd(inv, _mm_mul_pd(inv, inv)));
+                    accX = _mm_add_pd(accX, _mm_mul_pd(dx, s));
+                    accY = _mm_add_pd(accY, _mm_mul_pd(dy, s));
+                    accZ = _mm_add_pd(accZ, _mm_mul_pd(dz, s));
+                }
+                alignas(16) double lanes[3][2];
+                _mm_store_pd(lanes[0], accX);
+                _mm_store_pd(lanes[1], accY);
+                _mm_store_pd(lanes[2], accZ);
+                sx = lanes[0][0] + lanes[0][1];
+                sy = lanes[1][0] + lanes[1][1];
+                sz = lanes[2][0] + lanes[2][1];
+#endif
+                for (; j < count; j++) {
+                    double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                    double inv = 1.0 / std::sqrt(std::max(dx * dx + dy * dy + dz * dz + eps2, MIN_DISTANCE_SQ));
+                    double s = mass[j] * inv * inv * inv;
+                    sx += dx * s; sy += dy * s; sz += dz * s;
+                }
+                ax[i] = g * sx;
+                ay[i] = g * sy;
+                az[i] = g * sz;
+            }
+        });
+    }
+
+    void Gravity::SortBodies(JobSystem& jobs, size_t count, const double* x, const double* y, const double* z,
+                             const double* mass) {
+        FP_PROFILE_FUNCTION();
+        // the root cell: a cube around everything, from per-chunk bounds
+        size_t chunks = (count + KEYS_PER_JOB - 1) / KEYS_PER_JOB;
+        std::vector<glm::dvec3> lows(chunks), highs(chunks);
+        jobs.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                glm::dvec3 lo(x[c * KEYS_PER_JOB], y[c * KEYS_PER_JOB], z[c * KEYS_PER_JOB]), hi = lo;
+                for (size_t i = c * KEYS_PER_JOB; i < std::min(count, (c + 1) * KEYS_PER_JOB); i++) {
+                    glm::dvec3 p(x[i], y[i], z[i]);
+                    lo = glm::min(lo, p);
+                    hi = glm::max(hi, p);
+                }
+                lows[c] = lo;
+                highs[c] = hi;
+            }
+        });
+        glm::dvec3 lo = lows[0], hi = highs[0];
+        for (size_t c = 1; c < chunks; c++) {
+            lo = glm::min(lo, lows[c]);
+            hi = glm::max(hi, highs[c]);
+        }
+        glm::dvec3 extent = hi - lo;
+        rootSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-9)) * (1.0 + 1e-9);
+        rootMin = lo;
+
+        // Morton keys: nearby bodies get nearby keys, so every cell of the tree is one run of the sorted order
+        sorted.order.resize(count);
+        double scale = double(1u << LEVELS) / rootSize;
+        uint64_t top = (1u << LEVELS) - 1;
+        glm::dvec3 origin = rootMin;
+        std::pair<uint64_t, uint32_t>* order = sorted.order.data();
+        jobs.ParallelFor(count, KEYS_PER_JOB, [=](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint64_t qx = std::min(top, static_cast<uint64_t>((x[i] - origin.x) * scale));
+                uint64_t qy = std::min(top, static_cast<uint64_t>((y[i] - origin.y) * scale));
+                uint64_t qz = std::min(top, static_cast<uint64_t>((z[i] - origin.z) * scale));
+                order[i] = { SpreadBits(qx) << 2 | SpreadBits(qy) << 1 | SpreadBits(qz), static_cast<uint32_t>(i) };
+            }
+        });
+
+        // sort runs in parallel, then merge them pairwise, a round at a time
+        size_t runs = std::min<size_t>(jobs.ThreadCount(), count / KEYS_PER_JOB);
+        if (count < PARALLEL_SORT_MIN || runs < 2) {
+            std::sort(order, order + count);
+        } else {
+            auto runBegin = [count, runs](size_t r) { return std::min(count, r * ((count + runs - 1) / runs)); };
+            jobs.ParallelFor(runs, 1, [&](size_t begin, size_t end) {
+                for (size_t r = begin; r < end; r++)
+                    std::sort(order + runBegin(r), order + runBegin(r + 1));
+            });
+            for (size_t width = 1; width < runs; width *= 2) {
+                size_t merges = (runs + 2 * width - 1) / (2 * width);
+                jobs.ParallelFor(merges, 1, [&](size_t begin, size_t end) {
+                    for (size_t m = begin; m < end; m++) {
+                        size_t first = m * 2 * width;
+                        size_t middle = std::min(runs, first + width), last = std::min(runs, first + 2 * width);
+                        std::inplace_merge(order + runBegin(first), order + runBegin(middle), order + runBegin(last));
+                    }
+                });
+            }
+        }
+
+        // and the bodies, in that order, so the walk streams through them
+        sorted.keys.resize(count);
+        sorted.index.resize(count);
+        sorted.x.resize(count); sorted.y.resize(count); sorted.z.resize(count); sorted.mass.resize(count);
+        jobs.ParallelFor(count, KEYS_PER_JOB, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint32_t from = order[i].second;
+                sorted.keys[i] = order[i].first;
+                sorted.index[i] = from;
+                sorted.x[i] = x[from]; sorted.y[i] = y[from]; sorted.z[i] = z[from];
+                sorted.mass[i] = mass[from];
+            }
+        });
+    }
+
+    void Gravity::BuildTree(JobSystem& jobs) {
+        FP_PROFILE_FUNCTION();
+        auto count = static_cast<uint32_t>(sorted.keys.size());
+        // the cells at SPLIT_LEVEL are runs of keys sharing their top bits; their subtrees are independent
+        int shift = 3 * (LEVELS - SPLIT_LEVEL);
+        subtreeBegin.resize(SPLIT_CELLS + 1);
+        for (size_t cell = 0; cell <= SPLIT_CELLS; cell++) {
+            subtreeBegin[cell] = static_cast<uint32_t>(std::lower_bound(sorted.keys.begin(), sorted.keys.end(), uint64_t(cell) << shift,
+                                                                        [](uint64_t key, uint64_t bound) { return key < bound; })
+                                                       - sorted.keys.begin());
+        }
+        subtrees.resize(SPLIT_CELLS);
+        double cellSize = rootSize / double(1u << SPLIT_LEVEL);
+        jobs.ParallelFor(SPLIT_CELLS, 1, [&](size_t begin, size_t end) {
+            for (size_t cell = begin; cell < end; cell++) {
+                subtrees[cell].clear();
+                if (subtreeBegin[cell] == subtreeBegin[cell + 1]) continue;
+                glm::dvec3 min = rootMin;
+                for (int level = 0; level < SPLIT_LEVEL; level++) {
+                    uint32_t octant = static_cast<uint32_t>(cell >> (3 * (SPLIT_LEVEL - 1 - level))) & 7u;
+                    min += OctantOffset(octant) * (rootSize / double(2u << level));
+                }
+                BuildNode(subtrees[cell], subtreeBegin[cell], subtreeBegin[cell + 1], SPLIT_LEVEL, min, cellSize, false);
+            }
+        });
+        nodes.clear();
+        BuildNode(nodes, 0, count, 0, rootMin, rootSize, true);
+    }
+
+    uint32_t Gravity::BuildNode(std::vector<Node>& out, uint32_t begin, uint32_t end, int level, const glm::dvec3& min,
+                                double size, bool splice) const {
+        auto self = static_cast<uint32_t>(out.size());
+        if (splice && level == SPLIT_LEVEL && end - begin > LEAF_SIZE) {
+            // built already: copy it in, moving its skip links along
+            const std::vector<Node>& subtree = subtrees[sorted.keys[begin] >> (3 * (LEVELS - SPLIT_LEVEL))];
+            out.insert(out.end(), subtree.begin(), subtree.end());
+            for (size_t i = self; i < out.size(); i++)
+                out[i].skip += self;
+            return self;
+        }
+        out.emplace_back();
+        Node node {};
+        node.center = glm::dvec3(0.0);
+        node.mass = 0.0;
+        node.min = min;
+        node.size = size;
+        node.begin = begin;
+        node.count = end - begin;
+        node.leaf = (end - begin <= LEAF_SIZE) || (level == LEVELS);
+        if (node.leaf) {
+            for (uint32_t i = begin; i < end; i++) {
+                node.center += glm::dvec3(sorted.x[i], sorted.y[i], sorted.z[i]) * sorted.mass[i];
+                node.mass += sorted.mass[i];
+            }
+        } else {
+            // the children are consecutive runs of the range, by the key's digit at this level
+            double half = 0.5 * size;
+            uint32_t start = begin;
+            for (uint32_t octant = 0; octant < 8 && start < end; octant++) {
+                uint32_t stop = static_cast<uint32_t>(std::partition_point(
+                        sorted.keys.begin() + start, sorted.keys.begin() + end,
+                        [=](uint64_t key) { return OctantOf(key, level) <= octant; }) - sorted.keys.begin());
+                if (stop == start) continue;
+                uint32_t child = BuildNode(out, start, stop, level + 1, min + OctantOffset(octant) * half, half, splice);
+                node.center += out[child].center * out[child].mass;
+                node.mass += out[child].mass;
+                start = stop;
+            }
+        }
+        node.center = (node.mass > 0.0) ? node.center / node.mass : min + glm::dvec3(0.5 * size);
+        node.skip = static_cast<uint32_t>(out.size());
+        out[self] = node;
+        return self;
+    }
+
+    void Gravity::Walk(JobSystem& jobs, double* ax, double* ay, double* az) const {
+        FP_PROFILE_FUNCTION();
+        double theta2 = theta * theta;
+        double eps2 = softening * softening;
+        double g = constant;
+        auto count = static_cast<uint32_t>(sorted.keys.size());
+        const Node* tree = nodes.data();
+        auto end = static_cast<uint32_t>(nodes.size());
+        const double* x = sorted.x.data();
+        const double* y = sorted.y.data();
+        const double* z = sorted.z.data();
+        const double* mass = sorted.mass.data();
+        const uint32_t* index = sorted.index.data();
+        // bodies go in Morton order, so each job's walks take nearly the same path through the tree
+        jobs.ParallelFor(count, BODIES_PER_JOB, [=](size_t begin, size_t last) {
+            for (size_t i = begin; i < last; i++) {
+                glm::dvec3 p(x[i], y[i], z[i]);
+                glm::dvec3 acc(0.0);
+                auto pull = [&](const glm::dvec3& at, double m) {
+                    glm::dvec3 d = at - p;
+                    double inv = 1.0 / std::sqrt(std::max(glm::dot(d, d) + eps2, MIN_DISTANCE_SQ));
+                    acc += d * (m * inv * inv * inv);
+                };
+                uint32_t n = 0;
+                while (n < end) {
+                    const Node& node = tree[n];
+                    // far enough to be one mass; never the cell the body is in, however it's shaped
+                    glm::dvec3 d = node.center - p;
+                    bool inside = glm::all(glm::greaterThanEqual(p, node.min)) && glm::all(glm::lessThan(p, node.min + node.size));
+                    if (!inside && node.size * node.size < theta2 * glm::dot(d, d)) {
+                        pull(node.center, node.mass);
+                        n = node.skip;
+                    } else if (node.leaf) {
+                        for (uint32_t j = node.begin; j < node.begin + node.count; j++)
+                            pull(glm::dvec3(x[j], y[j], z[j]), mass[j]);
+                        n = node.skip;
+                    } else {
+                        n++;
+                    }
+                }
+                ax[index[i]] = g * acc.x;
+                ay[index[i]] = g * acc.y;
+                az[index[i]] = g * acc.z;
+            }
+        });
+    }
+}
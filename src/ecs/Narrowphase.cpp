@@ -0,0 +1,496 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/Narrowphase.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace kVox::ecs {
+    /** Approach speeds below this don't bounce, so resting contacts settle instead of buzzing. */
+    static constexpr float RESTING_SPEED = 0.5f;
+
+    // the batch tests, a register's worth of pairs at a time: each lane is one pair, and a compare's sign bits
+    // say which of them touch
+
+#if defined(__AVX__)
+    struct Lanes {
+        typedef __m256 Reg;
+        static constexpr size_t WIDTH = 8;
+        static Reg Load(const float* p) { return _mm256_loadu_ps(p); }
+        static Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+        static Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+        static Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+        static Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+        static Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+        static Reg Neg(Reg a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+        static uint32_t LessThan(Reg a, Reg b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))); }
+    };
+#elif defined(__SSE__)
+    struct Lanes {
+        typedef __m128 Reg;
+        static constexpr size_t WIDTH = 4;
+        static Reg Load(const float* p) { return _mm_loadu_ps(p); }
+        static Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+        static Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+        static Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+        static Reg Min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+        static Reg Max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+        static Reg Neg(Reg a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+        static uint32_t LessThan(Reg a, Reg b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+    };
+#endif
+
+    /** The point on a capsule's core segment nearest to \c point. */
+    static glm::dvec3 ClosestOnSegment(const glm::dvec3& center, const glm::vec3& axis, float segmentHalf, const glm::dvec3& point) {
+        double t = glm::clamp(glm::dot(point - center, glm::dvec3(axis)), -double(segmentHalf), double(segmentHalf));
+        return center + glm::dvec3(axis) * t;
+    }
+
+    /** The nearest points of two segments, each given by a start and a direction spanning it. */
+    static void ClosestBetweenSegments(const glm::dvec3& p1, const glm::dvec3& d1, const glm::dvec3& p2, const glm::dvec3& d2,
+                                       glm::dvec3& c1, glm::dvec3& c2) {
+        constexpr double EPSILON = 1e-12;
+        glm::dvec3 r = p1 - p2;
+        double a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        double s = 0.0, t = 0.0;
+        if (a <= EPSILON && e <= EPSILON) {
+            // both are points
+        } else if (a <= EPSILON) {
+            t = glm::clamp(f / e, 0.0, 1.0);
+        } else {
+            double c = glm::dot(d1, r);
+            if (e <= EPSILON) {
+                s = glm::clamp(-c / a, 0.0, 1.0);
+            } else {
+                double b = glm::dot(d1, d2);
+                double denom = a * e - b * b;   // 0 when parallel: any s will do, so take the start
+                s = (denom > EPSILON) ? glm::clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+                t = (b * s + f) / e;
+                if (t < 0.0) {
+                    t = 0.0;
+                    s = glm::clamp(-c / a, 0.0, 1.0);
+                } else if (t > 1.0) {
+                    t = 1.0;
+                    s = glm::clamp((b - c) / a, 0.0, 1.0);
+                }
+            }
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    void Narrowphase::SphereBatch::Clear() {
+        dx.clear(); dy.clear(); dz.clear(); reach.clear();
+        entries.clear();
+    }
+
+    void Narrowphase::SphereBatch::Push(uint32_t contact, const glm::dvec3& centerA, float radiusA,
+                                       const glm::dvec3& centerB, float radiusB) {
+        glm::vec3 d(centerB - centerA);
+        dx.push_back(d.x); dy.push_back(d.y); dz.push_back(d.z);
+        reach.push_back(radiusA + radiusB);
+        entries.push_back(Entry { contact, centerA, radiusA });
+    }
+
+    void Narrowphase::BoxBatch::Clear() {
+        px.clear(); py.clear(); pz.clear();
+        for (std::vector<float>& axis : axes) axis.clear();
+        hx.clear(); hy.clear(); hz.clear(); radius.clear();
+        entries.clear();
+    }
+
+    void Narrowphase::BoxBatch::Push(uint32_t contact, uint32_t box, const Shape& boxShape, const glm::dvec3& center,
+                                     float sphereRadius, bool flip) {
+        glm::vec3 p(center - boxShape.center);
+        px.push_back(p.x); py.push_back(p.y); pz.push_back(p.z);
+        for (int i = 0; i < 9; i++)
+            axes[i].push_back(boxShape.axes[i / 3][i % 3]);
+        hx.push_back(boxShape.halfExtents.x); hy.push_back(boxShape.halfExtents.y); hz.push_back(boxShape.halfExtents.z);
+        radius.push_back(sphereRadius);
+        entries.push_back(Entry { contact, box, flip });
+    }
+
+    void Narrowphase::Update(Registry& registry, const std::vector<CollisionPair>& pairs) {
+        FP_PROFILE_FUNCTION();
+        updateCount++;
+        shapes.clear();
+        spheres.Clear();
+        boxSpheres.Clear();
+        candidates.resize(pairs.size());
+        touching.assign(pairs.size(), 0);
+        Pools pools { registry.Pool<Collider>(), registry.Pool<Bounds>(), registry.Pool<WorldTransform>() };
+        for (uint32_t i = 0; i < pairs.size(); i++) {
+            ContactManifold& manifold = candidates[i];
+            manifold.a = pairs[i].first;
+            manifold.b = pairs[i].second;
+            manifold.pointCount = 0;
+            uint32_t a = ShapeOf(pools, manifold.a);
+            uint32_t b = ShapeOf(pools, manifold.b);
+            manifold.trigger = shapes[a].trigger || shapes[b].trigger;
+            Dispatch(i, a, b);
+        }
+        TestSpheres();
+        TestBoxSpheres();
+
+        contacts.clear();
+        for (uint32_t i = 0; i < candidates.size(); i++) {
+            if (touching[i]) contacts.push_back(candidates[i]);
+        }
+        Solve(registry);
+    }
+
+    uint32_t Narrowphase::ShapeOf(Pools& pools, Entity entity) {
+        if (entity >= shapeOf.size()) {
+            shapeOf.resize(entity + 1);
+            shapeStamp.resize(entity + 1, 0);
+        }
+        if (shapeStamp[entity] == updateCount) return shapeOf[entity];
+
+        const Collider& collider = pools.colliders.Get(entity);
+        const Bounds& bounds = pools.bounds.Get(entity);
+        const WorldTransform& world = pools.worlds.Get(entity);
+        // the world matrix's columns are the box's axes, each as long as the scale along it
+        glm::mat3 rs(world.matrix);
+        Shape shape {};
+        shape.center = world.position + glm::dvec3(rs * bounds.center);
+        glm::vec3 scale(glm::length(rs[0]), glm::length(rs[1]), glm::length(rs[2]));
+        if (collider.shape != SHAPE_SPHERE) {
+            for (int i = 0; i < 3; i++)
+                shape.axes[i] = (scale[i] > 1e-12f) ? rs[i] / scale[i] : glm::vec3(i == 0, i == 1, i == 2);
+        }
+        glm::vec3 h = scale * bounds.halfExtents;
+        shape.halfExtents = h;
+        shape.type = collider.shape;
+        shape.trigger = collider.trigger;
+        switch (collider.shape) {
+            case SHAPE_SPHERE:
+                shape.radius = std::max(h.x, std::max(h.y, h.z));
+                shape.segmentHalf = 0.0f;
+                break;
+            case SHAPE_CAPSULE:
+                shape.radius = std::max(h.x, h.z);
+                shape.segmentHalf = std::max(h.y - shape.radius, 0.0f);
+                break;
+            case SHAPE_BOX:
+                shape.radius = glm::length(h);
+                shape.segmentHalf = 0.0f;
+                break;
+        }
+        shapeOf[entity] = static_cast<uint32_t>(shapes.size());
+        shapeStamp[entity] = updateCount;
+        shapes.push_back(shape);
+        return shapeOf[entity];
+    }
+
+    void Narrowphase::Dispatch(uint32_t contact, uint32_t a, uint32_t b) {
+        const Shape& sa = shapes[a];
+        const Shape& sb = shapes[b];
+        if (sa.type == SHAPE_BOX && sb.type == SHAPE_BOX) {
+            touching[contact] = TestBoxes(candidates[contact], sa, sb);
+            return;
+        }
+        if (sa.type == SHAPE_BOX || sb.type == SHAPE_BOX) {
+            // box first; a capsule stands in as the sphere around its point nearest the box's center
+            bool flip = (sb.type == SHAPE_BOX);
+            uint32_t box = flip ? b : a;
+            const Shape& other = flip ? sa : sb;
+            glm::dvec3 center = (other.type == SHAPE_CAPSULE)
+                    ? ClosestOnSegment(other.center, other.axes[1], other.segmentHalf, shapes[box].center)
+                    : other.center;
+            boxSpheres.Push(contact, box, shapes[box], center, other.radius, flip);
+            return;
+        }
+        // spheres and capsules: the nearest points of their cores, as spheres
+        glm::dvec3 ca = sa.center, cb = sb.center;
+        if (sa.type == SHAPE_CAPSULE && sb.type == SHAPE_CAPSULE) {
+            glm::dvec3 axisA = glm::dvec3(sa.axes[1]) * double(sa.segmentHalf);
+            glm::dvec3 axisB = glm::dvec3(sb.axes[1]) * double(sb.segmentHalf);
+            ClosestBetweenSegments(sa.center - axisA, 2.0 * axisA, sb.center - axisB, 2.0 * axisB, ca, cb);
+        } else if (sa.type == SHAPE_CAPSULE) {
+            ca = ClosestOnSegment(sa.center, sa.axes[1], sa.segmentHalf, cb);
+        } else if (sb.type == SHAPE_CAPSULE) {
+            cb = ClosestOnSegment(sb.center, sb.axes[1], sb.segmentHalf, ca);
+        }
+        spheres.Push(contact, ca, sa.radius, cb, sb.radius);
+    }
+
+    void Narrowphase::TestSpheres() {
+        size_t count = spheres.entries.size();
+        auto touch = [this](size_t i) {
+            const SphereBatch::Entry& entry = spheres.entries[i];
+            ContactManifold& manifold = candidates[entry.contact];
+            glm::vec3 d(spheres.dx[i], spheres.dy[i], spheres.dz[i]);
+            float distance = glm::length(d);
+            manifold.normal = (distance > 1e-6f) ? d / distance : glm::vec3(0.0, 1.0, 0.0);
+            manifold.depth = spheres.reach[i] - distance;
+            // halfway through the overlap
+            manifold.points[0] = entry.centerA + glm::dvec3(manifold.normal) * double(entry.radiusA - 0.5f * manifold.depth);
+            manifold.pointCount = 1;
+            touching[entry.contact] = 1;
+        };
+
+        size_t i = 0;
+#if defined(__AVX__) || defined(__SSE__)
+        typedef Lanes L;
+        for (; i + L::WIDTH <= count; i += L::WIDTH) {
+            L::Reg dx = L::Load(&spheres.dx[i]);
+            L::Reg dy = L::Load(&spheres.dy[i]);
+            L::Reg dz = L::Load(&spheres.dz[i]);
+            L::Reg reach = L::Load(&spheres.reach[i]);
+            L::Reg distanceSq = L::Add(L::Add(L::Mul(dx, dx), L::Mul(dy, dy)), L::Mul(dz, dz));
+            uint32_t hits = L::LessThan(distanceSq, L::Mul(reach, reach));
+            for (size_t lane = 0; hits != 0; lane++, hits >>= 1) {
+                if (hits & 1) touch(i + lane);
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            float distanceSq = spheres.dx[i] * spheres.dx[i] + spheres.dy[i] * spheres.dy[i] + spheres.dz[i] * spheres.dz[i];
+            if (distanceSq < spheres.reach[i] * spheres.reach[i]) touch(i);
+        }
+    }
+
+    void Narrowphase::TestBoxSpheres() {
+        size_t count = boxSpheres.entries.size();
+        auto touch = [this](size_t i) {
+            const BoxBatch::Entry& entry = boxSpheres.entries[i];
+            const Shape& box = shapes[entry.box];
+            ContactManifold& manifold = candidates[entry.contact];
+            glm::vec3 local = glm::transpose(box.axes) * glm::vec3(boxSpheres.px[i], boxSpheres.py[i], boxSpheres.pz[i]);
+            glm::vec3 h = box.halfExtents;
+            float radius = boxSpheres.radius[i];
+            glm::vec3 closest = glm::clamp(local, -h, h);
+            glm::vec3 out = local - closest;
+            float distanceSq = glm::dot(out, out);
+            glm::vec3 normal(0.0);
+            float depth;
+            if (distanceSq > 1e-12f) {
+                float distance = std::sqrt(distanceSq);
+                normal = out / distance;
+                depth = radius - distance;
+            } else {
+                // the center is inside the box: out through the nearest face
+                glm::vec3 gap = h - glm::abs(local);
+                int k = (gap.x < gap.y) ? ((gap.x < gap.z) ? 0 : 2) : ((gap.y < gap.z) ? 1 : 2);
+                normal[k] = (local[k] < 0.0f) ? -1.0f : 1.0f;
+                depth = radius + gap[k];
+                closest[k] = normal[k] * h[k];
+            }
+            glm::vec3 worldNormal = box.axes * normal;
+            manifold.normal = entry.flip ? -worldNormal : worldNormal;
+            manifold.depth = depth;
+            manifold.points[0] = box.center + glm::dvec3(box.axes * closest);
+            manifold.pointCount = 1;
+            touching[entry.contact] = 1;
+        };
+
+        const BoxBatch& b = boxSpheres;
+        size_t i = 0;
+#if defined(__AVX__) || defined(__SSE__)
+        typedef Lanes L;
+        for (; i + L::WIDTH <= count; i += L::WIDTH) {
+            L::Reg px = L::Load(&b.px[i]), py = L::Load(&b.py[i]), pz = L::Load(&b.pz[i]);
+            L::Reg hx = L::Load(&b.hx[i]), hy = L::Load(&b.hy[i]), hz = L::Load(&b.hz[i]);
+            L::Reg radius = L::Load(&b.radius[i]);
+            // into the box's frame, clamp to it, and measure what's left over
+            L::Reg lx = L::Add(L::Add(L::Mul(px, L::Load(&b.axes[0][i])), L::Mul(py, L::Load(&b.axes[1][i]))), L::Mul(pz, L::Load(&b.axes[2][i])));
+            L::Reg ly = L::Add(L::Add(L::Mul(px, L::Load(&b.axes[3][i])), L::Mul(py, L::Load(&b.axes[4][i]))), L::Mul(pz, L::Load(&b.axes[5][i])));
+            L::Reg lz = L::Add(L::Add(L::Mul(px, L::Load(&b.axes[6][i])), L::Mul(py, L::Load(&b.axes[7][i]))), L::Mul(pz, L::Load(&b.axes[8][i])));
+            L::Reg ex = L::Sub(lx, L::Min(L::Max(lx, L::Neg(hx)), hx));
+            L::Reg ey = L::Sub(ly, L::Min(L::Max(ly, L::Neg(hy)), hy));
+            L::Reg ez = L::Sub(lz, L::Min(L::Max(lz, L::Neg(hz)), hz));
+            L::Reg distanceSq = L::Add(L::Add(L::Mul(ex, ex), L::Mul(ey, ey)), L::Mul(ez, ez));
+            uint32_t hits = L::LessThan(distanceSq, L::Mul(radius, radius));
+            for (size_t lane = 0; hits != 0; lane++, hits >>= 1) {
+                if (hits & 1) touch(i + lane);
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            glm::vec3 p(b.px[i], b.py[i], b.pz[i]);
+            glm::vec3 local(p.x * b.axes[0][i] + p.y * b.axes[1][i] + p.z * b.axes[2][i],
+                            p.x * b.axes[3][i] + p.y * b.axes[4][i] + p.z * b.axes[5][i],
+                            p.x * b.axes[6][i] + p.y * b.axes[7][i] + p.z * b.axes[8][i]);
+            glm::vec3 h(b.hx[i], b.hy[i], b.hz[i]);
+            glm::vec3 out = local - glm::clamp(local, -h, h);
+            if (glm::dot(out, out) < b.radius[i] * b.radius[i]) touch(i);
+        }
+    }
+
+    bool Narrowphase::TestBoxes(ContactManifold& manifold, const Shape& a, const Shape& b) const {
+        // separating axis test, in a's frame of reference: the boxes are apart if their shadows on any face
+        // normal of either, or on any cross product of an edge of each, don't overlap; if none separates, the
+        // one they overlap the least on is the way out
+        glm::vec3 d(b.center - a.center);
+        const glm::vec3& ha = a.halfExtents;
+        const glm::vec3& hb = b.halfExtents;
+        float bestOverlap = std::numeric_limits<float>::max();
+        glm::vec3 bestAxis(0.0, 1.0, 0.0);
+        auto test = [&](glm::vec3 axis, bool edge) {
+            if (edge) {
+                float length = glm::length(axis);
+                if (length < 1e-5f) return true;    // parallel edges: the face axes have it covered
+                axis /= length;
+            }
+            float ra = ha.x * std::abs(glm::dot(a.axes[0], axis)) + ha.y * std::abs(glm::dot(a.axes[1], axis)) + ha.z * std::abs(glm::dot(a.axes[2], axis));
+            float rb = hb.x * std::abs(glm::dot(b.axes[0], axis)) + hb.y * std::abs(glm::dot(b.axes[1], axis)) + hb.z * std::abs(glm::dot(b.axes[2], axis));
+            float distance = glm::dot(d, axis);
+            float overlap = ra + rb - std::abs(distance);
+            if (overlap < 0.0f) return false;
+            // edge axes must do clearly better than a face to win, for steadier contacts
+            if (overlap < (edge ? 0.95f * bestOverlap - 1e-4f : bestOverlap)) {
+                bestOverlap = overlap;
+                bestAxis = (distance < 0.0f) ? -axis : axis;
+            }
+            return true;
+        };
+        for (int i = 0; i < 3; i++) {
+            if (!test(a.axes[i], false)) return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (!test(b.axes[i], false)) return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                if (!test(glm::cross(a.axes[i], b.axes[j]), true)) return false;
+            }
+        }
+
+        manifold.normal = bestAxis;
+        manifold.depth = bestOverlap;
+        // contact points: the corners of each box that are inside the other's extent along the normal, deepest first
+        glm::vec3 n = bestAxis;
+        float supportA = ha.x * std::abs(glm::dot(a.axes[0], n)) + ha.y * std::abs(glm::dot(a.axes[1], n)) + ha.z * std::abs(glm::dot(a.axes[2], n));
+        float supportB = hb.x * std::abs(glm::dot(b.axes[0], n)) + hb.y * std::abs(glm::dot(b.axes[1], n)) + hb.z * std::abs(glm::dot(b.axes[2], n));
+        std::pair<float, glm::vec3> corners[16];
+        size_t found = 0;
+        for (int c = 0; c < 8; c++) {
+            glm::vec3 sign((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+            glm::vec3 cornerB = d + b.axes * (sign * hb);
+            float inA = supportA - glm::dot(cornerB, n);
+            if (inA > 0.0f) corners[found++] = { inA, cornerB };
+            glm::vec3 cornerA = a.axes * (sign * ha);
+            float inB = supportB + glm::dot(cornerA - d, n);
+            if (inB > 0.0f) corners[found++] = { inB, cornerA };
+        }
+        if (found == 0) {
+            // edge against edge, no corner inside: midway through the overlap, on the line between centers
+            manifold.points[0] = a.center + glm::dvec3(n * (supportA - 0.5f * bestOverlap));
+            manifold.pointCount = 1;
+            return true;
+        }
+        size_t kept = std::min<size_t>(found, 4);
+        std::partial_sort(corners, corners + kept, corners + found, [](const auto& x, const auto& y) { return x.first > y.first; });
+        for (size_t i = 0; i < kept; i++)
+            manifold.points[i] = a.center + glm::dvec3(corners[i].second);
+        manifold.pointCount = static_cast<uint8_t>(kept);
+        return true;
+    }
+
+    /** The world offset \c offset, in the frame of \c parent (a \c Transform's), if there is one. */
+    static glm::dvec3 ToParentFrame(const WorldTransform* parent, const glm::dvec3& offset) {
+        if (parent == nullptr) return offset;
+        // children sit at parent position + (parent rotation and scale) * local position
+        return glm::inverse(glm::dmat3(glm::mat3(parent->matrix))) * offset;
+    }
+
+    void Narrowphase::Solve(Registry& registry) {
+        ComponentPool<PhysicsBody>& bodies = registry.Pool<PhysicsBody>();
+        ComponentPool<Velocity>& velocities = registry.Pool<Velocity>();
+        ComponentPool<Hierarchy>& hierarchy = registry.Pool<Hierarchy>();
+        ComponentPool<WorldTransform>& worlds = registry.Pool<WorldTransform>();
+        auto parentOf = [&](Entity entity) -> const WorldTransform* {
+            const Hierarchy* node = hierarchy.TryGet(entity);
+            return (node != nullptr) ? worlds.TryGet(node->parent) : nullptr;
+        };
+        constraints.clear();
+        for (uint32_t i = 0; i < contacts.size(); i++) {
+            const ContactManifold& manifold = contacts[i];
+            if (manifold.trigger) continue;
+            // only bodies get pushed; anything else acts as if infinitely heavy
+            PhysicsBody* bodyA = bodies.TryGet(manifold.a);
+            PhysicsBody* bodyB = bodies.TryGet(manifold.b);
+            Velocity* va = bodyA ? velocities.TryGet(manifold.a) : nullptr;
+            Velocity* vb = bodyB ? velocities.TryGet(manifold.b) : nullptr;
+            float invA = va ? bodyA->inverseMass : 0.0f;
+            float invB = vb ? bodyB->inverseMass : 0.0f;
+            if (invA + invB <= 0.0f) continue;
+
+            const Collider& colliderA = registry.Get<Collider>(manifold.a);
+            const Collider& colliderB = registry.Get<Collider>(manifold.b);
+            Constraint constraint {};
+            constraint.ta = &registry.Get<Transform>(manifold.a);
+            constraint.tb = &registry.Get<Transform>(manifold.b);
+            constraint.wa = &registry.Get<WorldTransform>(manifold.a);
+            constraint.wb = &registry.Get<WorldTransform>(manifold.b);
+            constraint.pa = parentOf(manifold.a);
+            constraint.pb = parentOf(manifold.b);
+            constraint.va = va;
+            constraint.vb = vb;
+            constraint.invA = invA;
+            constraint.invB = invB;
+            constraint.restitution = std::max(colliderA.restitution, colliderB.restitution);
+            constraint.friction = std::sqrt(colliderA.friction * colliderB.friction);
+            constraint.contact = i;
+            // bounce off what they came in with, not what the first solver passes leave
+            glm::vec3 relative = (vb ? vb->linear : glm::vec3(0.0)) - (va ? va->linear : glm::vec3(0.0));
+            float approach = glm::dot(relative, manifold.normal);
+            constraint.targetSpeed = (approach < -RESTING_SPEED) ? -constraint.restitution * approach : 0.0f;
+            glm::vec3 tangent = relative - manifold.normal * approach;
+            float tangentLength = glm::length(tangent);
+            constraint.tangent = (tangentLength > 1e-6f) ? tangent / tangentLength : glm::vec3(0.0);
+            constraints.push_back(constraint);
+        }
+
+        // sequential impulses: each pass nudges every contact's velocities towards what it wants, with the
+        // totals clamped (no pulling together, friction within its cone) so later passes can take some back
+        auto apply = [](Constraint& c, const glm::vec3& impulse) {
+            if (c.va) c.va->linear -= impulse * c.invA;
+            if (c.vb) c.vb->linear += impulse * c.invB;
+        };
+        for (int pass = 0; pass < iterations; pass++) {
+            for (Constraint& c : constraints) {
+                const glm::vec3& normal = contacts[c.contact].normal;
+                float mass = 1.0f / (c.invA + c.invB);
+                glm::vec3 relative = (c.vb ? c.vb->linear : glm::vec3(0.0)) - (c.va ? c.va->linear : glm::vec3(0.0));
+                float total = std::max(c.normalImpulse + (c.targetSpeed - glm::dot(relative, normal)) * mass, 0.0f);
+                float step = total - c.normalImpulse;
+                c.normalImpulse = total;
+                apply(c, normal * step);
+
+                relative = (c.vb ? c.vb->linear : glm::vec3(0.0)) - (c.va ? c.va->linear : glm::vec3(0.0));
+                float limit = c.friction * c.normalImpulse;
+                total = glm::clamp(c.tangentImpulse - glm::dot(relative, c.tangent) * mass, -limit, limit);
+                step = total - c.tangentImpulse;
+                c.tangentImpulse = total;
+                apply(c, c.tangent * step);
+            }
+        }
+
+        // whatever the velocities don't undo, move apart directly, heavier bodies less
+        for (Constraint& c : constraints) {
+            const ContactManifold& manifold = contacts[c.contact];
+            float push = std::max(manifold.depth - slop, 0.0f) * correction / (c.invA + c.invB);
+            if (push <= 0.0f) continue;
+            glm::dvec3 offset = glm::dvec3(manifold.normal) * double(push);
+            if (c.invA > 0.0f) {
+                c.ta->pos -= ToParentFrame(c.pa, offset * double(c.invA));
+                c.wa->dirty = true;
+            }
+            if (c.invB > 0.0f) {
+                c.tb->pos += ToParentFrame(c.pb, offset * double(c.invB));
+                c.wb->dirty = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,189 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/PhysicsWorld.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace kVox::ecs {
+    /** How many bodies a worker takes per job; kicks and drifts are a few instructions each. */
+    static constexpr size_t BODIES_PER_JOB = 1024;
+
+    /** Velocities this close to zero don't move anything. */
+    static bool IsAtRest(const glm::vec3& vel) {
+        return glm::abs(vel.x) <= 0.01f && glm::abs(vel.y) <= 0.01f && glm::abs(vel.z) <= 0.01f;
+    }
+
+    /** out[i] += in[i] * scale, for i in [begin, end). */
+    static void MultiplyAdd(double* out, const double* in, double scale, size_t begin, size_t end) {
+        size_t i = begin;
+#if defined(__AVX__)
+        __m256d s = _mm256_set1_pd(scale);
+        for (; i + 4 <= end; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(out + i), _mm256_mul_pd(_mm256_loadu_pd(in + i), s)));
+#elif defined(__SSE2__)
+        __m128d s = _mm_set1_pd(scale);
+        for (; i + 2 <= end; i += 2)
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(_mm_loadu_pd(in + i), s)));
+#endif
+        for (; i < end; i++)
+            out[i] += in[i] * scale;
+    }
+
+    void PhysicsWorld::Step(Registry& registry, JobSystem& jobs, Gravity& gravity, double deltaTime) {
+        FP_PROFILE_FUNCTION();
+        Gather(registry);
+        if (links.empty()) {
+            substeps = 0;
+            return;
+        }
+        size_t sources = attractorCount + pulledCount;
+        bool pulled = (pulledCount > 0) && (sources > 1);
+        auto pull = [&]() {
+            gravity.ComputeAccelerations(jobs, sources, x.data(), y.data(), z.data(), mass.data(),
+                                         ax.data(), ay.data(), az.data());
+        };
+
+        // as many equal substeps as the strongest pull right now calls for
+        substeps = 1;
+        if (pulled) {
+            // the last step ended with this very pull, unless something has moved the bodies since
+            if (!SourcesUnchanged(gravity, sources))
+                pull();
+            double strongest = StrongestPull();
+            if (strongest > 0.0 && gravity.softening > 0.0) {
+                double limit = accuracy * std::sqrt(gravity.softening / strongest);
+                substeps = static_cast<int>(std::clamp(std::ceil(deltaTime / limit), 1.0, double(maxSubsteps)));
+            }
+        }
+        double h = deltaTime / substeps;
+        for (int step = 0; step < substeps; step++) {
+            if (pulled) Kick(jobs, 0.5 * h);
+            Drift(jobs, h);
+            if (pulled) {
+                pull();
+                Kick(jobs, 0.5 * h);
+            }
+        }
+        if (pulled) {
+            lastX.assign(x.begin(), x.begin() + sources);
+            lastY.assign(y.begin(), y.begin() + sources);
+            lastZ.assign(z.begin(), z.begin() + sources);
+            lastMass.assign(mass.begin(), mass.end());
+            lastSettings = SettingsOf(gravity);
+        } else {
+            lastMass.clear();
+        }
+        WriteBack(jobs);
+    }
+
+    void PhysicsWorld::Gather(Registry& registry) {
+        FP_PROFILE_FUNCTION();
+        x.clear(); y.clear(); z.clear();
+        vx.clear(); vy.clear(); vz.clear();
+        mass.clear();
+        links.clear();
+        ComponentPool<PhysicsBody>& physics = registry.Pool<PhysicsBody>();
+        ComponentPool<GravityBody>& gravityBodies = registry.Pool<GravityBody>();
+        ComponentPool<Hierarchy>& hierarchy = registry.Pool<Hierarchy>();
+        ComponentPool<WorldTransform>& worlds = registry.Pool<WorldTransform>();
+        auto push = [this](const glm::dvec3& pos, const glm::vec3& vel) {
+            x.push_back(pos.x); y.push_back(pos.y); z.push_back(pos.z);
+            vx.push_back(vel.x); vy.push_back(vel.y); vz.push_back(vel.z);
+        };
+
+        // attractors, where they were last resolved
+        auto massive = registry.View<GravityBody, WorldTransform>();
+        massive.Each([&](Entity entity, GravityBody& body, WorldTransform& world) {
+            if (physics.Has(entity)) return;
+            push(world.position, glm::vec3(0.0));
+            mass.push_back(body.mass);
+        });
+        attractorCount = x.size();
+
+        // then the bodies gravity pulls, then the ones it doesn't; positions are taken as (local) transform
+        // plus the parent's world position, so children are pulled from about where they are
+        auto bodies = registry.View<PhysicsBody, Velocity, Transform, WorldTransform>();
+        for (bool gravitating : { true, false }) {
+            bodies.Each([&](Entity entity, PhysicsBody&, Velocity& vel, Transform& t, WorldTransform& world) {
+                GravityBody* body = gravityBodies.TryGet(entity);
+                if ((body != nullptr) != gravitating) return;
+                if (!gravitating && IsAtRest(vel.linear)) return;
+                Hierarchy* node = hierarchy.TryGet(entity);
+                WorldTransform* parent = (node != nullptr) ? worlds.TryGet(node->parent) : nullptr;
+                glm::dvec3 origin = (parent != nullptr) ? parent->position : glm::dvec3(0.0);
+                push(t.pos + origin, vel.linear);
+                if (gravitating) mass.push_back(body->mass);
+                links.push_back({ &t, &vel, &world, origin });
+            });
+            if (gravitating) pulledCount = x.size() - attractorCount;
+        }
+
+        // (left as they were: they may still be good, see SourcesUnchanged)
+        size_t count = x.size();
+        ax.resize(count); ay.resize(count); az.resize(count);
+    }
+
+    PhysicsWorld::GravitySettings PhysicsWorld::SettingsOf(const Gravity& gravity) {
+        return { gravity.mode, gravity.exactLimit, gravity.theta, gravity.constant, gravity.softening };
+    }
+
+    bool PhysicsWorld::SourcesUnchanged(const Gravity& gravity, size_t sources) const {
+        return lastMass.size() == sources
+               && SettingsOf(gravity) == lastSettings
+               && std::equal(mass.begin(), mass.end(), lastMass.begin())
+               && std::equal(x.begin(), x.begin() + sources, lastX.begin())
+               && std::equal(y.begin(), y.begin() + sources, lastY.begin())
+               && std::equal(z.begin(), z.begin() + sources, lastZ.begin());
+    }
+
+    double PhysicsWorld::StrongestPull() const {
+        double strongest = 0.0;
+        for (size_t i = attractorCount; i < attractorCount + pulledCount; i++)
+            strongest = std::max(strongest, ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+        return std::sqrt(strongest);
+    }
+
+    void PhysicsWorld::Kick(JobSystem& jobs, double h) {
+        size_t first = attractorCount;
+        jobs.ParallelFor(pulledCount, BODIES_PER_JOB, [this, first, h](size_t begin, size_t end) {
+            MultiplyAdd(vx.data(), ax.data(), h, first + begin, first + end);
+            MultiplyAdd(vy.data(), ay.data(), h, first + begin, first + end);
+            MultiplyAdd(vz.data(), az.data(), h, first + begin, first + end);
+        });
+    }
+
+    void PhysicsWorld::Drift(JobSystem& jobs, double h) {
+        size_t first = attractorCount;
+        jobs.ParallelFor(links.size(), BODIES_PER_JOB, [this, first, h](size_t begin, size_t end) {
+            MultiplyAdd(x.data(), vx.data(), h, first + begin, first + end);
+            MultiplyAdd(y.data(), vy.data(), h, first + begin, first + end);
+            MultiplyAdd(z.data(), vz.data(), h, first + begin, first + end);
+        });
+    }
+
+    void PhysicsWorld::WriteBack(JobSystem& jobs) {
+        FP_PROFILE_FUNCTION();
+        size_t first = attractorCount;
+        jobs.ParallelFor(links.size(), BODIES_PER_JOB, [this, first](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Link& link = links[i];
+                size_t b = first + i;
+                glm::dvec3 pos = glm::dvec3(x[b], y[b], z[b]) - link.origin;
+                link.velocity->linear = glm::vec3(vx[b], vy[b], vz[b]);
+                if (pos == link.transform->pos) continue;
+                link.transform->pos = pos;
+                link.world->dirty = true;
+            }
+        });
+    }
+}
@@ -0,0 +1,44 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/Registry.h>
+#include <atomic>
+
+namespace kVox::ecs {
+
+    size_t NextComponentTypeId() {
+        static std::atomic<size_t> next {0};
+        return next++;
+    }
+
+    Entity Registry::Create() {
+        Entity entity;
+        if (!freeIds.empty()) {
+            entity = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            entity = static_cast<Entity>(alive.size());
+            alive.push_back(false);
+        }
+        alive[entity] = true;
+        aliveCount++;
+        return entity;
+    }
+
+    void Registry::Destroy(Entity entity) {
+        if (!Valid(entity)) return;
+        for (const auto& pool : pools) {
+            if (pool) pool->Remove(entity);
+        }
+        alive[entity] = false;
+        freeIds.push_back(entity);
+        aliveCount--;
+    }
+
+    bool Registry::Valid(Entity entity) const {
+        return entity < alive.size() && alive[entity];
+    }
+
+    size_t Registry::Alive() const { return aliveCount; }
+}
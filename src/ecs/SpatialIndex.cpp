@@ -0,0 +1,297 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/SpatialIndex.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+namespace kVox::ecs {
+
+    Aabb WorldBounds(const Bounds& bounds, const WorldTransform& world) {
+        // the box turned and scaled by the world matrix, then boxed again: each half extent of the result is
+        // the sum of the rotated half extents' magnitudes along that axis
+        glm::mat3 rs(world.matrix);
+        glm::mat3 absRs(glm::abs(rs[0]), glm::abs(rs[1]), glm::abs(rs[2]));
+        glm::vec3 center = glm::vec3(world.position) + rs * bounds.center;
+        glm::vec3 half = absRs * bounds.halfExtents;
+        return Aabb { center - half, center + half };
+    }
+
+    /** Node stack for walking the tree, on the caller's stack unless the tree is unusually deep. */
+    class NodeStack {
+    public:
+        void Push(int32_t node) {
+            if (size < INLINE) inlineNodes[size] = node;
+            else spill.push_back(node);
+            size++;
+        }
+        int32_t Pop() {
+            size--;
+            if (size < INLINE) return inlineNodes[size];
+            int32_t node = spill.back();
+            spill.pop_back();
+            return node;
+        }
+        bool Empty() const { return size == 0; }
+
+    private:
+        static constexpr size_t INLINE = 128;
+        int32_t inlineNodes[INLINE];
+        std::vector<int32_t> spill;
+        size_t size = 0;
+    };
+
+    template<typename Test, typename Visit>
+    void SpatialIndex::Walk(Test&& test, Visit&& visit) const {
+        if (root == NONE) return;
+        NodeStack stack;
+        stack.Push(root);
+        while (!stack.Empty()) {
+            const Node& node = nodes[stack.Pop()];
+            if (!test(node.box)) continue;
+            if (node.IsLeaf()) {
+                visit(node.entity);
+            } else {
+                stack.Push(node.left);
+                stack.Push(node.right);
+            }
+        }
+    }
+
+    void SpatialIndex::Update(Registry& registry) {
+        FP_PROFILE_FUNCTION();
+        // bounds are the minority, so they drive the query
+        auto bounded = registry.View<Bounds, WorldTransform>();
+        glm::vec3 grow(margin);
+        bounded.Each([&](Entity entity, Bounds& bounds, WorldTransform& world) {
+            // (not \c changed: that only covers the latest resolve, and frames resolve between ticks too)
+            if (bounds.proxy != NONE && !world.moved) return;
+            world.moved = false;
+            Aabb box = WorldBounds(bounds, world);
+            if (bounds.proxy != NONE) {
+                // still inside its fat box: nothing to do, which is the common case for slow movers
+                if (nodes[bounds.proxy].box.Contains(box)) return;
+                RemoveLeaf(bounds.proxy);
+            } else {
+                bounds.proxy = AllocateNode();
+                leafCount++;
+            }
+            Node& leaf = nodes[bounds.proxy];
+            leaf.box = Aabb { box.min - grow, box.max + grow };
+            leaf.entity = entity;
+            InsertLeaf(bounds.proxy);
+        });
+    }
+
+    void SpatialIndex::Remove(Bounds& bounds) {
+        if (bounds.proxy == NONE) return;
+        RemoveLeaf(bounds.proxy);
+        FreeNode(bounds.proxy);
+        leafCount--;
+        bounds.proxy = NONE;
+    }
+
+    int32_t SpatialIndex::AllocateNode() {
+        int32_t node;
+        if (freeList != NONE) {
+            node = freeList;
+            freeList = nodes[node].left;
+        } else {
+            node = static_cast<int32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[node] = Node();
+        return node;
+    }
+
+    void SpatialIndex::FreeNode(int32_t node) {
+        nodes[node].left = freeList;
+        nodes[node].height = NONE;
+        freeList = node;
+    }
+
+    void SpatialIndex::InsertLeaf(int32_t leaf) {
+        if (root == NONE) {
+            root = leaf;
+            nodes[leaf].parent = NONE;
+            return;
+        }
+        // walk down to the sibling that makes the tree grow the least (surface area heuristic): a branch
+        // costs what its box grows by, plus what every box above it grows by on the way
+        Aabb leafBox = nodes[leaf].box;
+        int32_t index = root;
+        while (!nodes[index].IsLeaf()) {
+            const Node& node = nodes[index];
+            float combined = Aabb::Union(node.box, leafBox).HalfArea();
+            float cost = 2.0f * combined;
+            float inherited = 2.0f * (combined - node.box.HalfArea());
+            auto descendCost = [&](int32_t child) {
+                const Aabb& box = nodes[child].box;
+                float grown = Aabb::Union(box, leafBox).HalfArea();
+                return (nodes[child].IsLeaf() ? grown : grown - box.HalfArea()) + inherited;
+            };
+            float leftCost = descendCost(node.left);
+            float rightCost = descendCost(node.right);
+            if (cost < leftCost && cost < rightCost) break;
+            index = (leftCost < rightCost) ? node.left : node.right;
+        }
+
+        // pair the leaf up with it under a new parent
+        int32_t sibling = index;
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = AllocateNode();
+        Node& parent = nodes[newParent];
+        parent.parent = oldParent;
+        parent.box = Aabb::Union(leafBox, nodes[sibling].box);
+        parent.height = nodes[sibling].height + 1;
+        parent.left = sibling;
+        parent.right = leaf;
+        if (oldParent != NONE) {
+            if (nodes[oldParent].left == sibling) nodes[oldParent].left = newParent;
+            else nodes[oldParent].right = newParent;
+        } else {
+            root = newParent;
+        }
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        Refit(nodes[leaf].parent);
+    }
+
+    void SpatialIndex::RemoveLeaf(int32_t leaf) {
+        if (leaf == root) {
+            root = NONE;
+            return;
+        }
+        // the leaf's parent goes too, and its sibling takes the parent's place
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+        if (grandParent != NONE) {
+            if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+            else nodes[grandParent].right = sibling;
+            nodes[sibling].parent = grandParent;
+            FreeNode(parent);
+            Refit(grandParent);
+        } else {
+            root = sibling;
+            nodes[sibling].parent = NONE;
+            FreeNode(parent);
+        }
+        nodes[leaf].parent = NONE;
+    }
+
+    void SpatialIndex::Refit(int32_t index) {
+        while (index != NONE) {
+            index = Balance(index);
+            Node& node = nodes[index];
+            node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+            node.box = Aabb::Union(nodes[node.left].box, nodes[node.right].box);
+            index = node.parent;
+        }
+    }
+
+    int32_t SpatialIndex::Balance(int32_t iA) {
+        Node& a = nodes[iA];
+        if (a.IsLeaf() || a.height < 2) return iA;
+        int32_t iB = a.left, iC = a.right;
+        Node& b = nodes[iB];
+        Node& c = nodes[iC];
+        int32_t balance = c.height - b.height;
+
+        // lifts child 'up' (one of B/C) into A's place; A keeps the other child plus the shorter of up's children
+        auto rotate = [&](int32_t iUp, Node& up, Node& other, bool upIsRight) {
+            int32_t iF = up.left, iG = up.right;
+            Node& f = nodes[iF];
+            Node& g = nodes[iG];
+            up.left = iA;
+            up.parent = a.parent;
+            a.parent = iUp;
+            if (up.parent != NONE) {
+                if (nodes[up.parent].left == iA) nodes[up.parent].left = iUp;
+                else nodes[up.parent].right = iUp;
+            } else {
+                root = iUp;
+            }
+            // the taller of up's children stays with it
+            int32_t iKeep = (f.height > g.height) ? iF : iG;
+            int32_t iGive = (f.height > g.height) ? iG : iF;
+            up.right = iKeep;
+            if (upIsRight) a.right = iGive;
+            else a.left = iGive;
+            nodes[iGive].parent = iA;
+            a.box = Aabb::Union(other.box, nodes[iGive].box);
+            up.box = Aabb::Union(a.box, nodes[iKeep].box);
+            a.height = 1 + std::max(other.height, nodes[iGive].height);
+            up.height = 1 + std::max(a.height, nodes[iKeep].height);
+            return iUp;
+        };
+        if (balance > 1) return rotate(iC, c, b, true);
+        if (balance < -1) return rotate(iB, b, c, false);
+        return iA;
+    }
+
+    void SpatialIndex::QueryAabb(const Aabb& box, std::vector<Entity>& out) const {
+        Walk([&box](const Aabb& nodeBox) { return nodeBox.Overlaps(box); },
+             [&out](Entity entity) { out.push_back(entity); });
+    }
+
+    void SpatialIndex::QueryRadius(const glm::vec3& center, float radius, std::vector<Entity>& out) const {
+        float radiusSq = radius * radius;
+        Walk([&](const Aabb& nodeBox) { return nodeBox.DistanceSq(center) <= radiusSq; },
+             [&out](Entity entity) { out.push_back(entity); });
+    }
+
+    void SpatialIndex::QueryFrustum(const glm::mat4& viewProjMtx, std::vector<Entity>& out) const {
+        // the six clip planes, straight from the matrix's rows (w +- x, w +- y, w +- z)
+        glm::mat4 rows = glm::transpose(viewProjMtx);
+        glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                                rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+        Walk([&planes](const Aabb& nodeBox) {
+                 for (const glm::vec4& plane : planes) {
+                     // the box corner furthest along the plane's normal; if even that's behind, all of it is
+                     glm::vec3 normal(plane);
+                     glm::vec3 corner = glm::mix(nodeBox.min, nodeBox.max, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.0))));
+                     if (glm::dot(normal, corner) + plane.w < 0.0f) return false;
+                 }
+                 return true;
+             },
+             [&out](Entity entity) { out.push_back(entity); });
+    }
+
+    void SpatialIndex::QueryNearest(const glm::vec3& point, size_t k, std::vector<Entity>& out) const {
+        out.clear();
+        if (root == NONE || k == 0) return;
+        // best-first: nodes come off the queue closest box first, so once the k-th best found is closer than
+        // the next box, nothing left can beat it
+        using Candidate = std::pair<float, int32_t>;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> open;
+        std::priority_queue<std::pair<float, Entity>> best;     // worst of the best on top
+        open.emplace(nodes[root].box.DistanceSq(point), root);
+        while (!open.empty()) {
+            auto [distance, index] = open.top();
+            open.pop();
+            if (best.size() == k && distance >= best.top().first) break;
+            const Node& node = nodes[index];
+            if (node.IsLeaf()) {
+                best.emplace(distance, node.entity);
+                if (best.size() > k) best.pop();
+                continue;
+            }
+            open.emplace(nodes[node.left].box.DistanceSq(point), node.left);
+            open.emplace(nodes[node.right].box.DistanceSq(point), node.right);
+        }
+        out.resize(best.size());
+        for (size_t i = best.size(); i > 0; i--) {
+            out[i - 1] = best.top().second;
+            best.pop();
+        }
+    }
+
+    int32_t SpatialIndex::Height() const {
+        return (root == NONE) ? 0 : nodes[root].height + 1;
+    }
+}
@@ -0,0 +1,42 @@
+//
+// Created by snaki on 12/21/2020.
+//
+
+#include <ecs/Systems.h>
+#include <renderer/Renderer.h>
+#include <util/Profiler.h>
+
+namespace kVox::ecs {
+    /** How many components a worker takes per job; the loops are tiny, so ranges are large. */
+    static constexpr size_t COMPONENTS_PER_JOB = 256;
+
+    void StoreTickState(Registry& registry, JobSystem& jobs) {
+        FP_PROFILE_FUNCTION();
+        ComponentPool<Transform>& transforms = registry.Pool<Transform>();
+        Transform* t = transforms.Data();
+        jobs.ParallelFor(transforms.Size(), COMPONENTS_PER_JOB, [t](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                t[i].prevPos = t[i].pos;
+            }
+        });
+        ComponentPool<Renderable>& renderables = registry.Pool<Renderable>();
+        Renderable* r = renderables.Data();
+        jobs.ParallelFor(renderables.Size(), COMPONENTS_PER_JOB, [r](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (r[i].vao != nullptr)
+                    r[i].vao->StorePrevModelMtx();
+            }
+        });
+    }
+
+    void InterpolateTransforms(Registry& registry, JobSystem& jobs, double alpha) {
+        FP_PROFILE_FUNCTION();
+        ComponentPool<Transform>& transforms = registry.Pool<Transform>();
+        Transform* t = transforms.Data();
+        jobs.ParallelFor(transforms.Size(), COMPONENTS_PER_JOB, [t, alpha](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                t[i].renderPos = glm::mix(t[i].prevPos, t[i].pos, alpha);
+            }
+        });
+    }
+}
@@ -0,0 +1,180 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <ecs/TransformHierarchy.h>
+#include <renderer/Renderer.h>
+#include <util/MatrixBatch.h>
+#include <util/Profiler.h>
+
+#include <algorithm>
+
+namespace kVox::ecs {
+    /** How many nodes of one level a worker takes per job. */
+    static constexpr size_t NODES_PER_JOB = 512;
+
+    glm::mat4 ComposeLocalMatrix(const Transform& transform) {
+        // rotate * scale * scale (the scale has always been applied twice), without the full matrix products:
+        // scale the rotation's columns. The position is kept apart, in double (see \c WorldTransform)
+        glm::mat3 rot = glm::mat3_cast(glm::quat(transform.rot));
+        glm::vec3 scale = transform.scale * transform.scale;
+        glm::mat4 modelMtx(1.0);
+        modelMtx[0] = glm::vec4(rot[0] * scale.x, 0.0);
+        modelMtx[1] = glm::vec4(rot[1] * scale.y, 0.0);
+        modelMtx[2] = glm::vec4(rot[2] * scale.z, 0.0);
+        return modelMtx;
+    }
+
+    /** Finishes a node whose world matrix was just rebuilt. */
+    static void Publish(WorldTransform& world, Renderable& renderable, const glm::mat4& matrix) {
+        world.matrix = matrix;
+        world.dirty = false;
+        world.moved = true;
+        if (renderable.vao != nullptr)
+            renderable.vao->SetModelMtx(matrix, world.position);
+    }
+
+    /** Resolves nodes [begin, end) of one level; their parents are all final already. */
+    static void ResolveRange(Transform* t, WorldTransform* w, Renderable* r, const uint32_t* parents,
+                             uint32_t noParent, size_t begin, size_t end) {
+        // children to multiply out in one batch, gathered as (parent world, local) pairs
+        thread_local std::vector<uint32_t> pending;
+        thread_local std::vector<glm::mat4> lhs, locals, results;
+        pending.clear();
+        lhs.clear();
+        locals.clear();
+        for (size_t i = begin; i < end; i++) {
+            WorldTransform& world = w[i];
+            uint32_t p = parents[i];
+            if (p != noParent && w[p].changed)
+                world.dirty = true;
+            world.changed = world.dirty;
+            if (!world.dirty) continue;
+            if (p == noParent) {
+                world.position = t[i].pos;
+                Publish(world, r[i], ComposeLocalMatrix(t[i]));
+                continue;
+            }
+            // children inherit their parent's placement and heading
+            world.position = w[p].position + glm::dmat3(glm::mat3(w[p].matrix)) * t[i].pos;
+            world.inheritedPos = t[p].pos + glm::dvec3(glm::vec4(glm::vec3(t[i].pos),1.0) * w[p].matrix);
+            world.inheritedRot = t[p].rot;
+            world.inheritedScale = t[p].scale;
+            world.orient = w[p].orient;
+            pending.push_back(static_cast<uint32_t>(i));
+            lhs.push_back(w[p].matrix);
+            locals.push_back(ComposeLocalMatrix(t[i]));
+        }
+        if (pending.empty()) return;
+        results.resize(pending.size());
+        util::MultiplyMatrices(lhs.data(), locals.data(), results.data(), pending.size());
+        for (size_t k = 0; k < pending.size(); k++) {
+            uint32_t i = pending[k];
+            Publish(w[i], r[i], results[k]);
+        }
+    }
+
+    void TransformHierarchy::Resolve(Registry& registry, JobSystem& jobs) {
+        FP_PROFILE_FUNCTION();
+        if (IsStale(registry))
+            Rebuild(registry);
+        Transform* t = registry.Pool<Transform>().Data();
+        WorldTransform* w = registry.Pool<WorldTransform>().Data();
+        Renderable* r = registry.Pool<Renderable>().Data();
+        const uint32_t* p = parents.data();
+        // one level at a time, so every parent is final before its children
+        for (size_t level = 0; level + 1 < levelStarts.size(); level++) {
+            size_t first = levelStarts[level];
+            jobs.ParallelFor(levelStarts[level + 1] - first, NODES_PER_JOB, [=](size_t begin, size_t end) {
+                ResolveRange(t, w, r, p, NO_PARENT, first + begin, first + end);
+            });
+        }
+    }
+
+    bool TransformHierarchy::IsStale(Registry& registry) const {
+        return registry.Pool<Hierarchy>().Version() != versions[0]
+            || registry.Pool<Transform>().Version() != versions[1]
+            || registry.Pool<WorldTransform>().Version() != versions[2]
+            || registry.Pool<Renderable>().Version() != versions[3];
+    }
+
+    void TransformHierarchy::Rebuild(Registry& registry) {
+        FP_PROFILE_FUNCTION();
+        ComponentPool<Hierarchy>& hierarchy = registry.Pool<Hierarchy>();
+        ComponentPool<Transform>& transforms = registry.Pool<Transform>();
+        ComponentPool<WorldTransform>& worlds = registry.Pool<WorldTransform>();
+        ComponentPool<Renderable>& renderables = registry.Pool<Renderable>();
+
+        // depth of every node (-1: not a node), found by walking up until a known depth or a root
+        Entity maxEntity = 0;
+        for (Entity e : hierarchy.Entities()) {
+            maxEntity = std::max(maxEntity, e);
+        }
+        depths.assign(hierarchy.Size() > 0 ? maxEntity + 1 : 0, -1);
+        auto isNode = [&](Entity e) {
+            return e != NULL_ENTITY && hierarchy.Has(e) && transforms.Has(e) && worlds.Has(e) && renderables.Has(e);
+        };
+        size_t nodeCount = 0;
+        for (Entity e : hierarchy.Entities()) {
+            if (!isNode(e)) continue;
+            nodeCount++;
+            chain.clear();
+            Entity cur = e;
+            while (depths[cur] < 0) {
+                chain.push_back(cur);
+                Entity parent = hierarchy.Get(cur).parent;
+                // (a broken link or a runaway chain just makes a root)
+                if (!isNode(parent) || chain.size() > hierarchy.Size()) {
+                    cur = NULL_ENTITY;
+                    break;
+                }
+                cur = parent;
+            }
+            int32_t depth = (cur == NULL_ENTITY) ? -1 : depths[cur];
+            for (size_t k = chain.size(); k-- > 0;) {
+                depths[chain[k]] = ++depth;
+            }
+        }
+
+        // counting sort by depth
+        int32_t maxDepth = -1;
+        for (Entity e : hierarchy.Entities()) {
+            if (isNode(e)) maxDepth = std::max(maxDepth, depths[e]);
+        }
+        levelStarts.assign(static_cast<size_t>(maxDepth + 2), 0);
+        for (Entity e : hierarchy.Entities()) {
+            if (isNode(e)) levelStarts[depths[e] + 1]++;
+        }
+        for (size_t level = 1; level < levelStarts.size(); level++) {
+            levelStarts[level] += levelStarts[level - 1];
+        }
+        order.assign(nodeCount, NULL_ENTITY);
+        {
+            std::vector<size_t> next(levelStarts.begin(), levelStarts.end() - (levelStarts.empty() ? 0 : 1));
+            for (Entity e : hierarchy.Entities()) {
+                if (isNode(e)) order[next[depths[e]]++] = e;
+            }
+        }
+
+        // line the pools up behind the sorted nodes
+        hierarchy.Reorder(order);
+        transforms.Reorder(order);
+        worlds.Reorder(order);
+        renderables.Reorder(order);
+
+        parents.assign(nodeCount, NO_PARENT);
+        for (size_t i = 0; i < nodeCount; i++) {
+            Entity parent = hierarchy.At(i).parent;
+            if (depths[order[i]] > 0)
+                parents[i] = static_cast<uint32_t>(transforms.Slot(parent));
+        }
+
+        versions[0] = hierarchy.Version();
+        versions[1] = transforms.Version();
+        versions[2] = worlds.Version();
+        versions[3] = renderables.Version();
+    }
+
+    size_t TransformHierarchy::NodeCount() const { return parents.size(); }
+    size_t TransformHierarchy::LevelCount() const { return levelStarts.empty() ? 0 : levelStarts.size() - 1; }
+}
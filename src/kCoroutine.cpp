@@ -0,0 +1,138 @@
+//
+// Created by snaki on 12/20/2020.
+//
+
+#include <kCoroutine.h>
+#include <util/BlockPool.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+
+namespace kVox {
+
+    /**
+     * Coroutine frames, pooled by size class. A task that finishes leaves its frame ready for the next one.
+     */
+    static util::BlockPool& FramePool() { return util::ImmortalPool<kTask, 4096>(); }
+
+    void* kTask::promise_type::operator new(std::size_t size) {
+        return FramePool().Allocate(size);
+    }
+
+    void kTask::promise_type::operator delete(void* ptr, std::size_t size) {
+        FramePool().Free(ptr, size);
+    }
+
+    void kTask::promise_type::unhandled_exception() noexcept {
+        fprintf(stderr, "Unhandled exception in a scripted task\n");
+        std::terminate();
+    }
+
+    kTask& kTask::operator=(kTask&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
+    kTask::~kTask() {
+        if (handle) handle.destroy();
+    }
+
+    kTask::Handle kTask::Release() {
+        Handle h = handle;
+        handle = nullptr;
+        return h;
+    }
+
+    void NextFrame::await_suspend(kTask::Handle h) const {
+        h.promise().scheduler->nextFrame.push_back(h);
+    }
+
+    void Seconds::await_suspend(kTask::Handle h) const {
+        kScheduler* scheduler = h.promise().scheduler;
+        scheduler->timers.push_back(kScheduler::Timer{ scheduler->now + duration, scheduler->timerSeq++, h });
+        std::push_heap(scheduler->timers.begin(), scheduler->timers.end(), kScheduler::Later);
+    }
+
+    void Until::await_suspend(kTask::Handle h) {
+        h.promise().scheduler->conditions.push_back(kScheduler::Condition{ std::move(predicate), h });
+    }
+
+    kScheduler::~kScheduler() {
+        StopAll();
+    }
+
+    bool kScheduler::Later(const Timer& a, const Timer& b) {
+        if (a.wakeTime != b.wakeTime) return a.wakeTime > b.wakeTime;
+        return a.seq > b.seq;
+    }
+
+    void kScheduler::Start(kTask&& task) {
+        kTask::Handle handle = task.Release();
+        if (!handle) return;
+        handle.promise().scheduler = this;
+        Resume(handle);
+    }
+
+    void kScheduler::Resume(kTask::Handle handle) {
+        handle.resume();
+        if (handle.done())
+            handle.destroy();
+    }
+
+    void kScheduler::Tick(double deltaTime) {
+        now += deltaTime;
+
+        // everything waiting on the next tick; tasks that wait again go on the list for the one after
+        resuming.swap(nextFrame);
+        for (kTask::Handle handle : resuming) {
+            Resume(handle);
+        }
+        resuming.clear();
+
+        // due timers, in wake order; timers set while resuming (even zero-length ones) wait for the next tick
+        // (a small tolerance keeps e.g. 60 ticks of 1/60 s from falling just short of a second)
+        uint64_t seqLimit = timerSeq;
+        while (!timers.empty() && timers.front().wakeTime <= now + 1e-9 && timers.front().seq < seqLimit) {
+            std::pop_heap(timers.begin(), timers.end(), Later);
+            kTask::Handle handle = timers.back().handle;
+            timers.pop_back();
+            Resume(handle);
+        }
+
+        // conditions; ones that still don't hold keep waiting
+        checking.swap(conditions);
+        for (Condition& condition : checking) {
+            if (condition.predicate())
+                Resume(condition.handle);
+            else
+                conditions.push_back(std::move(condition));
+        }
+        checking.clear();
+    }
+
+    void kScheduler::StopAll() {
+        for (kTask::Handle handle : nextFrame) {
+            handle.destroy();
+        }
+        nextFrame.clear();
+        for (const Timer& timer : timers) {
+            timer.handle.destroy();
+        }
+        timers.clear();
+        for (const Condition& condition : conditions) {
+            condition.handle.destroy();
+        }
+        conditions.clear();
+    }
+
+    double kScheduler::Now() const { return now; }
+
+    size_t kScheduler::TaskCount() const {
+        return nextFrame.size() + timers.size() + conditions.size();
+    }
+}
@@ -0,0 +1,274 @@
+//
+// Created by snaki on 12/19/2020.
+//
+
+#include <kInputRecorder.h>
+#include <cstring>
+
+namespace kVox {
+    static const char MAGIC[4] = { 'K', 'V', 'I', 'R' };
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    /** Recorded bytes held in memory before they're written out. */
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    // LEB128-style variable-length integers; signed values are zigzag-encoded first
+    static void PutVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    static void PutSigned(std::vector<uint8_t>& out, int64_t value) {
+        PutVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+    /** Reads a varint; returns false (leaving \c pos at the end) if the data runs out. */
+    static bool GetVarint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= in.size()) return false;
+            uint8_t byte = in[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+    static bool GetSigned(const std::vector<uint8_t>& in, size_t& pos, int64_t& value) {
+        uint64_t raw;
+        if (!GetVarint(in, pos, raw)) return false;
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    kInputRecorder::~kInputRecorder() {
+        if (file != nullptr) {
+            Flush();
+            fclose(file);
+        }
+    }
+
+    bool kInputRecorder::StartRecording(const std::string& path, double tickDelta) {
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open input recording for writing: %s\n", path.c_str());
+            return false;
+        }
+        writeBuffer.clear();
+        writeBuffer.insert(writeBuffer.end(), MAGIC, MAGIC + sizeof(MAGIC));
+        writeBuffer.push_back(FORMAT_VERSION);
+        uint8_t raw[sizeof(double)];
+        std::memcpy(raw, &tickDelta, sizeof(double));
+        writeBuffer.insert(writeBuffer.end(), raw, raw + sizeof(double));
+        lastTick = 0;
+        lastTimestamp = 0;
+        return true;
+    }
+
+    bool kInputRecorder::StartReplay(const std::string& path) {
+        FILE* in = fopen(path.c_str(), "rb");
+        if (in == nullptr) {
+            fprintf(stderr, "Couldn't open input recording: %s\n", path.c_str());
+            return false;
+        }
+        data.clear();
+        uint8_t chunk[4096];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+            data.insert(data.end(), chunk, chunk + read);
+        }
+        fclose(in);
+
+        const size_t headerSize = sizeof(MAGIC) + 1 + sizeof(double);
+        if (data.size() < headerSize || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0
+                || data[sizeof(MAGIC)] != FORMAT_VERSION) {
+            fprintf(stderr, "Not a valid input recording: %s\n", path.c_str());
+            data.clear();
+            return false;
+        }
+        std::memcpy(&recordedTickDelta, data.data() + sizeof(MAGIC) + 1, sizeof(double));
+        readPos = headerSize;
+        lastTick = 0;
+        lastTimestamp = 0;
+        endTick = UINT64_MAX;
+        replaying = true;
+        DecodeNext();
+        return true;
+    }
+
+    void kInputRecorder::Stop(uint64_t tick) {
+        if (file != nullptr) {
+            PutVarint(writeBuffer, tick - lastTick);
+            PutVarint(writeBuffer, 0);
+            writeBuffer.push_back(END);
+            Flush();
+            fclose(file);
+            file = nullptr;
+        }
+        if (replaying) {
+            replaying = false;
+            hasNext = false;
+            data.clear();
+        }
+    }
+
+    bool kInputRecorder::IsRecording() const { return file != nullptr; }
+    bool kInputRecorder::IsReplaying() const { return replaying; }
+    double kInputRecorder::GetRecordedTickDelta() const { return recordedTickDelta; }
+
+    bool kInputRecorder::IsRecordable(const SDL_Event& event) {
+        switch (event.type) {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+            case SDL_MOUSEMOTION:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void kInputRecorder::Record(const SDL_Event& event, uint64_t tick) {
+        if (file == nullptr || !IsRecordable(event)) return;
+        // events arrive in order, so both deltas are never negative
+        PutVarint(writeBuffer, tick - lastTick);
+        PutVarint(writeBuffer, event.common.timestamp - lastTimestamp);
+        lastTick = tick;
+        lastTimestamp = event.common.timestamp;
+        switch (event.type) {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                writeBuffer.push_back(event.type == SDL_KEYDOWN ? KEY_DOWN : KEY_UP);
+                PutVarint(writeBuffer, static_cast<uint32_t>(event.key.keysym.scancode));
+                PutVarint(writeBuffer, static_cast<uint32_t>(event.key.keysym.sym));
+                PutVarint(writeBuffer, event.key.keysym.mod);
+                writeBuffer.push_back(event.key.repeat);
+                break;
+            }
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP: {
+                writeBuffer.push_back(event.type == SDL_MOUSEBUTTONDOWN ? MOUSE_DOWN : MOUSE_UP);
+                writeBuffer.push_back(event.button.button);
+                writeBuffer.push_back(event.button.clicks);
+                PutSigned(writeBuffer, event.button.x);
+                PutSigned(writeBuffer, event.button.y);
+                PutVarint(writeBuffer, event.button.which);
+                break;
+            }
+            case SDL_MOUSEMOTION: {
+                writeBuffer.push_back(MOUSE_MOTION);
+                PutVarint(writeBuffer, event.motion.state);
+                PutSigned(writeBuffer, event.motion.x);
+                PutSigned(writeBuffer, event.motion.y);
+                PutSigned(writeBuffer, event.motion.xrel);
+                PutSigned(writeBuffer, event.motion.yrel);
+                PutVarint(writeBuffer, event.motion.which);
+                break;
+            }
+        }
+        if (writeBuffer.size() >= FLUSH_SIZE)
+            Flush();
+    }
+
+    void kInputRecorder::Flush() {
+        if (file == nullptr || writeBuffer.empty()) return;
+        fwrite(writeBuffer.data(), 1, writeBuffer.size(), file);
+        writeBuffer.clear();
+    }
+
+    void kInputRecorder::DecodeNext() {
+        hasNext = false;
+        uint64_t tickDelta, timeDelta;
+        if (!GetVarint(data, readPos, tickDelta) || !GetVarint(data, readPos, timeDelta) || readPos >= data.size()) {
+            // truncated recording (e.g. the game crashed): stop where the data does
+            endTick = lastTick;
+            return;
+        }
+        uint64_t tick = lastTick + tickDelta;
+        auto timestamp = static_cast<uint32_t>(lastTimestamp + timeDelta);
+        lastTick = tick;
+        lastTimestamp = timestamp;
+
+        auto kind = static_cast<RecordKind>(data[readPos++]);
+        SDL_Event event {};
+        bool ok = true;
+        switch (kind) {
+            case END: {
+                endTick = tick;
+                return;
+            }
+            case KEY_DOWN:
+            case KEY_UP: {
+                uint64_t scancode, sym, mod;
+                ok = GetVarint(data, readPos, scancode) && GetVarint(data, readPos, sym)
+                        && GetVarint(data, readPos, mod) && readPos < data.size();
+                if (!ok) break;
+                event.type = (kind == KEY_DOWN) ? SDL_KEYDOWN : SDL_KEYUP;
+                event.key.state = (kind == KEY_DOWN) ? SDL_PRESSED : SDL_RELEASED;
+                event.key.keysym.scancode = static_cast<SDL_Scancode>(scancode);
+                event.key.keysym.sym = static_cast<SDL_Keycode>(sym);
+                event.key.keysym.mod = static_cast<uint16_t>(mod);
+                event.key.repeat = data[readPos++];
+                break;
+            }
+            case MOUSE_DOWN:
+            case MOUSE_UP: {
+                int64_t x, y;
+                uint64_t which;
+                ok = readPos + 2 <= data.size();
+                if (!ok) break;
+                event.button.button = data[readPos++];
+                event.button.clicks = data[readPos++];
+                ok = GetSigned(data, readPos, x) && GetSigned(data, readPos, y) && GetVarint(data, readPos, which);
+                if (!ok) break;
+                event.type = (kind == MOUSE_DOWN) ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+                event.button.state = (kind == MOUSE_DOWN) ? SDL_PRESSED : SDL_RELEASED;
+                event.button.x = static_cast<int32_t>(x);
+                event.button.y = static_cast<int32_t>(y);
+                event.button.which = static_cast<uint32_t>(which);
+                break;
+            }
+            case MOUSE_MOTION: {
+                uint64_t state, which;
+                int64_t x, y, xrel, yrel;
+                ok = GetVarint(data, readPos, state) && GetSigned(data, readPos, x) && GetSigned(data, readPos, y)
+                        && GetSigned(data, readPos, xrel) && GetSigned(data, readPos, yrel)
+                        && GetVarint(data, readPos, which);
+                if (!ok) break;
+                event.type = SDL_MOUSEMOTION;
+                event.motion.state = static_cast<uint32_t>(state);
+                event.motion.x = static_cast<int32_t>(x);
+                event.motion.y = static_cast<int32_t>(y);
+                event.motion.xrel = static_cast<int32_t>(xrel);
+                event.motion.yrel = static_cast<int32_t>(yrel);
+                event.motion.which = static_cast<uint32_t>(which);
+                break;
+            }
+            default: {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "Input recording is corrupt; replay stops at tick %llu\n", (unsigned long long)tick);
+            endTick = tick;
+            return;
+        }
+        event.common.timestamp = timestamp;
+        next = event;
+        nextTick = tick;
+        hasNext = true;
+    }
+
+    bool kInputRecorder::NextEvent(uint64_t tick, SDL_Event& event) {
+        if (!replaying || !hasNext || nextTick > tick)
+            return false;
+        event = next;
+        DecodeNext();
+        return true;
+    }
+
+    bool kInputRecorder::ReplayFinished(uint64_t tick) const {
+        return replaying && !hasNext && tick >= endTick;
+    }
+}
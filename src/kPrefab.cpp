@@ -0,0 +1,63 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <kPrefab.h>
+#include <util/Profiler.h>
+
+namespace kVox {
+
+    void kPrefab::Spawn(GEngine& engine, size_t count, const Placement* placements, GObjectHandle* handles) const {
+        if (count == 0) return;
+        FP_PROFILE_FUNCTION();
+        Renderer& renderer = engine.GetRenderer();
+        // size everything up front, so the batch doesn't keep growing pools one reallocation at a time
+        engine.ReserveGameObjects(count);
+        if (physics)
+            engine.GetRegistry().Reserve<ecs::PhysicsBody>(count);
+        if (drawable)
+            engine.GetRegistry().Reserve<ecs::Bounds>(count);
+        if (drawable && collision)
+            engine.GetRegistry().Reserve<ecs::Collider>(count);
+        if (gravityMass > 0.0)
+            engine.GetRegistry().Reserve<ecs::GravityBody>(count);
+
+        std::vector<GObject*> objects(count);
+        std::vector<VAO*> vaos;
+        glm::vec3 boundsCenter, boundsHalfExtents;
+        PrimitiveVAO::GetLocalBounds(mesh, boundsCenter, boundsHalfExtents);
+        if (drawable) vaos.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            const Placement& placement = placements[i];
+            GObject* go = create ? create(renderer) : new GObject(renderer);
+            if (drawable) {
+                VAO* vao = new PrimitiveVAO(nullptr, 0, shader, renderer, mesh);
+                vao->material = material;
+                go->SetVAO(vao);
+                go->EnableBounds(boundsCenter, boundsHalfExtents);
+                if (collision)
+                    go->EnableCollision(layer, mask, ColliderShapeOf(mesh), trigger);
+                vaos.push_back(vao);
+            }
+            // (setters just mark the transform dirty; the whole batch is resolved in the next pass)
+            go->SetScale(scale * placement.scale);
+            go->SetRotation(placement.rot, false);
+            go->SetPosition(placement.pos);
+            if (physics) {
+                go->EnablePhys();
+                go->SetVelocity(velocity);
+            }
+            if (gravityMass > 0.0)
+                go->EnableGravity(gravityMass);
+            objects[i] = go;
+        }
+        engine.AddGameObjects(objects.data(), count, handles);
+        renderer.AddDrawables(vaos.data(), vaos.size());
+    }
+
+    GObjectHandle kPrefab::Spawn(GEngine& engine, const Placement& placement) const {
+        GObjectHandle handle;
+        Spawn(engine, 1, &placement, &handle);
+        return handle;
+    }
+}
@@ -0,0 +1,222 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <kScene.h>
+#include <GEngine.h>
+#include <util/Profiler.h>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+
+namespace kVox {
+    using namespace SceneFormat;
+
+    /** Whether a table of \c count records of type \c T fits inside the file, on a 4-byte boundary. */
+    template<typename T>
+    static bool SectionFits(const Section& section, size_t fileSize) {
+        return section.offset % alignof(uint32_t) == 0 && section.offset <= fileSize
+               && section.count <= (fileSize - section.offset) / sizeof(T);
+    }
+
+    static bool IndexOk(uint32_t index, uint32_t count) {
+        return index == NO_INDEX || index < count;
+    }
+
+    bool kScene::Load(const std::string& path) {
+        header = nullptr;
+        if (!file.Open(path)) return false;
+        const uint8_t* base = file.Data();
+        size_t size = file.Size();
+
+        const auto* head = reinterpret_cast<const Header*>(base);
+        if (size < sizeof(Header) || std::memcmp(head->magic, MAGIC, sizeof(MAGIC)) != 0) {
+            fprintf(stderr, "Not a binary scene: %s\n", path.c_str());
+            file.Close();
+            return false;
+        }
+        if (head->version != VERSION || head->fileSize != size) {
+            fprintf(stderr, "Scene %s is version %u (%u bytes), expected version %u (%zu bytes); recompile it\n",
+                    path.c_str(), head->version, head->fileSize, VERSION, size);
+            file.Close();
+            return false;
+        }
+        if (!SectionFits<Entity>(head->entities, size) || !SectionFits<Material>(head->materials, size)
+            || !SectionFits<SceneFormat::Camera>(head->cameras, size) || !SectionFits<char>(head->strings, size)
+            || head->strings.count == 0 || base[head->strings.offset + head->strings.count - 1] != '\0') {
+            fprintf(stderr, "Scene %s is truncated or corrupt\n", path.c_str());
+            file.Close();
+            return false;
+        }
+
+        // fix up the tables' offsets into pointers; the records themselves are used in place
+        entities = reinterpret_cast<const Entity*>(base + head->entities.offset);
+        materials = reinterpret_cast<const Material*>(base + head->materials.offset);
+        cameras = reinterpret_cast<const SceneFormat::Camera*>(base + head->cameras.offset);
+        strings = reinterpret_cast<const char*>(base + head->strings.offset);
+
+        // references are checked once here, so instantiating can follow them blindly
+        uint32_t stringBytes = head->strings.count;
+        bool valid = true;
+        for (uint32_t i = 0; i < head->entities.count && valid; i++) {
+            const Entity& entity = entities[i];
+            valid = entity.name < stringBytes && entity.shader < stringBytes
+                    && (entity.parent == NO_INDEX || entity.parent < i)
+                    && IndexOk(entity.material, head->materials.count)
+                    && entity.kind < KIND_COUNT && entity.primitive <= SPHERE;
+        }
+        for (uint32_t i = 0; i < head->cameras.count && valid; i++) {
+            const SceneFormat::Camera& camera = cameras[i];
+            valid = camera.name < stringBytes && IndexOk(camera.target, head->entities.count)
+                    && IndexOk(camera.orient, head->entities.count);
+        }
+        if (!valid) {
+            fprintf(stderr, "Scene %s has broken references\n", path.c_str());
+            file.Close();
+            return false;
+        }
+        header = head;
+        return true;
+    }
+
+    static GObject* NewObject(uint8_t kind, const Renderer& renderer) {
+        switch (kind) {
+            case PLAYER: return new PlayerGO(renderer);
+            case ENEMY:  return new EnemyGO(renderer);
+            case GOAL:   return new GoalGO(renderer);
+            default:     return new GObject(renderer);
+        }
+    }
+
+    /** Collision layer objects of a kind are in. */
+    static uint32_t LayerOf(uint8_t kind) {
+        switch (kind) {
+            case PLAYER: return ecs::LAYER_PLAYER;
+            case ENEMY:  return ecs::LAYER_ENEMY;
+            case GOAL:   return ecs::LAYER_PICKUP;
+            default:     return ecs::LAYER_DEFAULT;
+        }
+    }
+    /** Collision layers objects of a kind hit. Enemies pass into the ship, which is how they get it. */
+    static uint32_t MaskOf(uint8_t kind) {
+        return (kind == ENEMY) ? (ecs::LAYER_ALL & ~ecs::LAYER_PLAYER) : ecs::LAYER_ALL;
+    }
+
+    /** How dense planets are, in gravity's mass per cubic world unit. */
+    static constexpr double PLANET_DENSITY = 0.005;
+    /** How heavy bodies that fly around are; they're pulled on, but hardly pull on anything themselves. */
+    static constexpr double BODY_MASS = 1.0;
+
+    /** Gravity's mass for a solid \c primitive at \c scale: its drawn volume (scale goes in twice), times density. */
+    static double PlanetMass(PrimitiveType primitive, const glm::vec3& scale) {
+        glm::vec3 center, halfExtents;
+        PrimitiveVAO::GetLocalBounds(primitive, center, halfExtents);
+        glm::dvec3 size = glm::dvec3(halfExtents) * glm::dvec3(scale) * glm::dvec3(scale) * 2.0;
+        double fill;    // share of the bounding box the shape fills
+        switch (primitive) {
+            case SPHERE:    fill = glm::pi<double>() / 6.0; break;
+            case CYLINDER:  fill = glm::pi<double>() / 4.0; break;
+            case CONE:      fill = glm::pi<double>() / 12.0; break;
+            case TORUS:     fill = 0.5; break;
+            default:        fill = 1.0; break;
+        }
+        return PLANET_DENSITY * size.x * size.y * size.z * fill;
+    }
+
+    GObjectHandle kScene::InstantiateEntity(uint32_t index, GEngine& engine, Renderer& renderer, GObject* parent) const {
+        const Entity& entity = entities[index];
+        GObject* go = NewObject(entity.kind, renderer);
+        GObjectHandle handle = engine.AddGameObject(GetString(entity.name), go);
+        if (!handle) {
+            fprintf(stderr, "Can't instantiate scene object '%s': the name is taken\n", GetString(entity.name));
+            delete go;
+            return handle;
+        }
+        if (parent != nullptr)
+            go->SetParent(parent);
+        if (entity.material != NO_INDEX) {
+            const Material& material = materials[entity.material];
+            VAO* vao = new PrimitiveVAO(nullptr, 0, GetString(entity.shader), renderer,
+                                        static_cast<PrimitiveType>(entity.primitive));
+            vao->material.materialAmbColor = material.ambient;
+            vao->material.materialDiffColor = material.diffuse;
+            vao->material.materialSpecColor = material.specular;
+            vao->material.materialShininess = material.shininess;
+            go->SetVAO(vao);
+            renderer.AddDrawable(vao);
+            glm::vec3 center, halfExtents;
+            auto primitive = static_cast<PrimitiveType>(entity.primitive);
+            PrimitiveVAO::GetLocalBounds(primitive, center, halfExtents);
+            go->EnableBounds(center, halfExtents);
+            // top-level objects collide (what's attached rides along with them); pickups are flown through
+            if (parent == nullptr)
+                go->EnableCollision(LayerOf(entity.kind), MaskOf(entity.kind), ColliderShapeOf(primitive), entity.kind == GOAL);
+        }
+        go->SetScale(entity.scale);
+        go->SetRotation(entity.rot, false);
+        // the file holds world positions; top-level objects go where they are relative to the engine's origin
+        go->SetPosition((parent == nullptr) ? glm::dvec3(entity.pos) - engine.GetWorldOrigin() : glm::dvec3(entity.pos));
+        go->UpdateModelMtx();
+        if (entity.flags & ENTITY_PHYSICS) go->EnablePhys();
+        // top-level scenery is what pulls (planets, stars); whatever flies around is pulled
+        if (entity.flags & ENTITY_PHYSICS)
+            go->EnableGravity(BODY_MASS);
+        else if (parent == nullptr && entity.kind == OBJECT && entity.material != NO_INDEX)
+            go->EnableGravity(PlanetMass(static_cast<PrimitiveType>(entity.primitive), entity.scale));
+        return handle;
+    }
+
+    void kScene::InstantiateCamera(uint32_t index, Renderer& renderer, const std::vector<GObjectHandle>& handles) const {
+        const SceneFormat::Camera& record = cameras[index];
+        auto* camera = new kVox::Camera();
+        camera->camPos = record.pos;
+        camera->cameraTheta = record.theta;
+        camera->cameraPhi = record.phi;
+        camera->camDist = record.dist;
+        camera->canLook = (record.flags & CAMERA_CAN_LOOK) != 0;
+        // cameras follow objects by handle, so a target that goes away just leaves the camera where it was
+        if (record.target == NO_INDEX) {
+            camera->SetTargetLookAt(renderer.GetOrigin());
+        } else {
+            GObjectHandle target = handles[record.target];
+            bool local = (record.flags & CAMERA_TARGET_LOCAL) != 0;
+            camera->SetTargetLookAt([target, local, last = glm::dvec3(0.0)]() mutable {
+                GObject* go = GEngine::Instance().GetGameObject(target);
+                if (go != nullptr) last = local ? go->GetLocalPos() : go->GetRenderPos();
+                return last;
+            });
+        }
+        if (record.orient != NO_INDEX) {
+            GObjectHandle orient = handles[record.orient];
+            camera->orientLocked = true;
+            camera->orientPos = [orient, last = glm::vec3(0.0,0.0,1.0)]() mutable {
+                GObject* go = GEngine::Instance().GetGameObject(orient);
+                if (go != nullptr) last = go->GetOrientation();
+                return last;
+            };
+        }
+        camera->SetLookingAtTgt((record.flags & CAMERA_LOOK_AT_TARGET) != 0);
+        camera->RecomputeCamPos();
+        renderer.AddCamera(GetString(record.name), camera);
+        if (record.flags & CAMERA_ACTIVE)
+            renderer.SetActiveCamera(GetString(record.name));
+    }
+
+    bool kScene::Instantiate(GEngine& engine, Renderer& renderer) const {
+        if (header == nullptr) return false;
+        FP_PROFILE_FUNCTION();
+
+        // handles by entity index, for parents and camera targets
+        std::vector<GObjectHandle> handles(header->entities.count);
+        for (uint32_t i = 0; i < header->entities.count; i++) {
+            uint32_t parent = entities[i].parent;
+            handles[i] = InstantiateEntity(i, engine, renderer,
+                                           (parent != NO_INDEX) ? engine.GetGameObject(handles[parent]) : nullptr);
+            if (!handles[i]) return false;
+        }
+        for (uint32_t i = 0; i < header->cameras.count; i++) {
+            InstantiateCamera(i, renderer, handles);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,241 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+// kScene::Compile lives apart from the loader so the converter tool builds without the rest of the engine.
+
+#include <kScene.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace kVox {
+    using namespace SceneFormat;
+
+    /** Text scene being turned into tables; names resolve to record indices as they're declared. */
+    struct SceneBuilder {
+        std::vector<Entity> entities;
+        std::vector<Material> materials;
+        std::vector<Camera> cameras;
+        std::vector<char> strings;
+        std::unordered_map<std::string, uint32_t> entityIds, materialIds, cameraIds;
+        std::unordered_map<std::string, uint32_t> stringOffsets;
+
+        uint32_t AddString(const std::string& str) {
+            auto it = stringOffsets.find(str);
+            if (it != stringOffsets.end()) return it->second;
+            auto offset = static_cast<uint32_t>(strings.size());
+            strings.insert(strings.end(), str.begin(), str.end());
+            strings.push_back('\0');
+            stringOffsets.emplace(str, offset);
+            return offset;
+        }
+    };
+
+    /** Reads one line's tokens, with errors tagged by file and line. */
+    class LineReader {
+    public:
+        LineReader(const std::string& path, int line, const std::string& text) : path(path), line(line), in(text) {}
+
+        bool Word(std::string& out) { return static_cast<bool>(in >> out); }
+
+        bool Number(float& out) {
+            std::string token;
+            if (!(in >> token)) return Error("expected a number");
+            char* end = nullptr;
+            out = std::strtof(token.c_str(), &end);
+            if (*end != '\0') return Error("expected a number, got '" + token + "'");
+            return true;
+        }
+        bool Vector(glm::vec3& out) { return Number(out.x) && Number(out.y) && Number(out.z); }
+
+        /** Reads a name and looks it up among those declared so far. */
+        bool Reference(const std::unordered_map<std::string, uint32_t>& ids, const char* what, uint32_t& out) {
+            std::string name;
+            if (!Word(name)) return Error(std::string("expected a ") + what + " name");
+            auto it = ids.find(name);
+            if (it == ids.end()) return Error(std::string("no ") + what + " named '" + name + "' declared before this");
+            out = it->second;
+            return true;
+        }
+
+        bool Error(const std::string& message) {
+            fprintf(stderr, "%s:%d: %s\n", path.c_str(), line, message.c_str());
+            return false;
+        }
+
+    private:
+        const std::string& path;
+        int line;
+        std::istringstream in;
+    };
+
+    static bool ParseMaterial(LineReader& reader, SceneBuilder& scene, const std::string& name) {
+        Material material { glm::vec3(0.1), glm::vec3(0.9), glm::vec3(1.0), 0.4f };
+        std::string key;
+        while (reader.Word(key)) {
+            bool ok;
+            if (key == "amb") ok = reader.Vector(material.ambient);
+            else if (key == "diff") ok = reader.Vector(material.diffuse);
+            else if (key == "spec") ok = reader.Vector(material.specular);
+            else if (key == "shininess") ok = reader.Number(material.shininess);
+            else ok = reader.Error("unknown material property '" + key + "'");
+            if (!ok) return false;
+        }
+        if (!scene.materialIds.emplace(name, static_cast<uint32_t>(scene.materials.size())).second)
+            return reader.Error("material '" + name + "' declared twice");
+        scene.materials.push_back(material);
+        return true;
+    }
+
+    static bool ParseObject(LineReader& reader, SceneBuilder& scene, const std::string& name) {
+        static const std::unordered_map<std::string, uint8_t> KINDS {
+            { "object", OBJECT }, { "player", PLAYER }, { "enemy", ENEMY }, { "goal", GOAL } };
+        static const std::unordered_map<std::string, uint8_t> MESHES {
+            // (in PrimitiveType order; spelled out so this file doesn't need the renderer)
+            { "cube", 0 }, { "cone", 1 }, { "cylinder", 2 }, { "torus", 3 }, { "sphere", 4 } };
+
+        Entity entity {};
+        entity.name = scene.AddString(name);
+        entity.parent = NO_INDEX;
+        entity.material = NO_INDEX;
+        entity.shader = scene.AddString("lighting");
+        entity.kind = OBJECT;
+        entity.primitive = 0;
+        entity.pos = glm::vec3(0.0);
+        entity.rot = glm::vec3(0.0);
+        entity.scale = glm::vec3(1.0);
+        bool hasMesh = false;
+        std::string key, word;
+        while (reader.Word(key)) {
+            bool ok = true;
+            if (key == "kind" || key == "mesh") {
+                const auto& table = (key == "kind") ? KINDS : MESHES;
+                if (!reader.Word(word) || table.count(word) == 0)
+                    return reader.Error("unknown " + key + " '" + word + "'");
+                (key == "kind" ? entity.kind : entity.primitive) = table.at(word);
+                hasMesh |= (key == "mesh");
+            }
+            else if (key == "parent") ok = reader.Reference(scene.entityIds, "object", entity.parent);
+            else if (key == "material") ok = reader.Reference(scene.materialIds, "material", entity.material);
+            else if (key == "shader") {
+                ok = reader.Word(word) || reader.Error("expected a shader name");
+                if (ok) entity.shader = scene.AddString(word);
+            }
+            else if (key == "pos") ok = reader.Vector(entity.pos);
+            else if (key == "rot") ok = reader.Vector(entity.rot);
+            else if (key == "scale") ok = reader.Vector(entity.scale);
+            else if (key == "physics") entity.flags |= ENTITY_PHYSICS;
+            else ok = reader.Error("unknown object property '" + key + "'");
+            if (!ok) return false;
+        }
+        // a mesh without a material gets the default look; a material alone implies a cube
+        if (hasMesh && entity.material == NO_INDEX) {
+            if (!scene.materialIds.count("")) {
+                scene.materialIds.emplace("", static_cast<uint32_t>(scene.materials.size()));
+                scene.materials.push_back(Material { glm::vec3(0.1), glm::vec3(0.9), glm::vec3(1.0), 0.4f });
+            }
+            entity.material = scene.materialIds.at("");
+        }
+        if (!scene.entityIds.emplace(name, static_cast<uint32_t>(scene.entities.size())).second)
+            return reader.Error("object '" + name + "' declared twice");
+        scene.entities.push_back(entity);
+        return true;
+    }
+
+    static bool ParseCamera(LineReader& reader, SceneBuilder& scene, const std::string& name) {
+        Camera camera {};
+        camera.name = scene.AddString(name);
+        camera.target = NO_INDEX;
+        camera.orient = NO_INDEX;
+        camera.pos = glm::vec3(0.0);
+        camera.theta = 0.0f;
+        camera.phi = 1.5707964f;
+        camera.dist = 5.0f;
+        std::string key;
+        while (reader.Word(key)) {
+            bool ok = true;
+            if (key == "target") ok = reader.Reference(scene.entityIds, "object", camera.target);
+            else if (key == "orient") ok = reader.Reference(scene.entityIds, "object", camera.orient);
+            else if (key == "pos") ok = reader.Vector(camera.pos);
+            else if (key == "theta") ok = reader.Number(camera.theta);
+            else if (key == "phi") ok = reader.Number(camera.phi);
+            else if (key == "dist") ok = reader.Number(camera.dist);
+            else if (key == "active") camera.flags |= CAMERA_ACTIVE;
+            else if (key == "canlook") camera.flags |= CAMERA_CAN_LOOK;
+            else if (key == "look") camera.flags |= CAMERA_LOOK_AT_TARGET;
+            else if (key == "local") camera.flags |= CAMERA_TARGET_LOCAL;
+            else ok = reader.Error("unknown camera property '" + key + "'");
+            if (!ok) return false;
+        }
+        if (!scene.cameraIds.emplace(name, static_cast<uint32_t>(scene.cameras.size())).second)
+            return reader.Error("camera '" + name + "' declared twice");
+        scene.cameras.push_back(camera);
+        return true;
+    }
+
+    /** Appends a table to the output, 4-byte aligned, and records where it went. */
+    template<typename T>
+    static Section PutTable(std::vector<uint8_t>& out, const std::vector<T>& table) {
+        out.resize((out.size() + 3) & ~size_t(3), 0);
+        Section section { static_cast<uint32_t>(out.size()), static_cast<uint32_t>(table.size()) };
+        const auto* bytes = reinterpret_cast<const uint8_t*>(table.data());
+        out.insert(out.end(), bytes, bytes + table.size() * sizeof(T));
+        return section;
+    }
+
+    bool kScene::Compile(const std::string& textPath, const std::string& binaryPath) {
+        std::ifstream in(textPath);
+        if (!in) {
+            fprintf(stderr, "Couldn't open text scene: %s\n", textPath.c_str());
+            return false;
+        }
+        SceneBuilder scene;
+        std::string text;
+        int line = 0;
+        bool ok = true;
+        while (std::getline(in, text)) {
+            line++;
+            text = text.substr(0, text.find('#'));
+            LineReader reader(textPath, line, text);
+            std::string type, name;
+            if (!reader.Word(type)) continue;
+            if (!reader.Word(name)) { ok = reader.Error("expected a name after '" + type + "'"); continue; }
+            // keep going after errors, so they're all reported in one run
+            if (type == "material") ok &= ParseMaterial(reader, scene, name);
+            else if (type == "object") ok &= ParseObject(reader, scene, name);
+            else if (type == "camera") ok &= ParseCamera(reader, scene, name);
+            else ok = reader.Error("unknown declaration '" + type + "'");
+        }
+        if (ok && scene.cameras.empty()) {
+            fprintf(stderr, "%s: a scene needs at least one camera\n", textPath.c_str());
+            ok = false;
+        }
+        if (!ok) return false;
+
+        std::vector<uint8_t> out(sizeof(Header), 0);
+        Header header {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.entities = PutTable(out, scene.entities);
+        header.materials = PutTable(out, scene.materials);
+        header.cameras = PutTable(out, scene.cameras);
+        header.strings = PutTable(out, scene.strings);
+        header.fileSize = static_cast<uint32_t>(out.size());
+        std::memcpy(out.data(), &header, sizeof(Header));
+
+        FILE* file = fopen(binaryPath.c_str(), "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open binary scene for writing: %s\n", binaryPath.c_str());
+            return false;
+        }
+        bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+        written &= (fclose(file) == 0);
+        if (!written) fprintf(stderr, "Couldn't write binary scene: %s\n", binaryPath.c_str());
+        return written;
+    }
+}
@@ -0,0 +1,222 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <kSceneStreamer.h>
+#include <GEngine.h>
+#include <util/Profiler.h>
+#include <limits>
+
+namespace kVox {
+    using SceneFormat::NO_INDEX;
+
+    /** Packs a cell coordinate (21 bits per axis, so +-1M cells) into a map key. */
+    static uint64_t PackCoord(glm::ivec3 coord) {
+        constexpr uint64_t MASK = (1u << 21) - 1;
+        return ((static_cast<uint64_t>(coord.x) & MASK) << 42) | ((static_cast<uint64_t>(coord.y) & MASK) << 21)
+               | (static_cast<uint64_t>(coord.z) & MASK);
+    }
+
+    bool kSceneStreamer::Load(const std::string& path) {
+        return scene.Load(path);
+    }
+
+    glm::ivec3 kSceneStreamer::CoordOf(const glm::dvec3& pos) const {
+        return glm::ivec3(glm::floor(pos / static_cast<double>(cellSize)));
+    }
+
+    uint64_t kSceneStreamer::KeyOf(const glm::dvec3& pos) const {
+        return PackCoord(CoordOf(pos));
+    }
+
+    kSceneStreamer::Cell& kSceneStreamer::CellAt(glm::ivec3 coord) {
+        Cell& cell = cells[PackCoord(coord)];
+        cell.coord = coord;
+        return cell;
+    }
+
+    double kSceneStreamer::FocusDistance(const Cell& cell) const {
+        glm::dvec3 lo = glm::dvec3(cell.coord) * static_cast<double>(cellSize);
+        glm::dvec3 hi = lo + glm::dvec3(cellSize);
+        double closest = std::numeric_limits<double>::infinity();
+        for (const glm::dvec3& point : focusPoints) {
+            closest = glm::min(closest, glm::distance(point, glm::clamp(point, lo, hi)));
+        }
+        return closest;
+    }
+
+    bool kSceneStreamer::Start(GEngine& engine, Renderer& renderer) {
+        if (scene.CameraCount() == 0) {
+            fprintf(stderr, "Can't stream a scene that isn't loaded (or has no cameras)\n");
+            return false;
+        }
+        started = true;
+        uint32_t count = scene.EntityCount();
+        handles.assign(count, GObjectHandle());
+        status.assign(count, ABSENT);
+        trees.assign(count, {});
+        saved.assign(count, Saved());
+
+        // group everything under its top-level object (parents come first in the file, so one pass does it)
+        std::vector<uint32_t> rootOf(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t parent = scene.GetEntity(i).parent;
+            rootOf[i] = (parent == NO_INDEX) ? i : rootOf[parent];
+            trees[rootOf[i]].push_back(i);
+        }
+        // the player and anything a camera follows must always be there
+        std::vector<bool> pinned(count, false);
+        for (uint32_t i = 0; i < count; i++) {
+            if (scene.GetEntity(i).kind == SceneFormat::PLAYER) pinned[rootOf[i]] = true;
+        }
+        for (uint32_t i = 0; i < scene.CameraCount(); i++) {
+            const SceneFormat::Camera& camera = scene.GetCamera(i);
+            if (camera.target != NO_INDEX) pinned[rootOf[camera.target]] = true;
+            if (camera.orient != NO_INDEX) pinned[rootOf[camera.orient]] = true;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (trees[i].empty()) continue;
+            if (pinned[i])
+                SpawnTree(i, engine, renderer, PINNED);
+            else
+                CellAt(CoordOf(scene.GetEntity(i).pos)).roots.push_back(i);
+        }
+        for (uint32_t i = 0; i < scene.CameraCount(); i++) {
+            scene.InstantiateCamera(i, renderer, handles);
+        }
+        return true;
+    }
+
+    void kSceneStreamer::AddFocus(std::function<glm::dvec3()> focus) {
+        focuses.push_back(std::move(focus));
+    }
+
+    uint32_t kSceneStreamer::SpawnTree(uint32_t root, GEngine& engine, Renderer& renderer, EntityStatus as) {
+        uint32_t created = 0;
+        for (uint32_t i : trees[root]) {
+            uint32_t parent = scene.GetEntity(i).parent;
+            // skip what gameplay destroyed, along with anything that was attached to it
+            if (status[i] == GONE || (parent != NO_INDEX && !handles[parent])) continue;
+            GObject* parentGo = (parent != NO_INDEX) ? engine.GetGameObject(handles[parent]) : nullptr;
+            handles[i] = scene.InstantiateEntity(i, engine, renderer, parentGo);
+            if (!handles[i]) {
+                status[i] = GONE;
+                continue;
+            }
+            status[i] = as;
+            created++;
+            resident++;
+            GObject* go = engine.GetGameObject(handles[i]);
+            if (i == root && saved[root].valid) {
+                // pick up where it was left
+                go->SetPosition(saved[root].pos - engine.GetWorldOrigin());
+                go->SetRotation(saved[root].rot, false);
+                go->SetVelocity(saved[root].vel);
+                go->UpdateModelMtx();
+                saved[root].valid = false;
+            }
+            if (onSpawn) onSpawn(go);
+        }
+        return created;
+    }
+
+    void kSceneStreamer::UnloadTree(uint32_t root, GEngine& engine) {
+        for (uint32_t i : trees[root]) {
+            if (status[i] != RESIDENT) continue;
+            GObject* go = engine.GetGameObject(handles[i]);
+            if (go == nullptr) {
+                // destroyed by gameplay while loaded; don't bring it back
+                status[i] = GONE;
+            } else {
+                if (i == root)
+                    saved[root] = Saved { go->GetPosition() + engine.GetWorldOrigin(), go->GetRotEuler(),
+                                          go->GetVelocity(), true };
+                engine.DestroyGameObject(handles[i]);
+                status[i] = ABSENT;
+            }
+            handles[i] = GObjectHandle();
+            resident--;
+        }
+    }
+
+    void kSceneStreamer::Rehome(Cell& cell, GEngine& engine, std::vector<std::pair<uint32_t, glm::dvec3>>& moves) {
+        uint64_t key = PackCoord(cell.coord);
+        for (size_t r = 0; r < cell.roots.size();) {
+            uint32_t root = cell.roots[r];
+            GObject* go = (status[root] == RESIDENT && (scene.GetEntity(root).flags & SceneFormat::ENTITY_PHYSICS))
+                          ? engine.GetGameObject(handles[root]) : nullptr;
+            glm::dvec3 pos = (go != nullptr) ? go->GetPosition() + engine.GetWorldOrigin() : glm::dvec3(0.0);
+            if (go != nullptr && KeyOf(pos) != key) {
+                moves.emplace_back(root, pos);
+                cell.roots[r] = cell.roots.back();
+                cell.roots.pop_back();
+                continue;
+            }
+            r++;
+        }
+    }
+
+    void kSceneStreamer::Update(GEngine& engine, Renderer& renderer) {
+        if (!started) return;
+        FP_PROFILE_FUNCTION();
+        focusPoints.clear();
+        for (const auto& focus : focuses) {
+            focusPoints.push_back(focus() + engine.GetWorldOrigin());
+        }
+
+        uint32_t budget = spawnBudget;
+        std::vector<std::pair<uint32_t, glm::dvec3>> moves;
+        for (auto& entry : cells) {
+            Cell& cell = entry.second;
+            double distance = FocusDistance(cell);
+            switch (cell.state) {
+                case UNLOADED: {
+                    if (distance <= loadRadius && !cell.roots.empty()) {
+                        cell.state = LOADING;
+                        cell.cursor = 0;
+                    }
+                    break;
+                }
+                case LOADING:
+                case LOADED: {
+                    if (distance > unloadRadius) {
+                        for (uint32_t root : cell.roots) {
+                            UnloadTree(root, engine);
+                        }
+                        cell.state = UNLOADED;
+                        break;
+                    }
+                    if (cell.state == LOADED) {
+                        Rehome(cell, engine, moves);
+                        break;
+                    }
+                    while (budget > 0 && cell.cursor < cell.roots.size()) {
+                        uint32_t root = cell.roots[cell.cursor++];
+                        if (status[root] == ABSENT)
+                            budget -= glm::min(budget, SpawnTree(root, engine, renderer, RESIDENT));
+                    }
+                    if (cell.cursor >= cell.roots.size())
+                        cell.state = LOADED;
+                    break;
+                }
+            }
+        }
+
+        // (new cells may be made here, so this waits until the walk over the map is done)
+        for (const auto& move : moves) {
+            Cell& cell = CellAt(CoordOf(move.second));
+            cell.roots.push_back(move.first);
+            if (cell.state != LOADED && cell.state != LOADING)
+                UnloadTree(move.first, engine);
+        }
+    }
+
+    size_t kSceneStreamer::LoadedCellCount() const {
+        size_t loaded = 0;
+        for (const auto& entry : cells) {
+            loaded += (entry.second.state == LOADED) ? 1 : 0;
+        }
+        return loaded;
+    }
+}
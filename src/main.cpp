@@ -3,11 +3,15 @@
 #include <SDL2/SDL.h>
 #include <glm/gtx/string_cast.hpp>
 #include "GEngine.h"
+#include "kSceneStreamer.h"
+#include "util/Profiler.h"
 #include <iostream>
 
 using namespace kVox;
 
 int MOUSE_X_OLD, MOUSE_Y_OLD = 0;
+/** binary scene to load (compiled from its .kvs text with fp_scenec) */
+std::string SCENE_PATH = "assets/scenes/stargazer.kvsb";
 
 int game_init(GEngine& engine, Renderer& renderer);
 
@@ -27,7 +31,30 @@ int main(int argc, char *argv[]) {
 
     GEngine& engine = GEngine::Instance();
 
-    bool init = engine.Init();
+    // parse engine options
+    EngineConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pipelined") {
+            config.pipelined = true;
+        } else if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            config.maxTicks = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--stats" && i + 1 < argc) {
+            config.statsPath = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            config.recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            config.replayPath = argv[++i];
+        } else if (arg == "--scene" && i + 1 < argc) {
+            SCENE_PATH = argv[++i];
+        } else if (arg == "--rebase" && i + 1 < argc) {
+            config.rebaseDistance = std::strtod(argv[++i], nullptr);
+        }
+    }
+
+    bool init = engine.Init(config);
     if (init) {
         Renderer& renderer = engine.GetRenderer();
         // setup simple shaders and drawables
@@ -41,258 +68,79 @@ int main(int argc, char *argv[]) {
 
     engine.Shutdown();
 
-    return 0;
+    return engine.GetExitCode();
 }
 
 ////////////////////////////
 
-void setupCameras(Renderer& renderer);
-bool setupGObjects(GEngine& engine, Renderer& renderer) {
-//    float tri_verts[] = {
-//            0.0f,  0.5f,  0.0f,     // top
-//            0.5f, -0.5f,  0.0f,     // right
-//            -0.5f, -0.5f,  0.0f     // left
-//    };
-//    // test triangle
-//    renderer.AddDrawable(new VAO(tri_verts, 9, "simple", renderer));
-
-    // add a light gray torus as the spaceship base and player object
-    auto* torus = new PlayerGO(renderer);
-    engine.AddGameObject("torus", torus);
-    VAO* vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::TORUS);
-    vao->material.materialAmbColor = glm::vec3(0.1);
-    vao->material.materialDiffColor = glm::vec3(0.9);
-    vao->material.materialSpecColor = glm::vec3(1.0);
-    vao->material.materialShininess = 0.4;
-    torus->SetVAO(vao);
-    torus->UpdateModelMtx();
-    torus->EnablePhys(); // enable physics for the torus
-    renderer.AddDrawable(vao);
-
-    // add a cone pointing forwards to the spaceship
-    auto* cone = new GObject(renderer);
-    engine.AddGameObject("torus_cone", cone);
-    // cone is child of spaceship
-    cone->parent = torus;
-    torus->children.insert(cone);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CONE);
-    vao->material.materialAmbColor = glm::vec3(0.1);
-    vao->material.materialDiffColor = glm::vec3(0.9, 0.7, 0.9);
-    vao->material.materialSpecColor = glm::vec3(1.0);
-    vao->material.materialShininess = 0.4;
-    cone->SetVAO(vao);
-    cone->SetRotation(glm::radians(90.0),0.0,0.0,false);
-    cone->SetPosition(0.0,0.0,1.0,false);
-    cone->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-
-    // add a smaller cube attached to the spaceship's rear
-    auto* cube = new GObject(renderer);
-    engine.AddGameObject("torus_cube", cube);
-    // cube is child of spaceship
-    cube->parent = torus;
-    torus->children.insert(cube);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CUBE);
-    vao->material.materialAmbColor = glm::vec3(0.1);
-    vao->material.materialDiffColor = glm::vec3(0.9, 0.7, 0.9);
-    vao->material.materialSpecColor = glm::vec3(1.0);
-    vao->material.materialShininess = 0.4;
-    cube->SetVAO(vao);
-    cube->SetRotation(glm::radians(90.0),0.0,0.0,false);
-    cube->SetPosition(0.0,0.0,-1.0,false);
-    cube->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-
-    // add an invisible object for camera anchoring
-    auto* cameraAnchor = new GObject(renderer);
-    engine.AddGameObject("torus_cam", cameraAnchor);
-    cameraAnchor->parent = torus;
-    torus->children.insert(cameraAnchor);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CUBE);
-    vao->material.materialAmbColor = glm::vec3(0.1);
-    vao->material.materialDiffColor = glm::vec3(0.9, 0.7, 0.9);
-    vao->material.materialSpecColor = glm::vec3(1.0);
-    vao->material.materialShininess = 0.4;
-    cameraAnchor->SetVAO(vao);
-    cameraAnchor->SetPosition(0.0,0.0,3.0,false);
-    cameraAnchor->SetScale(glm::vec3(0)); // invisible
-    cameraAnchor->UpdateModelMtx();
-    renderer.AddDrawable(vao);
+/** Spins a goal ring until it gets collected. */
+kTask SpinGoal(GObjectHandle handle) {
+    GEngine& engine = GEngine::Instance();
+    double rotVel = glm::radians(90.0); // 90 deg/s
+    for (;;) {
+        co_await NextFrame();
+        GObject* goal = engine.GetGameObject(handle);
+        if (goal == nullptr) co_return;
+        goal->SetRotation(0.0, 0.0, goal->GetRotEuler().z + (rotVel * engine.GetTickDelta()));
+    }
+}
 
-    // cube rotates based on how fast the spaceship is going
-    // also, things will jitter more the faster you go...
-    auto* cubeAnim = new AnimHandler_t([](double interp) -> void {
-        GEngine& engine = GEngine::Instance();
-        Renderer& renderer = engine.GetRenderer();
-        double rotMaxVel = glm::radians(90.0); // 90 deg/s
-        GObject* cube = engine.GetGameObject("torus_cube");
-        double _interp = glm::clamp(glm::length(cube->parent->GetVelocity()) / 1000.0, 0.0, 1.0);
+/** Spins the spaceship's rear cube, and jitters the scene, harder the faster the ship goes. */
+kTask SpinShipCube(GObject* cube) {
+    GEngine& engine = GEngine::Instance();
+    Renderer& renderer = engine.GetRenderer();
+    double rotMaxVel = glm::radians(90.0); // 90 deg/s
+    for (;;) {
+        co_await NextFrame();
+        double _interp = glm::clamp(glm::length(cube->GetParent()->GetVelocity()) / 1000.0, 0.0, 1.0);
         renderer.UpdateShaderFloat("lighting","jitterStrength",_interp*10.0);
+        if (_interp == 0.0) {
+            // parked: nothing to spin until the ship gets moving again
+            co_await Until([cube]() { return glm::length(cube->GetParent()->GetVelocity()) > 0.0; });
+            continue;
+        }
         glm::vec3 rot = cube->GetRotEuler();
         cube->SetRotation(rot.x-(rotMaxVel*_interp*0.3),rot.y+(rotMaxVel*_interp),rot.z+(rotMaxVel*_interp*0.3));
-        cube->parent->UpdateModelMtx();
-    });
-    auto cubeAnimHandler = std::make_shared<kStateAnimHandler>(*cubeAnim);
-    engine.RegisterAnim(cubeAnimHandler);
-
-    /////////////////////////////////////////////
-    // set the main camera to look at this object
-    Camera* mainCam = renderer.GetCameraWithName("main");
-    mainCam->SetTargetLookAt(torus->GetPosAsPtr());
-    mainCam->SetLookingAtTgt(true);
-    mainCam->camDist = 4;
-    mainCam->RecomputeCamPos();
-    // position the other camera correctly
-    Camera* ssCam = renderer.GetCameraWithName("ss_front");
-    ssCam->SetTargetLookAt(cameraAnchor->GetLocalPosPtr());
-    ssCam->orientLocked = true;
-    ssCam->orientPos = cameraAnchor->GetOrientAsPtr();
-    ssCam->camDist = 0.001;
-    ssCam->SetLookingAtTgt(true);
-    ssCam->RecomputeCamPos();
-    /////////////////////////////////////////////
-    // add an enemy ring object that flies towards the player
-    auto* enemy1 = new EnemyGO(renderer);
-    engine.AddGameObject("enemy_1", enemy1);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(31.0/255.0,0.0/255.0,0.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(192.0/255.0,3.0/255.0,3.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(220.0/255.0,14.0/255.0,14.0/255.0);
-    vao->material.materialShininess = 0.3;
-    enemy1->SetVAO(vao);
-    enemy1->SetScale(glm::vec3(2.0),false);
-    enemy1->SetPosition(glm::vec3(600.0,400.0,-1200.0), false);
-    enemy1->UpdateModelMtx();
-    enemy1->EnablePhys();
-    renderer.AddDrawable(vao);
+    }
+}
 
-    // add another enemy ring object that flies towards the player
-    auto* enemy2 = new EnemyGO(renderer);
-    engine.AddGameObject("enemy_2", enemy2);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(31.0/255.0,0.0/255.0,0.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(192.0/255.0,3.0/255.0,3.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(220.0/255.0,14.0/255.0,14.0/255.0);
-    vao->material.materialShininess = 0.3;
-    enemy2->SetVAO(vao);
-    enemy2->SetScale(glm::vec3(2.0),false);
-    enemy2->SetPosition(glm::vec3(400.0,-400.0,-700.0), false);
-    enemy2->UpdateModelMtx();
-    enemy2->EnablePhys();
-    renderer.AddDrawable(vao);
+/** Keeps the scene streamed in around the player and the active camera. */
+kTask StreamScene(kSceneStreamer* streamer) {
+    GEngine& engine = GEngine::Instance();
+    for (;;) {
+        co_await NextFrame();
+        streamer->Update(engine, engine.GetRenderer());
+    }
+}
 
-    // add a goal ring in the center of the giant red gas giant
-    auto* goal1 = new GoalGO(renderer);
-    engine.AddGameObject("goal_1", goal1);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(0.0/255.0,18.0/255.0,18.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(3.0/255.0,192.0/255.0,192.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(14.0/255.0,220.0/255.0,220.0/255.0);
-    vao->material.materialShininess = 0.3;
-    goal1->SetVAO(vao);
-    goal1->SetScale(glm::vec3(2.0),false);
-    goal1->SetPosition(glm::vec3(600.0,0.0,0.0), false);
-    goal1->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-    // add a goal ring in the center of the teal gas planet
-    auto* goal2 = new GoalGO(renderer);
-    engine.AddGameObject("goal_2", goal2);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(0.0/255.0,18.0/255.0,18.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(3.0/255.0,192.0/255.0,192.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(14.0/255.0,220.0/255.0,220.0/255.0);
-    vao->material.materialShininess = 0.3;
-    goal2->SetVAO(vao);
-    goal2->SetScale(glm::vec3(2.0),false);
-    goal2->SetPosition(glm::vec3(400.0,-400.0,-700.0), false);
-    goal2->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-    // add a goal ring in the center of the hollow cylinder
-    auto* goal3 = new GoalGO(renderer);
-    engine.AddGameObject("goal_3", goal3);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(0.0/255.0,18.0/255.0,18.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(3.0/255.0,192.0/255.0,192.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(14.0/255.0,220.0/255.0,220.0/255.0);
-    vao->material.materialShininess = 0.3;
-    goal3->SetVAO(vao);
-    goal3->SetScale(glm::vec3(2.0),false);
-    goal3->SetPosition(glm::vec3(600.0,400.0,-1200.0), false);
-    goal3->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-    // goal rings rotate
-    auto* goalAnim = new AnimHandler_t([](double tDelta) -> void {
-        GEngine& engine = GEngine::Instance();
-        Renderer& renderer = engine.GetRenderer();
-        double rotVel = glm::radians(90.0); // 90 deg/s
-        for (int i = 1; i < 4; i++) {
-            GObject *goal = engine.GetGameObject("goal_"+std::to_string(i));
-            if (goal == nullptr) continue;
-            goal->SetRotation(0.0, 0.0, goal->GetRotEuler().z + (rotVel * tDelta));
-            goal->UpdateModelMtx();
-        }
+/** Starts streaming the scene's objects and cameras, along with the scripts that bring them to life. */
+bool setupScene(GEngine& engine, Renderer& renderer) {
+    // lives as long as the game does
+    auto* streamer = new kSceneStreamer();
+    // goal rings rotate, whenever they're (re)loaded
+    streamer->onSpawn = [&engine](GObject* go) {
+        if (dynamic_cast<GoalGO*>(go) != nullptr)
+            engine.GetScheduler().Start(SpinGoal(go->GetHandle()));
+    };
+    if (!streamer->Load(SCENE_PATH) || !streamer->Start(engine, renderer)) {
+        fprintf(stderr, "Couldn't set up the scene from %s\n", SCENE_PATH.c_str());
+        return false;
+    }
+    GObjectHandle ship = engine.FindGameObject("torus");
+    streamer->AddFocus([&engine, ship, last = glm::dvec3(0.0)]() mutable {
+        GObject* go = engine.GetGameObject(ship);
+        if (go != nullptr) last = go->GetRenderPos();
+        return last;
     });
-    auto goalAnimHandler = std::make_shared<kAnimHandler>(*goalAnim);
-    engine.RegisterAnim(goalAnimHandler);
-
-    /////////////////////////////////////////////
-    // add a planet using a scaled sphere
-    auto* planet1 = new GObject(renderer);
-    engine.AddGameObject("scarlet", planet1);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::SPHERE);
-    vao->material.materialAmbColor = glm::vec3(31.0/255.0,12.0/255.0,15.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(227.0/255.0,89.0/255.0,112.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(1.0,230.0/255.0,234.0/255.0);
-    vao->material.materialShininess = 0.2;
-    planet1->SetVAO(vao);
-    planet1->SetScale(glm::vec3(16.0),false);
-    planet1->SetPosition(glm::vec3(600.0,0.0,0.0),false);
-    planet1->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-
-    // add another planet using a scaled sphere
-    auto* planet2 = new GObject(renderer);
-    engine.AddGameObject("teal", planet2);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::SPHERE);
-    vao->material.materialAmbColor = glm::vec3(10.0/255.0,36.0/255.0,30.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(217.0/255.0,255.0/255.0,247.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(1.0,230.0/255.0,234.0/255.0);
-    vao->material.materialShininess = 0.2;
-    planet2->SetVAO(vao);
-    planet2->SetScale(glm::vec3(8.0),false);
-    planet2->SetPosition(glm::vec3(400.0,-400.0,-700.0),false);
-    planet2->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-
-    // add a small sphere that can represent the star
-    auto* star = new GObject(renderer);
-    engine.AddGameObject("star", star);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::SPHERE);
-    vao->material.materialAmbColor = glm::vec3(1.0);
-    vao->material.materialDiffColor = glm::vec3(1.0);
-    vao->material.materialSpecColor = glm::vec3(1.0);
-    vao->material.materialShininess = 0.001;
-    star->SetVAO(vao);
-    star->SetScale(glm::vec3(16.0),false);
-    star->SetPosition(glm::vec3(20000.0),false);
-    star->UpdateModelMtx();
-    renderer.AddDrawable(vao);
-
-    // add another planet using a scaled cylinder
-    auto* planet3 = new GObject(renderer);
-    engine.AddGameObject("purple", planet3);
-    vao = new PrimitiveVAO(nullptr, 0, "lighting", renderer, PrimitiveType::CYLINDER);
-    vao->material.materialAmbColor = glm::vec3(14.0/255.0,7.0/255.0,30.0/255.0);
-    vao->material.materialDiffColor = glm::vec3(129.0/255.0,118.0/255.0,247.0/255.0);
-    vao->material.materialSpecColor = glm::vec3(221.0,1.0/255.0,234.0/255.0);
-    vao->material.materialShininess = 0.2;
-    planet3->SetVAO(vao);
-    planet3->SetScale(glm::vec3(9.0),false);
-    planet3->SetRotation(30.0, 10.0, 2.0, false);
-    planet3->SetPosition(glm::vec3(600.0,400.0,-1200.0),false);
-    planet3->UpdateModelMtx();
-    renderer.AddDrawable(vao);
+    streamer->AddFocus([&renderer]() { return renderer.ActiveCamera()->camPos; });
+    engine.GetScheduler().Start(StreamScene(streamer));
 
+    // cube rotates based on how fast the spaceship is going
+    // also, things will jitter more the faster you go...
+    GObject* cube = engine.GetGameObject(engine.FindGameObject("torus_cube"));
+    if (cube != nullptr && cube->GetParent() != nullptr) {
+        engine.GetScheduler().Start(SpinShipCube(cube));
+    }
     return true;
 }
 
@@ -305,7 +153,7 @@ int game_init(GEngine& engine, Renderer& renderer) {
     printf("------------------------------------\n");
     printf("           Stargazer v0.4           \n");
     printf("------------------------------------\n");
-    printf(" ESC : quit the game (likely crash) \n");
+    printf(" ESC : quit the game                \n");
     printf("  W  : thrust in forward direction  \n");
     printf("  S  : thrust in reverse direction  \n");
     printf("  A  : yaw spacecraft left          \n");
@@ -327,17 +175,16 @@ int game_init(GEngine& engine, Renderer& renderer) {
     printf("------------------------------------\n");
 
 
-    // setup cameras (THERE MUST ALWAYS BE AT LEAST ONE)
-    setupCameras(renderer);
-    // setup game objects
-    setupGObjects(engine, renderer);
+    // setup game objects and cameras (THERE MUST ALWAYS BE AT LEAST ONE)
+    if (!setupScene(engine, renderer)) { return 1; }
 
     /// ** setup inputs ** ///
 
     // register a default "close the program using the escape key" listener
     KeyInputCallback_t* escCallback = new KeyInputCallback_t([](const bool isPressed, const SDL_KeyboardEvent key) -> void {
-        if(isPressed && key.keysym.sym == SDLK_ESCAPE) {
-            GEngine::Instance().Shutdown();
+        // a replay stops by itself where the recording did
+        if(isPressed && key.keysym.sym == SDLK_ESCAPE && !GEngine::Instance().IsReplaying()) {
+            GEngine::Instance().RequestQuit(0);
         }
     });
     auto quitEscListener = std::make_shared<kKeyInputListener>( *escCallback );
@@ -365,10 +212,10 @@ int game_init(GEngine& engine, Renderer& renderer) {
     engine.RegisterMouseMotionListener(mMotionListener);
 
     // register spaceship movement listener for user input
-    KeyInputCallback_t* movementCB = new KeyInputCallback_t([](const bool isPressed, const SDL_KeyboardEvent key) -> void {
+    KeyInputCallback_t* movementCB = new KeyInputCallback_t([ship = engine.FindGameObject("torus")](const bool isPressed, const SDL_KeyboardEvent key) -> void {
         GEngine& engine = GEngine::Instance();
         Renderer& renderer = engine.GetRenderer();
-        GObject* spaceship = engine.GetGameObject("torus");
+        GObject* spaceship = engine.GetGameObject(ship);
         if (spaceship == nullptr) return;
 
         glm::vec3 orientation = spaceship->GetOrientation();
@@ -453,6 +300,33 @@ int game_init(GEngine& engine, Renderer& renderer) {
                 }
                 break;
             }
+            case SDLK_F9: {
+                if (isPressed && !key.repeat && !engine.IsReplaying()) {
+#ifdef FP_PROFILE
+                    // dump the frame profiler's recent zones
+                    if (util::Profiler::Instance().DumpChromeTrace("trace.json"))
+                        printf("\nWrote profiler trace to trace.json\n");
+#else
+                    printf("\nThe frame profiler isn't built in (configure with -DFP_PROFILE=ON)\n");
+#endif
+                }
+                break;
+            }
+            case SDLK_F10: {
+                if (isPressed && !key.repeat && !engine.IsReplaying()) {
+                    // dump frame statistics and print a quick summary
+                    const util::FrameStats& stats = engine.GetFrameStats();
+                    printf("\nFrame ms: p50 %.2f, p95 %.2f, p99 %.2f, max %.2f; %llu hitches in %llu frames\n",
+                           stats.Percentile(util::FrameStats::FRAME_TIME, 50.0),
+                           stats.Percentile(util::FrameStats::FRAME_TIME, 95.0),
+                           stats.Percentile(util::FrameStats::FRAME_TIME, 99.0),
+                           stats.Max(util::FrameStats::FRAME_TIME),
+                           (unsigned long long)stats.HitchCount(), (unsigned long long)stats.FrameCount());
+                    if (engine.DumpFrameStats("frame_stats"))
+                        printf("Wrote frame statistics to frame_stats.csv and frame_stats.json\n");
+                }
+                break;
+            }
             default: {
                 break;
             }
@@ -463,27 +337,3 @@ int game_init(GEngine& engine, Renderer& renderer) {
 
     return 0;
 }
-
-void setupCameras(Renderer& renderer) {
-    // setup a main camera
-    auto* camera = new Camera();
-    camera->camPos = glm::vec3(-1,0,0);
-    camera->cameraTheta = glm::pi<double>() / 2.8;
-    camera->cameraPhi = 0.02;
-    camera->camDist = 5.0;
-    camera->canLook = true;
-    camera->SetTargetLookAt(renderer.GetOrigin());
-    camera->RecomputeCamPos();
-    renderer.AddCamera("main", camera);
-    renderer.SetActiveCamera("main");
-
-    // setup a forward-facing camera for the spaceship
-    camera = new Camera();
-    camera->camPos = glm::vec3(0.0,0.0,1.05);
-    camera->cameraTheta = 0.0;
-    camera->cameraPhi = glm::pi<double>() / 2.0;
-    camera->camDist = 0.005;
-    camera->SetTargetLookAt(renderer.GetOrigin());
-    camera->RecomputeCamPos();
-    renderer.AddCamera("ss_front", camera);
-}
\ No newline at end of file
@@ -0,0 +1,12 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <renderer/Camera.h>
+
+namespace kVox {
+
+    util::BlockPool& Camera::Pool() { return util::ImmortalPool<Camera>(); }
+    void* Camera::operator new(std::size_t size) { return Pool().Allocate(size); }
+    void Camera::operator delete(void* ptr, std::size_t size) { Pool().Free(ptr, size); }
+}
@@ -0,0 +1,126 @@
+//
+// Created by snaki on 12/17/2020.
+//
+
+#include <renderer/GpuTimer.h>
+#include <util/Profiler.h>
+
+namespace kVox {
+
+    void GpuTimer::Init() {
+        // timestamp queries are core since 3.3, but don't count on it
+        if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+            ready = false;
+            return;
+        }
+        for (auto& frame : frames) {
+            glGenQueries(PASS_COUNT, frame.begin);
+            glGenQueries(PASS_COUNT, frame.end);
+            frame.pending = false;
+        }
+        hasDebugGroups = GLEW_KHR_debug;
+
+        // line the GPU clock up with the profiler's
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        clockOffset = static_cast<int64_t>(gpuNow) - static_cast<int64_t>(util::Profiler::Instance().Now());
+#ifdef FP_PROFILE
+        track = util::Profiler::Instance().CreateTrack("GPU");
+#endif
+        ready = true;
+    }
+
+    void GpuTimer::Shutdown() {
+        if (!ready) return;
+        for (auto& frame : frames) {
+            glDeleteQueries(PASS_COUNT, frame.begin);
+            glDeleteQueries(PASS_COUNT, frame.end);
+        }
+        ready = false;
+    }
+
+    bool GpuTimer::Resolve(int slot) {
+        FrameQueries& frame = frames[slot];
+        // the last query issued in the frame finishes last; if it's in, they all are
+        int last = -1;
+        for (int p = 0; p < PASS_COUNT; p++) {
+            if (frame.used[p]) last = p;
+        }
+        if (last < 0) {
+            frame.pending = false;
+            return true;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.end[last], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE)
+            return false;
+
+        GLuint64 frameBegin = UINT64_MAX, frameEnd = 0;
+        for (int p = 0; p < PASS_COUNT; p++) {
+            if (!frame.used[p]) continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.begin[p], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.end[p], GL_QUERY_RESULT, &end);
+            passTimes[p] = (end - begin) / 1.0e6;
+            if (begin < frameBegin) frameBegin = begin;
+            if (end > frameEnd) frameEnd = end;
+            if (track != nullptr) {
+                util::Profiler::Instance().Record(*track, PassName(static_cast<Pass>(p)),
+                                                  static_cast<uint64_t>(static_cast<int64_t>(begin) - clockOffset),
+                                                  static_cast<uint64_t>(static_cast<int64_t>(end) - clockOffset));
+            }
+        }
+        frameTime = (frameEnd - frameBegin) / 1.0e6;
+        frame.pending = false;
+        return true;
+    }
+
+    void GpuTimer::BeginFrame() {
+        if (!ready) return;
+        // collect everything that's finished, oldest first
+        for (int i = 1; i <= FRAMES_IN_FLIGHT; i++) {
+            int slot = (current + i) % FRAMES_IN_FLIGHT;
+            if (frames[slot].pending && !Resolve(slot))
+                break;
+        }
+        current = (current + 1) % FRAMES_IN_FLIGHT;
+        // if the GPU is so far behind that this slot still isn't done, its results are dropped
+        FrameQueries& frame = frames[current];
+        frame.pending = false;
+        for (bool& used : frame.used) {
+            used = false;
+        }
+    }
+
+    void GpuTimer::BeginPass(Pass pass) {
+        if (!ready) return;
+        if (hasDebugGroups)
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, static_cast<GLuint>(pass), -1, PassName(pass));
+        glQueryCounter(frames[current].begin[pass], GL_TIMESTAMP);
+    }
+
+    void GpuTimer::EndPass(Pass pass) {
+        if (!ready) return;
+        glQueryCounter(frames[current].end[pass], GL_TIMESTAMP);
+        frames[current].used[pass] = true;
+        if (hasDebugGroups)
+            glPopDebugGroup();
+    }
+
+    void GpuTimer::EndFrame() {
+        if (!ready) return;
+        frames[current].pending = true;
+    }
+
+    double GpuTimer::GetPassTime(Pass pass) const { return passTimes[pass]; }
+    double GpuTimer::GetFrameTime() const { return frameTime; }
+
+    const char* GpuTimer::PassName(Pass pass) {
+        switch (pass) {
+            case SCENE:  return "GPU Scene";
+            case SKYBOX: return "GPU Skybox";
+            case POST:   return "GPU Post";
+            default:     return "GPU";
+        }
+    }
+}
@@ -0,0 +1,62 @@
+//
+// Created by snaki on 12/15/2020.
+//
+
+#include <renderer/RenderSnapshot.h>
+
+namespace kVox {
+
+    RenderSnapshot& RenderSnapshotBuffer::BeginWrite() {
+        std::unique_lock<std::mutex> guard(lock);
+        // a slot is free if it's neither being drawn nor waiting to be drawn
+        changed.wait(guard, [this]() {
+            return closed || (0 != reading && 0 != pending) || (1 != reading && 1 != pending);
+        });
+        writing = (0 != reading && 0 != pending) ? 0 : 1;
+        return slots[writing];
+    }
+
+    void RenderSnapshotBuffer::Publish() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (writing == NONE) return;
+            // an unread older snapshot is simply superseded
+            pending = writing;
+            writing = NONE;
+        }
+        changed.notify_all();
+    }
+
+    const RenderSnapshot* RenderSnapshotBuffer::Acquire() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this]() { return closed || pending != NONE; });
+        if (closed) return nullptr;
+        reading = pending;
+        pending = NONE;
+        guard.unlock();
+        changed.notify_all();
+        return &slots[reading];
+    }
+
+    void RenderSnapshotBuffer::Release() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            reading = NONE;
+        }
+        changed.notify_all();
+    }
+
+    void RenderSnapshotBuffer::Close() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+    void RenderSnapshotBuffer::Reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = false;
+        writing = pending = reading = NONE;
+    }
+}
@@ -9,6 +9,7 @@
 #endif
 
 #include <renderer/Renderer.h>
+#include <util/Profiler.h>
 
 #include <CSCI441/objects.hpp>
 #include <glm/gtx/string_cast.hpp>
@@ -83,7 +84,7 @@ namespace kVox {
     }
 
     bool Renderer::Init() {
-        origin = new glm::vec3(0.0);
+        origin = new glm::dvec3(0.0);
         // init video subsystem
         if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) { return false; }
 
@@ -111,6 +112,9 @@ namespace kVox {
         // debug: init simple shaders
         // if (!InitShaders()) { return false; }
         if (!InitLightingShader()) { return false; }
+
+        // GPU pass timing
+        gpuTimer.Init();
         // debug: init simple triangle to viewport
 //        float tri_verts[] = {
 //                0.0f,  0.5f,  0.0f,     // top
@@ -125,6 +129,13 @@ namespace kVox {
         return true;
     }
 
+    void Renderer::InitHeadless() {
+        origin = new glm::dvec3(0.0);
+        headless = true;
+    }
+
+    bool Renderer::IsHeadless() const { return headless; }
+
     void Renderer::InitOpenGL() {
         // tell SDL we want to use OpenGL 4.1
         // these attributes must be set before creating the window.
@@ -161,7 +172,7 @@ namespace kVox {
         auto* mShader = new Shader("assets/shaders/simple.v.glsl", "assets/shaders/simple.f.glsl");
         if (!mShader->IsGood()) { return false; }
 
-        shaders.emplace(std::make_pair("simple", mShader));
+        AddShader("simple", mShader);
 
         return true;
     }
@@ -173,6 +184,7 @@ namespace kVox {
 
     // helper for SetupSkybox
     GLuint loadCubemap(std::vector<std::string> faces) {
+        FP_PROFILE_FUNCTION();
         GLuint texId;
         glGenTextures(1, &texId);
         glBindTexture(GL_TEXTURE_CUBE_MAP, texId);
@@ -210,13 +222,14 @@ namespace kVox {
     }
 
     bool Renderer::InitLightingShader() {
+        FP_PROFILE_FUNCTION();
         // init textured phong shader
 //        auto* mShader = new Shader("assets/shaders/phong.v.glsl", "assets/shaders/phong.f.glsl",\
                                     nullptr, nullptr, nullptr);
         auto* mShader = new Shader("assets/shaders/blinn.v.glsl", "assets/shaders/blinn.f.glsl",\
                                     nullptr, nullptr, "assets/shaders/blinn.g.glsl");
         if (!mShader->IsGood()) { return false; }
-        shaders.emplace(std::make_pair("lighting", mShader));
+        AddShader("lighting", mShader);
         SetActiveShader("lighting");
 
         // assign uniforms, they get sent to this shader
@@ -230,29 +243,12 @@ namespace kVox {
             };
          */
 
-        // directional light direction and color
-        auto dirLightColor = glm::vec3(1.0);
-        auto dirLightDirection = glm::vec3(1.0, 1.0, 1.0);
-        shaderSetInt(mShader->GetProgramHandle(), "lights[0].lightType", 1);
-        shaderSetVec3(mShader->GetProgramHandle(), "lights[0].lightDir", dirLightDirection);
-        shaderSetVec3(mShader->GetProgramHandle(), "lights[0].lightColor", dirLightColor);
-        // point light positions and colors
-        glm::vec3 pointLightPositions[] = {
-                glm::vec3( 2.0,  1.0,  -2.0),
-                glm::vec3(-12.0,  8.0, 8.0)
-        };
-        glm::vec3 pointLightColors[] = {
-                glm::vec3(0.8, 0.0, 0.3),
-                glm::vec3(0.0)
-        };
-        for (int i = 1; i < 2; i++) {
-            shaderSetInt(mShader->GetProgramHandle(), std::string("lights[") + std::to_string(i) + std::string("].lightType"),
-                         0);
-            shaderSetVec3(mShader->GetProgramHandle(), std::string("lights[") + std::to_string(i) + std::string("].lightPos"),
-                          pointLightPositions[i]);
-            shaderSetVec3(mShader->GetProgramHandle(), std::string("lights[") + std::to_string(i) + std::string("].lightColor"),
-                          pointLightColors[i]);
-        }
+        // directional light direction and color (uploaded with the first frame)
+        LightDesc dirLight;
+        dirLight.type = DIRECTIONAL_LIGHT;
+        dirLight.dir = glm::vec3(1.0, 1.0, 1.0);
+        dirLight.color = glm::vec3(1.0);
+        AddLight(dirLight);
 
         glEnableVertexAttribArray(mShader->attributes.vPos);
         glVertexAttribPointer(mShader->attributes.vPos, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormal), nullptr);
@@ -262,7 +258,7 @@ namespace kVox {
 
         mShader = new Shader("assets/shaders/skybox.v.glsl", "assets/shaders/skybox.f.glsl");
         if (!mShader->IsGood()) { return false; }
-        shaders.emplace(std::make_pair("skybox", mShader));
+        AddShader("skybox", mShader);
 
         ////////////////////////////////////////////
         /// next: skybox
@@ -322,7 +318,7 @@ namespace kVox {
         // next, let's set up our post-processing shader
         auto* ppShader = new Shader("assets/shaders/pp.v.glsl", "assets/shaders/pp.f.glsl");
         if (!ppShader->IsGood()) { return false; }
-        shaders.emplace(std::make_pair("post", ppShader));
+        AddShader("post", ppShader);
         SetActiveShader("post");
         // initialize render/frame buffer objects
         glGenFramebuffers(1, &FBO);
@@ -403,19 +399,27 @@ namespace kVox {
             }
         }
         drawables.clear();
+        // as well as any that were waiting to be retired
+        DeleteRetiredDrawables(UINT64_MAX);
         // clean up cameras that were left to us
         for (const auto& camera : cameras) {
             delete camera.second;
         }
         cameras.clear();
+        // every drawable and camera is gone: their pools' memory goes back in one go
+        VAO::Pool().Release();
+        Camera::Pool().Release();
         // clean up shaders that were left to us
         for (const auto & shader : shaders) {
             delete shader.second;
         }
         shaders.clear();
         // delete library VBOs/VAOs
-        CSCI441::deleteObjectVBOs();
-        CSCI441::deleteObjectVAOs();
+        if (!headless) {
+            gpuTimer.Shutdown();
+            CSCI441::deleteObjectVBOs();
+            CSCI441::deleteObjectVAOs();
+        }
 
         // clean up our origin
         delete origin;
@@ -441,38 +445,97 @@ namespace kVox {
         glBindFramebuffer(GL_FRAMEBUFFER, 0); // detach fbo
     }
 
-    void Renderer::Render(double deltaTime, bool mRunning) {
-        this->BeginRender();
+    void Renderer::Render(double deltaTime, double interp, bool mRunning) {
+        if (!mRunning) {
+            this->BeginRender();
+            return;
+        }
+        BuildSnapshot(frameSnapshot, deltaTime, interp);
+        Render(frameSnapshot);
+    }
+
+    void Renderer::BuildSnapshot(RenderSnapshot& snapshot, double deltaTime, double interp) {
+        FP_PROFILE_FUNCTION();
+        snapshot.serial = ++lastSnapshotSerial;
+        snapshot.deltaTime = deltaTime;
+        // camera
         this->activeCamera->RecomputeCamPos();
+        glm::dvec3 eye = activeCamera->camPos;
+        snapshot.camPos = eye;
+        snapshot.camLookAt = activeCamera->camLookAt;
+        // post-processing state
+        snapshot.confuse = confuse;
+        snapshot.chaos = chaos;
+        snapshot.shake = shake;
+        // queued uniform writes move over to this frame
+        snapshot.floatWrites.clear();
+        snapshot.floatWrites.swap(pendingFloatWrites);
+        // lights (a handful at most)
+        snapshot.lights = lights;
+        snapshot.lightsVersion = lightsVersion;
+        // drawables, batched by shader (reusing the old batches' storage)
+        snapshot.batches.resize(drawables.size());
+        size_t batchIdx = 0;
+        for (const auto & drawable : drawables) {
+            RenderBatch& batch = snapshot.batches[batchIdx++];
+            batch.shader = drawable.first;
+            batch.items.clear();
+            batch.items.reserve(drawable.second.size());
+            for (VAO* vao : drawable.second) {
+                batch.items.push_back(RenderItem{ vao, vao->GetInterpModelMtx(interp, eye), vao->material });
+            }
+        }
+    }
+
+    void Renderer::Render(const RenderSnapshot& snapshot) {
+        FP_PROFILE_FUNCTION();
+        gpuTimer.BeginFrame();
+        gpuTimer.BeginPass(GpuTimer::SCENE);
+        this->BeginRender();
         ////////// ** BEGIN RENDER STAGE ** //////////
-        if (!mRunning)
-            return;
+        // apply uniform writes the simulation asked for since last frame
+        for (const auto& write : snapshot.floatWrites) {
+            if (!shaders.contains(write.shader)) continue;
+            SetActiveShader(write.shader);
+            shaderSetFloat(shaders.at(_activeShader)->GetProgramHandle(), write.attr, write.val);
+        }
+        if (snapshot.lightsVersion != appliedLightsVersion || snapshot.camPos != appliedLightsEye)
+            ApplyLights(snapshot);
         // get true framebuffer size
         GLint framebufferWidth, framebufferHeight;
         SDL_GetWindowSize( mWindow, &framebufferWidth, &framebufferHeight );
         // update viewport
         glViewport(0, 0, framebufferWidth, framebufferHeight);
         // update projection matrix based on size
-        glm::mat4 projMtx = glm::perspective( 45.0f, (GLfloat)mWindowWidth / (GLfloat)mWindowHeight, 0.001f, 40000.0f);
-        // set up lookAt matrix to position active camera (up is positive y-axis)
-        glm::mat4 viewMtx = glm::lookAt(activeCamera->camPos, activeCamera->camLookAt, glm::vec3(0,1,0));
-
-        for (const auto & drawable : drawables) {
+        glm::mat4 projMtx = glm::perspective( 45.0f, (GLfloat)mWindowWidth / (GLfloat)mWindowHeight, NEAR_PLANE, FAR_PLANE);
+        // set up lookAt matrix to position active camera (up is positive y-axis); model matrices are already
+        // relative to the eye, so the view only turns, with the eye at the origin
+        glm::mat4 viewMtx = glm::lookAt(glm::vec3(0.0), glm::vec3(snapshot.camLookAt - snapshot.camPos), glm::vec3(0,1,0));
+        eyePos = glm::vec3(0.0);
+        uint32_t drawCalls = 0;
+        uint64_t triangles = 0;
+
+        for (const auto & batch : snapshot.batches) {
+            if (batch.items.empty()) continue;
             // for draw batch, activate shader if not done
-            if (drawable.first != _activeShader)
-                SetActiveShader(drawable.first);
+            if (batch.shader != _activeShader)
+                SetActiveShader(batch.shader);
             // then, draw all drawables in this batch
-            for (VAO* vao : drawable.second) {
+            for (const RenderItem& item : batch.items) {
                 // update shader's uniforms as necessary
-                UpdateShaderUniforms(vao->GetModelMtx(), viewMtx, projMtx);
-                glUniform3fv(shaders.at(_activeShader)->uniforms.materialAmbColor,  1, &(vao->material.materialAmbColor[0]));
-                glUniform3fv(shaders.at(_activeShader)->uniforms.materialDiffColor, 1, &(vao->material.materialDiffColor[0]));
-                glUniform3fv(shaders.at(_activeShader)->uniforms.materialSpecColor, 1, &(vao->material.materialSpecColor[0]));
-                glUniform1f(shaders.at(_activeShader)->uniforms.materialShininess, vao->material.materialShininess);
-                vao->Draw();
+                UpdateShaderUniforms(item.modelMtx, viewMtx, projMtx);
+                glUniform3fv(shaders.at(_activeShader)->uniforms.materialAmbColor,  1, &(item.material.materialAmbColor[0]));
+                glUniform3fv(shaders.at(_activeShader)->uniforms.materialDiffColor, 1, &(item.material.materialDiffColor[0]));
+                glUniform3fv(shaders.at(_activeShader)->uniforms.materialSpecColor, 1, &(item.material.materialSpecColor[0]));
+                glUniform1f(shaders.at(_activeShader)->uniforms.materialShininess, item.material.materialShininess);
+                item.vao->Draw();
+                drawCalls += item.vao->DrawCallCount();
+                triangles += item.vao->TriangleCount();
             }
         }
+        gpuTimer.EndPass(GpuTimer::SCENE);
         /// last thing to do: render skybox
+        gpuTimer.BeginPass(GpuTimer::SKYBOX);
         glDepthFunc(GL_LEQUAL);
         SetActiveShader("skybox");
         glm::mat4 skyview = glm::mat4(glm::mat3(viewMtx)); // remove translation data from view matrix
@@ -486,23 +549,43 @@ namespace kVox {
         glDepthFunc(GL_LESS);
         ////////// ** END RENDER STAGE ** //////////
         this->EndRender();
-        cumulativePostTime += deltaTime;
+        gpuTimer.EndPass(GpuTimer::SKYBOX);
+        cumulativePostTime += snapshot.deltaTime;
         // time to handle post-processing
+        gpuTimer.BeginPass(GpuTimer::POST);
         SetActiveShader("post");
         GLuint postShaderID = shaders.at(_activeShader)->GetProgramHandle();
         shaderSetFloat(postShaderID, "time", static_cast<float>(cumulativePostTime));
-        shaderSetInt(postShaderID, "confuse", confuse);
-        shaderSetInt(postShaderID, "chaos", chaos);
-        shaderSetInt(postShaderID, "shake", shake);
+        shaderSetInt(postShaderID, "confuse", snapshot.confuse);
+        shaderSetInt(postShaderID, "chaos", snapshot.chaos);
+        shaderSetInt(postShaderID, "shake", snapshot.shake);
         // render textured quad
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture);
         glBindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glBindVertexArray(0);
+        gpuTimer.EndPass(GpuTimer::POST);
+        gpuTimer.EndFrame();
+        // skybox cube and post-processing quad
+        lastDrawCalls = drawCalls + 2;
+        lastTriangles = triangles + 12 + 2;
+        lastGpuTime = gpuTimer.GetFrameTime();
+
+        // anything retired before this snapshot was built can't be drawn again
+        DeleteRetiredDrawables(snapshot.serial);
+    }
+
+    bool Renderer::AcquireContext() {
+        return SDL_GL_MakeCurrent(mWindow, mContext) == 0;
+    }
+
+    void Renderer::ReleaseContext() {
+        SDL_GL_MakeCurrent(mWindow, nullptr);
     }
 
     void Renderer::Swap() {
+        FP_PROFILE_FUNCTION();
         SDL_GL_SwapWindow(mWindow);
     }
 
@@ -514,6 +597,20 @@ namespace kVox {
         }
         drawables.at(shaderName).insert(obj);
     }
+    void Renderer::AddDrawables(VAO* const* objs, size_t count) {
+        std::set<VAO*>* batch = nullptr;
+        std::string batchShader;
+        for (size_t i = 0; i < count; i++) {
+            // runs of drawables tend to share a shader; only look the batch up again when it changes
+            if (batch == nullptr || objs[i]->GetShader() != batchShader) {
+                batchShader = objs[i]->GetShader();
+                batch = &drawables[batchShader];
+            }
+            // pooled drawables mostly come out in address order, so hint at the end of the set
+            batch->insert(batch->end(), objs[i]);
+        }
+    }
+
     void Renderer::RemoveDrawable(VAO* obj) {
         // we are guaranteed to exist in the map/set, so get and remove the obj by shader name
         std::string shaderName = obj->GetShader();
@@ -521,8 +618,37 @@ namespace kVox {
         drawables.at(shaderName).erase(obj);
     }
 
+    void Renderer::ReleaseDrawable(VAO* obj) {
+        RemoveDrawable(obj);
+        std::lock_guard<std::mutex> guard(retiredLock);
+        retiredDrawables.push_back(RetiredDrawable{ obj, lastSnapshotSerial });
+    }
+
+    void Renderer::DeleteRetiredDrawables(uint64_t serial) {
+        std::vector<VAO*> toDelete;
+        {
+            std::lock_guard<std::mutex> guard(retiredLock);
+            for (auto it = retiredDrawables.begin(); it != retiredDrawables.end(); ) {
+                if (it->lastSerial <= serial) {
+                    toDelete.push_back(it->vao);
+                    it = retiredDrawables.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // GL deletes happen outside the lock
+        for (VAO* vao : toDelete) {
+            delete vao;
+        }
+    }
+
     void Renderer::AddShader(const std::string& name, Shader* shader) {
         shaders[name] = shader;
+        // the depth range never changes, so programs get it once
+        if (shader->uniforms.logDepthCoef != -1)
+            glProgramUniform1f(shader->GetProgramHandle(), shader->uniforms.logDepthCoef,
+                               2.0f / glm::log2(FAR_PLANE + 1.0f));
     }
     void Renderer::RemoveShader(const std::string &name) {
         if (!shaders.contains(name)) { return; }
@@ -569,7 +695,7 @@ namespace kVox {
         glm::mat4 normalMtx = glm::transpose( glm::inverse( modelMtx ) );
 //        std::cout << (glm::to_string(normalMtx)) << std::endl;
         glUniformMatrix4fv(shaders.at(_activeShader)->uniforms.normalMtx, 1, GL_FALSE, &normalMtx[0][0]);
-        glUniform3fv(shaders.at(_activeShader)->uniforms.eyePos, 1, &(activeCamera->camPos[0]));
+        glUniform3fv(shaders.at(_activeShader)->uniforms.eyePos, 1, &(eyePos[0]));
     }
 
     void Renderer::AddCamera(const std::string &name, Camera *camera) {
@@ -589,13 +715,83 @@ namespace kVox {
             return nullptr;
     }
 
-    const glm::vec3* Renderer::GetOrigin() { return origin; }
+    const glm::dvec3* Renderer::GetOrigin() { return origin; }
+
+    void Renderer::ShiftOrigin(const glm::dvec3& offset) {
+        *origin += offset;
+        for (LightDesc& light : lights) {
+            if (light.type != DIRECTIONAL_LIGHT)
+                light.pos += offset;
+        }
+        lightsVersion++;
+        // cameras following a target move with it; free ones are moved here
+        for (auto& camera : cameras) {
+            if (!camera.second->GetLookingAtTgt())
+                camera.second->camPos += offset;
+        }
+        for (auto& drawable : drawables) {
+            for (VAO* vao : drawable.second) {
+                vao->ShiftOrigin(offset);
+            }
+        }
+    }
+
+    const GpuTimer& Renderer::GetGpuTimer() const { return gpuTimer; }
+    uint32_t Renderer::GetLastDrawCalls() const { return lastDrawCalls; }
+    uint64_t Renderer::GetLastTriangles() const { return lastTriangles; }
+    double Renderer::GetLastGpuTime() const { return lastGpuTime; }
 
     int Renderer::GetWindowWidth() const { return mWindowWidth; }
     int Renderer::GetWindowHeight() const { return mWindowHeight; }
 
     void Renderer::UpdateShaderFloat(const std::string &shader, const std::string &attr, double val) {
-        shaderSetFloat(shaders.at(shader)->GetProgramHandle(), attr, static_cast<float>(val));
+        // nothing will ever be drawn
+        if (headless) return;
+        // the simulation may be running away from the GL context; defer the write to the next rendered frame
+        pendingFloatWrites.push_back(ShaderFloatWrite{ shader, attr, static_cast<float>(val) });
+    }
+
+    int Renderer::AddLight(const LightDesc& light) {
+        if (lights.size() >= MAX_LIGHTS) return -1;
+        lights.push_back(light);
+        lightsVersion++;
+        return static_cast<int>(lights.size()) - 1;
+    }
+
+    void Renderer::SetLight(int index, const LightDesc& light) {
+        assert(index >= 0 && static_cast<size_t>(index) < lights.size());
+        lights[index] = light;
+        lightsVersion++;
+    }
+
+    void Renderer::ClearLights() {
+        lights.clear();
+        lightsVersion++;
+    }
+
+    int Renderer::GetLightCount() const { return static_cast<int>(lights.size()); }
+
+    void Renderer::ApplyLights(const RenderSnapshot& snapshot) {
+        if (!shaders.contains("lighting")) return;
+        SetActiveShader("lighting");
+        const ShaderUniforms& uniforms = shaders.at(_activeShader)->uniforms;
+        bool eyeOnly = (snapshot.lightsVersion == appliedLightsVersion);
+        size_t count = glm::min(snapshot.lights.size(), static_cast<size_t>(MAX_LIGHTS));
+        if (!eyeOnly)
+            glUniform1i(uniforms.numLights, static_cast<GLint>(count));
+        for (size_t i = 0; i < count; i++) {
+            const LightDesc& light = snapshot.lights[i];
+            const ShaderUniforms::Light& loc = uniforms.lights[i];
+            glm::vec3 pos = glm::vec3(light.pos - snapshot.camPos);
+            glUniform3fv(loc.lightPos, 1, &pos[0]);
+            if (eyeOnly) continue;
+            glUniform1i(loc.lightType, light.type);
+            glUniform3fv(loc.lightDir, 1, &(light.dir[0]));
+            glUniform1f(loc.lightCutoff, light.cutoff);
+            glUniform3fv(loc.lightColor, 1, &(light.color[0]));
+        }
+        appliedLightsVersion = snapshot.lightsVersion;
+        appliedLightsEye = snapshot.camPos;
     }
 
     void Renderer::SetShake(bool set) { this->shake = set; }
@@ -3,13 +3,16 @@
 //
 
 #include "renderer/Shader.h"
+#include "util/Profiler.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
 
 namespace kVox {
     Shader::Shader(const char* vertShaderPath, const char* fragShaderPath, const char* tcsShaderPath,
                    const char* tesShaderPath, const char* geomShaderPath) {
+        FP_PROFILE_ZONE("Shader::Shader");
         // Compile default shader program.
         GLuint vertShader = LoadAndCompileShaderFromFile(vertShaderPath, GL_VERTEX_SHADER);
         GLuint fragShader = LoadAndCompileShaderFromFile(fragShaderPath, GL_FRAGMENT_SHADER);
@@ -98,6 +101,17 @@ namespace kVox {
         this->uniforms.materialSpecColor = glGetUniformLocation(this->GetProgramHandle(), "materialSpecColor");
         this->uniforms.materialShininess = glGetUniformLocation(this->GetProgramHandle(), "materialShininess");
         this->uniforms.materialAmbColor = glGetUniformLocation(this->GetProgramHandle(), "materialAmbColor");
+        this->uniforms.logDepthCoef = glGetUniformLocation(this->GetProgramHandle(), "logDepthCoef");
+        this->uniforms.numLights = glGetUniformLocation(this->GetProgramHandle(), "numLights");
+        for (int i = 0; i < ShaderUniforms::MAX_LIGHTS; i++) {
+            std::string prefix = "lights[" + std::to_string(i) + "].";
+            ShaderUniforms::Light& light = this->uniforms.lights[i];
+            light.lightType = glGetUniformLocation(this->GetProgramHandle(), (prefix + "lightType").c_str());
+            light.lightPos = glGetUniformLocation(this->GetProgramHandle(), (prefix + "lightPos").c_str());
+            light.lightDir = glGetUniformLocation(this->GetProgramHandle(), (prefix + "lightDir").c_str());
+            light.lightCutoff = glGetUniformLocation(this->GetProgramHandle(), (prefix + "lightCutoff").c_str());
+            light.lightColor = glGetUniformLocation(this->GetProgramHandle(), (prefix + "lightColor").c_str());
+        }
         this->attributes.vPos  = glGetAttribLocation(this->GetProgramHandle(), "vPos");
         this->attributes.vNorm = glGetAttribLocation(this->GetProgramHandle(), "vNorm");
     }
@@ -117,6 +131,7 @@ namespace kVox {
     }
 
     GLuint Shader::LoadAndCompileShaderFromFile(const char *filePath, GLuint shaderType) {
+        FP_PROFILE_FUNCTION();
         if (filePath == nullptr) {
             return GL_NONE;
         }
@@ -6,6 +6,15 @@
 #include <renderer/Renderer.h>
 
 namespace kVox {
+    // tessellation of the CSCI441 primitives
+    static constexpr GLint PRIM_STACKS = 32;
+    static constexpr GLint PRIM_SLICES = 64;
+    static constexpr GLint TORUS_SIDES = 32;
+    static constexpr GLint TORUS_RINGS = 32;
+
+    util::BlockPool& VAO::Pool() { return util::ImmortalPool<VAO>(); }
+    void* VAO::operator new(std::size_t size) { return Pool().Allocate(size); }
+    void VAO::operator delete(void* ptr, std::size_t size) { Pool().Free(ptr, size); }
 
     VAO::VAO(const float *vertPos, int vertPosCount, const std::string &shaderToUse, Renderer &renderer)
         : renderer(renderer) {
@@ -14,12 +23,29 @@ namespace kVox {
         // each vertex is 3 elements, so divide to get total vert count
         mVertCount = vertPosCount / 3;
 
+        // keep a copy of the vertex data; GL buffers are only created on first draw, since the
+        // thread constructing a drawable doesn't necessarily own the GL context
+        if (vertPos != nullptr && vertPosCount > 0)
+            mVertData.assign(vertPos, vertPos + vertPosCount);
+    }
+
+    VAO::~VAO() {
+        if (mVBO != GL_NONE)
+            glDeleteBuffers(1, &mVBO);
+        if (mVAO != GL_NONE)
+            glDeleteVertexArrays(1, &mVAO);
+    }
+
+    void VAO::Upload() const {
+        if (mVAO != GL_NONE || mVertData.empty())
+            return;
+
         // generate buffer and bind for use
         glGenBuffers(1, &mVBO);
         glBindBuffer(GL_ARRAY_BUFFER, mVBO);
 
         // allocate buffer of specific size and copy vertex data into it
-        glBufferData(GL_ARRAY_BUFFER, vertPosCount * sizeof(float), vertPos, GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, mVertData.size() * sizeof(float), mVertData.data(), GL_STATIC_DRAW);
 
         // generate and bind VAO
         glGenVertexArrays(1, &mVAO);
@@ -33,18 +59,15 @@ namespace kVox {
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
     }
 
-    VAO::~VAO() {
-        if (mVBO != GL_NONE)
-            glDeleteBuffers(1, &mVBO);
-        if (mVAO != GL_NONE)
-            glDeleteVertexArrays(1, &mVAO);
-    }
-
     void VAO::Draw() const {
+        Upload();
         glBindVertexArray(mVAO);
         glDrawArrays(GL_TRIANGLES, 0, mVertCount);
     }
 
+    uint64_t VAO::TriangleCount() const { return mVertCount / 3; }
+    uint32_t VAO::DrawCallCount() const { return 1; }
+
     void VAO::SetShader(const std::string& shaderName) { shaderToRenderWith = shaderName; }
 
     std::string VAO::GetShader() {
@@ -53,8 +76,69 @@ namespace kVox {
     }
 
     glm::mat4 VAO::GetModelMtx() { return modelMtx; }
+    glm::dvec3 VAO::GetOrigin() const { return origin; }
+
+    void VAO::SetModelMtx(glm::mat4 modelMat, const glm::dvec3& worldPos) {
+        this->modelMtx = modelMat;
+        this->origin = worldPos;
+        // a freshly-placed drawable has no history yet, so don't let it sweep in from the origin
+        if (!hasPrevModelMtx) {
+            this->prevModelMtx = modelMat;
+            this->prevOrigin = worldPos;
+            hasPrevModelMtx = true;
+        }
+    }
+
+    void VAO::ShiftOrigin(const glm::dvec3& offset) {
+        origin += offset;
+        prevOrigin += offset;
+    }
+
+    void VAO::StorePrevModelMtx() {
+        this->prevModelMtx = this->modelMtx;
+        this->prevOrigin = this->origin;
+        hasPrevModelMtx = true;
+    }
 
-    void VAO::SetModelMtx(glm::mat4 modelMat) { this->modelMtx = modelMat; }
+    glm::mat4 VAO::GetInterpModelMtx(double alpha, const glm::dvec3& eye) const {
+        // the translation is blended and made eye-relative in double, and only then narrowed to float
+        glm::dvec3 worldPos = (alpha >= 1.0) ? origin : glm::mix(prevOrigin, origin, alpha);
+        glm::vec4 translation(glm::vec3(worldPos - eye), 1.0f);
+        glm::mat4 result = GetInterpRotScale(alpha);
+        result[3] = translation;
+        return result;
+    }
+
+    glm::mat4 VAO::GetInterpRotScale(double alpha) const {
+        if (alpha >= 1.0 || prevModelMtx == modelMtx)
+            return modelMtx;
+        auto t = static_cast<float>(alpha);
+        // split both matrices into per-axis scale and rotation
+        glm::vec3 scaleA(glm::length(glm::vec3(prevModelMtx[0])),
+                         glm::length(glm::vec3(prevModelMtx[1])),
+                         glm::length(glm::vec3(prevModelMtx[2])));
+        glm::vec3 scaleB(glm::length(glm::vec3(modelMtx[0])),
+                         glm::length(glm::vec3(modelMtx[1])),
+                         glm::length(glm::vec3(modelMtx[2])));
+        // zero-scaled (invisible) drawables have no recoverable rotation; nothing to blend
+        if (scaleA.x == 0.0f || scaleA.y == 0.0f || scaleA.z == 0.0f ||
+            scaleB.x == 0.0f || scaleB.y == 0.0f || scaleB.z == 0.0f)
+            return modelMtx;
+        glm::mat3 rotA(glm::vec3(prevModelMtx[0]) / scaleA.x,
+                       glm::vec3(prevModelMtx[1]) / scaleA.y,
+                       glm::vec3(prevModelMtx[2]) / scaleA.z);
+        glm::mat3 rotB(glm::vec3(modelMtx[0]) / scaleB.x,
+                       glm::vec3(modelMtx[1]) / scaleB.y,
+                       glm::vec3(modelMtx[2]) / scaleB.z);
+        // then blend each part and rebuild
+        glm::quat rot = glm::slerp(glm::quat_cast(rotA), glm::quat_cast(rotB), t);
+        glm::vec3 scale = glm::mix(scaleA, scaleB, t);
+        glm::mat4 result = glm::toMat4(rot);
+        result[0] *= scale.x;
+        result[1] *= scale.y;
+        result[2] *= scale.z;
+        return result;
+    }
 
     void PrimitiveVAO::Draw() const {
         switch (primitive) {
@@ -63,21 +147,57 @@ namespace kVox {
                 break;
             }
             case CONE: {
-                CSCI441::drawSolidCone(1.0,1.0,32,64);
+                CSCI441::drawSolidCone(1.0,1.0,PRIM_STACKS,PRIM_SLICES);
                 break;
             }
             case CYLINDER: {
-                CSCI441::drawSolidCylinder(1.0,1.0,1.0,32,64);
+                CSCI441::drawSolidCylinder(1.0,1.0,1.0,PRIM_STACKS,PRIM_SLICES);
                 break;
             }
             case TORUS: {
-                CSCI441::drawSolidTorus(0.5,1.0,32,32);
+                CSCI441::drawSolidTorus(0.5,1.0,TORUS_SIDES,TORUS_RINGS);
                 break;
             }
             case SPHERE: {
-                CSCI441::drawSolidSphere(1.0,32,32);
+                CSCI441::drawSolidSphere(1.0,PRIM_STACKS,PRIM_STACKS);
                 break;
             }
         }
     }
-}
\ No newline at end of file
+
+    // sizes follow the arguments \c Draw gives CSCI441: cones and cylinders stand on the origin along +y, and the
+    // torus lies in the xy-plane
+    void PrimitiveVAO::GetLocalBounds(PrimitiveType type, glm::vec3& center, glm::vec3& halfExtents) {
+        center = glm::vec3(0.0);
+        switch (type) {
+            case CUBE:      halfExtents = glm::vec3(0.5); break;
+            case CONE:
+            case CYLINDER:  center = glm::vec3(0.0, 0.5, 0.0); halfExtents = glm::vec3(1.0, 0.5, 1.0); break;
+            case TORUS:     halfExtents = glm::vec3(1.5, 1.5, 0.5); break;
+            case SPHERE:    halfExtents = glm::vec3(1.0); break;
+        }
+    }
+
+    // counts follow how CSCI441 tessellates each shape: one strip (or fan) per stack/ring
+    uint64_t PrimitiveVAO::TriangleCount() const {
+        switch (primitive) {
+            case CUBE:      return 12;
+            case CONE:
+            case CYLINDER:  return 2ull * PRIM_STACKS * PRIM_SLICES;
+            case TORUS:     return (4ull * TORUS_SIDES - 2) * TORUS_RINGS;
+            case SPHERE:    return 2ull * PRIM_STACKS * (PRIM_STACKS - 1);
+        }
+        return 0;
+    }
+
+    uint32_t PrimitiveVAO::DrawCallCount() const {
+        switch (primitive) {
+            case CUBE:      return 1;
+            case CONE:
+            case CYLINDER:
+            case SPHERE:    return PRIM_STACKS;
+            case TORUS:     return TORUS_RINGS;
+        }
+        return 0;
+    }
+}
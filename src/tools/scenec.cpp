@@ -0,0 +1,34 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+// Scene converter: compiles text scenes into the binary scenes the engine maps at load time.
+// usage: fp_scenec <scene.kvs> [scene.kvsb]
+
+#include <kScene.h>
+#include <cstdio>
+#include <string>
+
+using namespace kVox;
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <scene.kvs> [scene.kvsb]\n", argv[0]);
+        return 2;
+    }
+    std::string textPath = argv[1];
+    std::string binaryPath;
+    if (argc == 3) {
+        binaryPath = argv[2];
+    } else {
+        // default: same name, binary extension
+        size_t dot = textPath.find_last_of('.');
+        size_t slash = textPath.find_last_of("/\\");
+        bool hasExt = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        binaryPath = (hasExt ? textPath.substr(0, dot) : textPath) + ".kvsb";
+    }
+
+    if (!kScene::Compile(textPath, binaryPath)) return 1;
+    printf("Wrote %s\n", binaryPath.c_str());
+    return 0;
+}
@@ -0,0 +1,84 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <util/BlockPool.h>
+#include <algorithm>
+#include <new>
+
+namespace kVox::util {
+
+    BlockPool::BlockPool(size_t maxPooledSize, size_t chunkSize)
+            : maxPooledSize(maxPooledSize), chunkSize(chunkSize),
+              freeLists((maxPooledSize + ALIGNMENT - 1) / ALIGNMENT + 1, nullptr) {}
+
+    BlockPool::~BlockPool() {
+        for (void* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t(ALIGNMENT));
+        }
+    }
+
+    void* BlockPool::Allocate(size_t size) {
+        if (size > maxPooledSize) {
+            std::lock_guard<std::mutex> guard(lock);
+            live++;
+            return ::operator new(size, std::align_val_t(ALIGNMENT));
+        }
+        size_t sizeClass = (size + ALIGNMENT - 1) / ALIGNMENT;
+        std::lock_guard<std::mutex> guard(lock);
+        if (freeLists[sizeClass] == nullptr)
+            Refill(sizeClass);
+        FreeBlock* block = freeLists[sizeClass];
+        freeLists[sizeClass] = block->next;
+        live++;
+        return block;
+    }
+
+    void BlockPool::Free(void* ptr, size_t size) {
+        if (ptr == nullptr) return;
+        std::lock_guard<std::mutex> guard(lock);
+        live--;
+        if (size > maxPooledSize) {
+            ::operator delete(ptr, std::align_val_t(ALIGNMENT));
+            return;
+        }
+        size_t sizeClass = (size + ALIGNMENT - 1) / ALIGNMENT;
+        auto* block = static_cast<FreeBlock*>(ptr);
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+    }
+
+    void BlockPool::Refill(size_t sizeClass) {
+        size_t blockSize = sizeClass * ALIGNMENT;
+        void* chunk = ::operator new(chunkSize, std::align_val_t(ALIGNMENT));
+        chunks.push_back(chunk);
+        auto* bytes = static_cast<unsigned char*>(chunk);
+        // thread the list back to front, so blocks go out in address order
+        for (size_t offset = (chunkSize / blockSize) * blockSize; offset >= blockSize; offset -= blockSize) {
+            auto* block = reinterpret_cast<FreeBlock*>(bytes + offset - blockSize);
+            block->next = freeLists[sizeClass];
+            freeLists[sizeClass] = block;
+        }
+    }
+
+    bool BlockPool::Release() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (live != 0) return false;
+        for (void* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t(ALIGNMENT));
+        }
+        chunks.clear();
+        std::fill(freeLists.begin(), freeLists.end(), nullptr);
+        return true;
+    }
+
+    size_t BlockPool::LiveCount() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return live;
+    }
+
+    size_t BlockPool::ReservedBytes() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return chunks.size() * chunkSize;
+    }
+}
@@ -0,0 +1,153 @@
+//
+// Created by snaki on 12/18/2020.
+//
+
+#include <util/FrameStats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace kVox::util {
+    // how often (in frames) the median used for hitch detection is refreshed
+    static constexpr uint64_t TYPICAL_REFRESH_INTERVAL = 64;
+
+    FrameStats::FrameStats() {
+        Clear();
+    }
+
+    void FrameStats::Clear() {
+        std::memset(histograms, 0, sizeof(histograms));
+        std::memset(sums, 0, sizeof(sums));
+        frames = 0;
+        hitches = 0;
+        typicalFrameTime = 0.0;
+    }
+
+    int FrameStats::BucketOf(double value) {
+        if (!(value > MIN_VALUE)) return 0;
+        int bucket = 1 + static_cast<int>(std::log2(value / MIN_VALUE) * BUCKETS_PER_OCTAVE);
+        return std::min(bucket, BUCKET_COUNT - 1);
+    }
+
+    double FrameStats::BucketValue(int bucket) {
+        if (bucket <= 0) return 0.0;
+        // report the middle of the bucket's range
+        return MIN_VALUE * std::exp2((bucket - 0.5) / BUCKETS_PER_OCTAVE);
+    }
+
+    void FrameStats::Record(const FrameSample& sample) {
+        FrameSample& slot = samples[frames % WINDOW];
+        // the window is full: the frame being overwritten leaves the histograms
+        if (frames >= WINDOW) {
+            for (int m = 0; m < METRIC_COUNT; m++) {
+                histograms[m][BucketOf(slot.values[m])]--;
+                sums[m] -= slot.values[m];
+            }
+        }
+        slot = sample;
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            histograms[m][BucketOf(sample.values[m])]++;
+            sums[m] += sample.values[m];
+        }
+        frames++;
+
+        if (frames % TYPICAL_REFRESH_INTERVAL == 0)
+            typicalFrameTime = Percentile(FRAME_TIME, 50.0);
+        if (typicalFrameTime > 0.0 && sample.values[FRAME_TIME] > hitchFactor * typicalFrameTime)
+            hitches++;
+    }
+
+    double FrameStats::Percentile(Metric metric, double percentile) const {
+        uint64_t count = std::min<uint64_t>(frames, WINDOW);
+        if (count == 0) return 0.0;
+        // rank of the requested sample, then walk the histogram until we pass it
+        auto rank = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * count));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            seen += histograms[metric][b];
+            if (seen >= rank)
+                return std::min(BucketValue(b), Max(metric));
+        }
+        return Max(metric);
+    }
+
+    double FrameStats::Max(Metric metric) const {
+        uint64_t count = std::min<uint64_t>(frames, WINDOW);
+        double result = 0.0;
+        for (uint64_t i = 0; i < count; i++) {
+            result = std::max(result, samples[i].values[metric]);
+        }
+        return result;
+    }
+
+    double FrameStats::Mean(Metric metric) const {
+        uint64_t count = std::min<uint64_t>(frames, WINDOW);
+        return count == 0 ? 0.0 : sums[metric] / count;
+    }
+
+    uint64_t FrameStats::HitchCount() const { return hitches; }
+    uint64_t FrameStats::FrameCount() const { return frames; }
+    void FrameStats::SetHitchFactor(double factor) { hitchFactor = factor; }
+
+    const char* FrameStats::MetricName(Metric metric) {
+        switch (metric) {
+            case FRAME_TIME:  return "frame_ms";
+            case SIM_TIME:    return "sim_ms";
+            case RENDER_TIME: return "render_ms";
+            case GPU_TIME:    return "gpu_ms";
+            case DRAW_CALLS:  return "draw_calls";
+            case TRIANGLES:   return "triangles";
+            default:          return "unknown";
+        }
+    }
+
+    bool FrameStats::DumpCSV(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open stats file for writing: %s\n", path.c_str());
+            return false;
+        }
+        fprintf(file, "frame");
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            fprintf(file, ",%s", MetricName(static_cast<Metric>(m)));
+        }
+        fprintf(file, "\n");
+        // oldest frame in the window first
+        uint64_t first = (frames > WINDOW) ? frames - WINDOW : 0;
+        for (uint64_t f = first; f < frames; f++) {
+            const FrameSample& sample = samples[f % WINDOW];
+            fprintf(file, "%llu", (unsigned long long)f);
+            for (double value : sample.values) {
+                fprintf(file, ",%.4f", value);
+            }
+            fprintf(file, "\n");
+        }
+        bool ok = (ferror(file) == 0);
+        fclose(file);
+        return ok;
+    }
+
+    bool FrameStats::DumpJSON(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open stats file for writing: %s\n", path.c_str());
+            return false;
+        }
+        fprintf(file, "{\n  \"frames\": %llu,\n  \"window\": %llu,\n  \"hitches\": %llu,\n  \"metrics\": {\n",
+                (unsigned long long)frames, (unsigned long long)std::min<uint64_t>(frames, WINDOW),
+                (unsigned long long)hitches);
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            auto metric = static_cast<Metric>(m);
+            fprintf(file, "    \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+                    MetricName(metric), Mean(metric), Percentile(metric, 50.0), Percentile(metric, 95.0),
+                    Percentile(metric, 99.0), Max(metric), (m + 1 < METRIC_COUNT) ? "," : "");
+        }
+        fprintf(file, "  }\n}\n");
+        bool ok = (ferror(file) == 0);
+        fclose(file);
+        return ok;
+    }
+}
@@ -0,0 +1,96 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <util/MappedFile.h>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kVox::util {
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "Couldn't open file for mapping: %s\n", path.c_str());
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+            // (empty files can't be mapped)
+            fprintf(stderr, "Couldn't map empty or unreadable file: %s\n", path.c_str());
+            CloseHandle(handle);
+            return false;
+        }
+        HANDLE map = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = (map != nullptr) ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view == nullptr) {
+            fprintf(stderr, "Couldn't map file: %s\n", path.c_str());
+            if (map != nullptr) CloseHandle(map);
+            CloseHandle(handle);
+            return false;
+        }
+        file = handle;
+        mapping = map;
+        data = static_cast<const uint8_t*>(view);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data != nullptr) UnmapViewOfFile(data);
+        if (mapping != nullptr) CloseHandle(mapping);
+        if (file != nullptr) CloseHandle(file);
+        data = nullptr;
+        mapping = nullptr;
+        file = nullptr;
+        size = 0;
+    }
+#else
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Couldn't open file for mapping: %s\n", path.c_str());
+            return false;
+        }
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            // (empty files can't be mapped)
+            fprintf(stderr, "Couldn't map empty or unreadable file: %s\n", path.c_str());
+            close(fd);
+            return false;
+        }
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file alive on its own
+        close(fd);
+        if (view == MAP_FAILED) {
+            fprintf(stderr, "Couldn't map file: %s\n", path.c_str());
+            return false;
+        }
+        data = static_cast<const uint8_t*>(view);
+        size = static_cast<size_t>(info.st_size);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+}
@@ -0,0 +1,83 @@
+//
+// Created by snaki on 12/22/2020.
+//
+
+#include <util/MatrixBatch.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace kVox::util {
+
+    // glm matrices are column-major: column j of the product is lhs * (column j of rhs), i.e. the sum of
+    // lhs's columns weighted by the four entries of that rhs column
+
+#if defined(__SSE__) || defined(__AVX__)
+    /** One product, a column at a time. */
+    static inline void Multiply1(const float* a, const float* b, float* out) {
+        __m128 a0 = _mm_loadu_ps(a);
+        __m128 a1 = _mm_loadu_ps(a + 4);
+        __m128 a2 = _mm_loadu_ps(a + 8);
+        __m128 a3 = _mm_loadu_ps(a + 12);
+        for (int j = 0; j < 4; j++) {
+            const float* col = b + 4 * j;
+            __m128 r = _mm_mul_ps(a0, _mm_set1_ps(col[0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(col[1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(col[3])));
+            _mm_storeu_ps(out + 4 * j, r);
+        }
+    }
+#endif
+
+#if defined(__AVX__)
+    /** Packs one 4-float column of each of two matrices into the low and high halves of a register. */
+    static inline __m256 LoadPair(const float* lo, const float* hi) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+    }
+    static inline __m256 BroadcastPair(float lo, float hi) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(lo)), _mm_set1_ps(hi), 1);
+    }
+
+    /** Two independent products at once, one per 128-bit lane. */
+    static inline void Multiply2(const float* a, const float* b, const float* c, const float* d,
+                                 float* out0, float* out1) {
+        __m256 a0 = LoadPair(a, c);
+        __m256 a1 = LoadPair(a + 4, c + 4);
+        __m256 a2 = LoadPair(a + 8, c + 8);
+        __m256 a3 = LoadPair(a + 12, c + 12);
+        for (int j = 0; j < 4; j++) {
+            const float* col0 = b + 4 * j;
+            const float* col1 = d + 4 * j;
+            __m256 r = _mm256_mul_ps(a0, BroadcastPair(col0[0], col1[0]));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a1, BroadcastPair(col0[1], col1[1])));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a2, BroadcastPair(col0[2], col1[2])));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a3, BroadcastPair(col0[3], col1[3])));
+            _mm_storeu_ps(out0 + 4 * j, _mm256_castps256_ps128(r));
+            _mm_storeu_ps(out1 + 4 * j, _mm256_extractf128_ps(r, 1));
+        }
+    }
+#endif
+
+    void MultiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, size_t count) {
+        size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 2 <= count; i += 2) {
+            Multiply2(&lhs[i][0][0], &rhs[i][0][0], &lhs[i + 1][0][0], &rhs[i + 1][0][0],
+                      &out[i][0][0], &out[i + 1][0][0]);
+        }
+#endif
+#if defined(__SSE__) || defined(__AVX__)
+        for (; i < count; i++) {
+            Multiply1(&lhs[i][0][0], &rhs[i][0][0], &out[i][0][0]);
+        }
+#else
+        for (; i < count; i++) {
+            out[i] = lhs[i] * rhs[i];
+        }
+#endif
+    }
+}
@@ -0,0 +1,111 @@
+//
+// Created by snaki on 12/16/2020.
+//
+
+#include <util/Profiler.h>
+
+#include <chrono>
+#include <cstdio>
+
+namespace kVox::util {
+    static thread_local ProfileTrack* tlsTrack = nullptr;
+
+    static uint64_t SteadyNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Profiler& Profiler::Instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler::Profiler() : epoch(SteadyNanos()) {}
+
+    uint64_t Profiler::Now() const { return SteadyNanos() - epoch; }
+
+    ProfileTrack* Profiler::CreateTrack(const std::string& name) {
+        std::lock_guard<std::mutex> guard(registryLock);
+        tracks.emplace_back(std::make_unique<ProfileTrack>());
+        tracks.back()->tid = static_cast<uint32_t>(tracks.size());
+        tracks.back()->name = name;
+        return tracks.back().get();
+    }
+
+    ProfileTrack& Profiler::LocalTrack() {
+        if (tlsTrack == nullptr)
+            tlsTrack = CreateTrack("");
+        return *tlsTrack;
+    }
+
+    void Profiler::Record(const char* name, uint64_t start, uint64_t end) {
+        Record(LocalTrack(), name, start, end);
+    }
+
+    void Profiler::Record(ProfileTrack& track, const char* name, uint64_t start, uint64_t end) {
+        // only one thread ever writes to a track, so a plain store plus a release of the head is enough
+        uint64_t head = track.head.load(std::memory_order_relaxed);
+        track.events[head & (RING_CAPACITY - 1)] = ProfileEvent{ name, start, end };
+        track.head.store(head + 1, std::memory_order_release);
+    }
+
+    void Profiler::SetThreadName(const std::string& name) {
+        ProfileTrack& track = LocalTrack();
+        std::lock_guard<std::mutex> guard(registryLock);
+        track.name = name;
+    }
+
+    // writes a string as a JSON string literal
+    static void WriteJsonString(FILE* file, const char* str) {
+        fputc('"', file);
+        for (const char* c = str; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') fputc('\\', file);
+            if (static_cast<unsigned char>(*c) >= 0x20) fputc(*c, file);
+        }
+        fputc('"', file);
+    }
+
+    bool Profiler::DumpChromeTrace(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Couldn't open trace file for writing: %s\n", path.c_str());
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(registryLock);
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        std::vector<ProfileEvent> events;
+        for (const auto& track : tracks) {
+            // thread label
+            if (!track->name.empty()) {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                        first ? "" : ",\n", track->tid);
+                WriteJsonString(file, track->name.c_str());
+                fprintf(file, "}}");
+                first = false;
+            }
+            // copy out whatever the track holds; the owning thread may keep writing meanwhile
+            uint64_t head = track->head.load(std::memory_order_acquire);
+            uint64_t tail = (head > RING_CAPACITY) ? head - RING_CAPACITY : 0;
+            events.clear();
+            for (uint64_t i = tail; i < head; i++) {
+                events.push_back(track->events[i & (RING_CAPACITY - 1)]);
+            }
+            // drop anything that was overwritten while we copied
+            uint64_t newHead = track->head.load(std::memory_order_acquire);
+            size_t skip = (newHead - tail > RING_CAPACITY) ? static_cast<size_t>(newHead - tail - RING_CAPACITY) : 0;
+            for (size_t i = skip; i < events.size(); i++) {
+                const ProfileEvent& e = events[i];
+                fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+                WriteJsonString(file, e.name);
+                fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        track->tid, e.start / 1000.0, (e.end - e.start) / 1000.0);
+                first = false;
+            }
+        }
+        fprintf(file, "\n]}\n");
+        bool ok = (ferror(file) == 0);
+        fclose(file);
+        return ok;
+    }
+}